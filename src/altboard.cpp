@@ -0,0 +1,185 @@
+#include "altboard.h"
+#include "globals.h"
+#include "heaptrack.h"
+#include <rom/crc.h>
+
+#define ALT_BOARD_ROWS 10
+
+// Heap that must stay free for HTTP, TLS and the regular sprites
+static const size_t ALT_BOARD_HEAP_RESERVE = 40000;
+
+unsigned long altBoardHits = 0;
+unsigned long altBoardMisses = 0;
+
+static TFT_eSprite* altSprite = nullptr;
+static int8_t altStation = -1;
+static uint32_t altHash = 0;
+static String altStationName;
+
+static uint16_t altPalette[16];
+static uint8_t paletteLut[256]; // RGB332 sprite pixel -> palette index
+static bool paletteReady = false;
+
+static void buildPalette() {
+    // Index 0 is the background so fillSprite(0) clears to blue
+    int n = 0;
+    altPalette[n++] = TFT_BLUE;
+    altPalette[n++] = TFT_WHITE;
+    altPalette[n++] = TFT_YELLOW;
+    altPalette[n++] = TFT_RED;
+    altPalette[n++] = TFT_BLACK;
+
+    // Anti-aliasing shades of the colour pairs used by drawTransport()
+    altPalette[n++] = tft.alphaBlend(32, TFT_WHITE, TFT_BLUE);
+    altPalette[n++] = tft.alphaBlend(80, TFT_WHITE, TFT_BLUE);
+    altPalette[n++] = tft.alphaBlend(128, TFT_WHITE, TFT_BLUE);
+    altPalette[n++] = tft.alphaBlend(176, TFT_WHITE, TFT_BLUE);
+    altPalette[n++] = tft.alphaBlend(224, TFT_WHITE, TFT_BLUE);
+    altPalette[n++] = tft.alphaBlend(96, TFT_YELLOW, TFT_BLUE);
+    altPalette[n++] = tft.alphaBlend(176, TFT_YELLOW, TFT_BLUE);
+    altPalette[n++] = tft.alphaBlend(128, TFT_WHITE, TFT_RED);
+    altPalette[n++] = tft.alphaBlend(96, TFT_BLUE, TFT_WHITE);
+    altPalette[n++] = tft.alphaBlend(176, TFT_BLUE, TFT_WHITE);
+    altPalette[n++] = tft.alphaBlend(128, TFT_WHITE, TFT_BLACK);
+
+    for (int c = 0; c < 256; c++) {
+        int r = ((c >> 5) & 0x07) * 255 / 7;
+        int g = ((c >> 2) & 0x07) * 255 / 7;
+        int b = (c & 0x03) * 255 / 3;
+
+        uint32_t best = UINT32_MAX;
+        for (int i = 0; i < 16; i++) {
+            int pr = (altPalette[i] >> 8) & 0xF8;
+            int pg = (altPalette[i] >> 3) & 0xFC;
+            int pb = (altPalette[i] << 3) & 0xF8;
+            uint32_t dist = (r - pr) * (r - pr) + (g - pg) * (g - pg) + (b - pb) * (b - pb);
+            if (dist < best) {
+                best = dist;
+                paletteLut[c] = i;
+            }
+        }
+    }
+    paletteReady = true;
+}
+
+static uint32_t hashBoard(const String& station, const std::vector<Transport>& transports) {
+    uint32_t crc = crc32_le(0, (const uint8_t*)station.c_str(), station.length());
+    for (const Transport& t : transports) {
+        const char* fields[] = {t.name.c_str(), t.number.c_str(), t.destination.c_str(),
+                                t.departure.c_str(), t.delay.c_str(), t.category.c_str()};
+        for (const char* field : fields) {
+            crc = crc32_le(crc, (const uint8_t*)field, strlen(field) + 1);
+        }
+    }
+    return crc;
+}
+
+static size_t altBoardBytes() {
+    return (size_t)tft.width() * ALT_BOARD_ROWS * POS_INC / 2;
+}
+
+static bool ensureSprite() {
+    if (altSprite) {
+        if (ESP.getFreeHeap() < ALT_BOARD_HEAP_RESERVE) {
+            Serial.println("Alt board: heap low, releasing sprite");
+            altBoardRelease();
+            return false;
+        }
+        return true;
+    }
+
+    size_t bytes = altBoardBytes();
+    if (ESP.getMaxAllocHeap() < bytes + ALT_BOARD_HEAP_RESERVE) {
+        Serial.printf("Alt board disabled: largest block %d bytes\n", ESP.getMaxAllocHeap());
+        return false;
+    }
+
+    if (!paletteReady) buildPalette();
+
+    altSprite = new TFT_eSprite(&tft);
+    altSprite->setColorDepth(4);
+    heapTag(HEAP_TAG_SPRITE);
+    bool created = altSprite->createSprite(tft.width(), ALT_BOARD_ROWS * POS_INC);
+    heapTag(HEAP_TAG_NONE);
+    if (!created) {
+        Serial.println("Alt board: sprite allocation failed");
+        delete altSprite;
+        altSprite = nullptr;
+        return false;
+    }
+    altSprite->createPalette(altPalette, 16);
+    return true;
+}
+
+void altBoardUpdate(uint8_t stationIndex, const String& station, const std::vector<Transport>& transports) {
+    uint32_t hash = hashBoard(station, transports);
+    if (altSprite && altStation == stationIndex && altHash == hash) return;
+
+    if (!ensureSprite()) return;
+    altStation = -1;
+
+    // Rasterize one row at a time through a small 8 bit strip, then map to the palette
+    TFT_eSprite row(&tft);
+    row.setColorDepth(8);
+    if (!row.createSprite(tft.width(), POS_INC)) {
+        Serial.println("Alt board: row sprite allocation failed");
+        return;
+    }
+    row.loadFont(AA_FONT_SMALL);
+
+    int width = altSprite->width();
+    uint8_t* dst = (uint8_t*)altSprite->getPointer();
+    altSprite->fillSprite(0);
+
+    int rowIndex = 0;
+    for (const Transport& transport : transports) {
+        if (rowIndex >= ALT_BOARD_ROWS) break;
+        if (transport.name == "null") continue;
+
+        row.fillSprite(TFT_BLUE);
+        drawTransport(row, transport, 0);
+
+        const uint8_t* src = (const uint8_t*)row.getPointer();
+        uint8_t* out = dst + (rowIndex * POS_INC * width) / 2;
+        for (int i = 0; i < width * POS_INC; i += 2) {
+            *out++ = (paletteLut[src[i]] << 4) | paletteLut[src[i + 1]];
+        }
+        rowIndex++;
+    }
+    row.deleteSprite();
+
+    altStation = stationIndex;
+    altHash = hash;
+    altStationName = station;
+    Serial.printf("Alt board rasterized for station %d\n", stationIndex + 1);
+}
+
+bool altBoardShow(uint8_t stationIndex) {
+    if (!altSprite || altStation != stationIndex) {
+        altBoardMisses++;
+        return false;
+    }
+
+    drawStation(altStationName);
+    altSprite->pushSprite(0, POS_FIRST);
+    altBoardHits++;
+    return true;
+}
+
+void altBoardRelease() {
+    if (altSprite) {
+        altSprite->deleteSprite();
+        delete altSprite;
+        altSprite = nullptr;
+    }
+    altStation = -1;
+}
+
+void altBoardReport() {
+    if (altSprite) {
+        Serial.printf("Alt board: %u bytes (station %d), hits %lu, misses %lu\n",
+                      altBoardBytes(), altStation + 1, altBoardHits, altBoardMisses);
+    } else {
+        Serial.printf("Alt board: not allocated, hits %lu, misses %lu\n", altBoardHits, altBoardMisses);
+    }
+}
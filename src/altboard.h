@@ -0,0 +1,17 @@
+#ifndef ALTBOARD_H
+#define ALTBOARD_H
+
+#include <Arduino.h>
+#include <vector>
+#include "stationboard.h"
+
+// Rows of the inactive station, kept rasterized in a 4 bit palette sprite
+extern unsigned long altBoardHits;
+extern unsigned long altBoardMisses;
+
+void altBoardUpdate(uint8_t stationIndex, const String& station, const std::vector<Transport>& transports);
+bool altBoardShow(uint8_t stationIndex);
+void altBoardRelease();
+void altBoardReport();
+
+#endif // ALTBOARD_H
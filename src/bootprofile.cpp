@@ -0,0 +1,48 @@
+#include "bootprofile.h"
+#include <esp_timer.h>
+
+#define BOOT_STAGES 16
+
+struct BootStage {
+    const char* name;
+    uint32_t atUs;
+};
+
+static BootStage stages[BOOT_STAGES];
+static uint8_t stageCount = 0;
+static uint32_t firstFrameUs = 0;
+static const char* firstFrameSource = nullptr;
+
+void bootMark(const char* stage) {
+    if (stageCount >= BOOT_STAGES) return;
+    stages[stageCount].name = stage;
+    stages[stageCount].atUs = esp_timer_get_time();
+    stageCount++;
+}
+
+// First frame worth looking at: the restored snapshot or the first fetched board
+void bootFirstFrame(const char* source) {
+    if (firstFrameSource) return;
+    firstFrameUs = esp_timer_get_time();
+    firstFrameSource = source;
+    bootMark("first frame");
+}
+
+unsigned long bootFirstFrameMs() {
+    return firstFrameUs / 1000;
+}
+
+void bootReport() {
+    Serial.println("Boot timeline (ms since app start):");
+    uint32_t previous = 0;
+    for (uint8_t i = 0; i < stageCount; i++) {
+        Serial.printf("  %6lu  +%5lu  %s\n", (unsigned long)(stages[i].atUs / 1000),
+                      (unsigned long)((stages[i].atUs - previous) / 1000), stages[i].name);
+        previous = stages[i].atUs;
+    }
+    if (firstFrameSource) {
+        Serial.printf("First useful frame after %lu ms (%s)\n", bootFirstFrameMs(), firstFrameSource);
+    } else {
+        Serial.println("No useful frame during setup (no snapshot, fetch failed)");
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef BOOTPROFILE_H
+#define BOOTPROFILE_H
+
+#include <Arduino.h>
+
+// Boot timeline: each setup stage is stamped against esp_timer (starts with the app)
+void bootMark(const char* stage);
+void bootFirstFrame(const char* source);
+unsigned long bootFirstFrameMs();
+void bootReport();
+
+#endif // BOOTPROFILE_H
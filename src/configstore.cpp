@@ -0,0 +1,240 @@
+#include "configstore.h"
+#include "globals.h"
+#include "provider.h"
+#include <Preferences.h>
+#include <SPIFFS.h>
+#include <ArduinoJson.h>
+#include <rom/crc.h>
+
+#define CONFIG_MAGIC 0x31474643    // "CFG1"
+#define CONFIG_VERSION 2           // 1: before the provider choice
+#define CONFIG_MAX_SIZE 1024
+
+// Field tags, never reuse a number
+enum ConfigField : uint8_t {
+    CFG_STATION_ID = 1,
+    CFG_STATION_ID2 = 2,
+    CFG_LIMIT = 3,
+    CFG_OFFSET = 4,
+    CFG_BRIGHTNESS = 5,
+    CFG_NIGHT_ENABLED = 6,
+    CFG_NIGHT_START_HOUR = 7,
+    CFG_NIGHT_START_MINUTE = 8,
+    CFG_NIGHT_END_HOUR = 9,
+    CFG_NIGHT_END_MINUTE = 10,
+    CFG_NIGHT_WEEKEND_DISABLE = 11,
+    CFG_NIGHT_DEEP_SLEEP = 12,
+    CFG_STATIC_IP = 13,
+    CFG_PROVIDER_URL = 14,
+    CFG_PROVIDER_KEY = 15,
+    CFG_PROVIDER = 16,
+};
+
+enum ConfigType : uint8_t {
+    CFG_TYPE_INT = 1,     // little endian, 1, 2 or 4 bytes
+    CFG_TYPE_STRING = 2,
+};
+
+struct ConfigHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;      // payload bytes after the header
+    uint32_t crc;         // over the payload
+};
+
+// Field writer: [tag][type][length][value]
+static bool putField(uint8_t* buffer, size_t& pos, uint8_t tag, uint8_t type, const void* value, size_t length) {
+    if (length > 255 || pos + 3 + length > CONFIG_MAX_SIZE) return false;
+    buffer[pos++] = tag;
+    buffer[pos++] = type;
+    buffer[pos++] = length;
+    memcpy(buffer + pos, value, length);
+    pos += length;
+    return true;
+}
+
+static bool putInt(uint8_t* buffer, size_t& pos, uint8_t tag, int32_t value) {
+    return putField(buffer, pos, tag, CFG_TYPE_INT, &value, sizeof(value));
+}
+
+static bool putString(uint8_t* buffer, size_t& pos, uint8_t tag, const String& value) {
+    return putField(buffer, pos, tag, CFG_TYPE_STRING, value.c_str(), value.length());
+}
+
+static int32_t readInt(const uint8_t* value, uint8_t length) {
+    if (length == 1) return (int8_t)value[0];
+    if (length == 2) return (int16_t)(value[0] | (value[1] << 8));
+    int32_t result = 0;
+    memcpy(&result, value, std::min<size_t>(length, sizeof(result)));
+    return result;
+}
+
+// Unknown tags are skipped, missing ones keep the defaults of Config
+static void applyField(uint8_t tag, uint8_t type, const uint8_t* value, uint8_t length) {
+    if (type == CFG_TYPE_STRING) {
+        String text;
+        text.reserve(length);
+        for (uint8_t i = 0; i < length; i++) text += (char)value[i];
+        switch (tag) {
+            case CFG_STATION_ID: config.stationId = text; break;
+            case CFG_STATION_ID2: config.stationId2 = text; break;
+            case CFG_STATIC_IP: config.staticIp = text; break;
+            case CFG_PROVIDER_URL: config.providerUrl = text; break;
+            case CFG_PROVIDER_KEY: config.providerKey = text; break;
+        }
+        return;
+    }
+    if (type != CFG_TYPE_INT) return;
+
+    int32_t number = readInt(value, length);
+    switch (tag) {
+        case CFG_LIMIT: config.limit = number; break;
+        case CFG_OFFSET: config.offset = number; break;
+        case CFG_BRIGHTNESS: config.defaultBrightness = number; break;
+        case CFG_NIGHT_ENABLED: config.nightModeEnabled = number != 0; break;
+        case CFG_NIGHT_START_HOUR: config.nightModeStartHour = number; break;
+        case CFG_NIGHT_START_MINUTE: config.nightModeStartMinute = number; break;
+        case CFG_NIGHT_END_HOUR: config.nightModeEndHour = number; break;
+        case CFG_NIGHT_END_MINUTE: config.nightModeEndMinute = number; break;
+        case CFG_NIGHT_WEEKEND_DISABLE: config.nightModeWeekendDisable = number != 0; break;
+        case CFG_NIGHT_DEEP_SLEEP: config.nightDeepSleep = number != 0; break;
+        case CFG_PROVIDER: config.provider = number; break;
+    }
+}
+
+// Field-level changes between layouts, applied after the fields were read
+static void migrateConfig(uint16_t fromVersion) {
+    if (fromVersion < 2) {
+        // Version 1 used its feed URL for GTFS-Realtime only
+        config.provider = config.providerUrl.isEmpty() ? PROVIDER_OPENDATA : PROVIDER_GTFS_RT;
+    }
+}
+
+static bool readRecord() {
+    Preferences prefs;
+    if (!prefs.begin("config", true)) return false;
+
+    uint8_t buffer[sizeof(ConfigHeader) + CONFIG_MAX_SIZE];
+    size_t size = prefs.getBytesLength("cfg");
+    bool valid = size >= sizeof(ConfigHeader) && size <= sizeof(buffer) && prefs.getBytes("cfg", buffer, size) == size;
+    prefs.end();
+    if (!valid) return false;
+
+    ConfigHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    const uint8_t* payload = buffer + sizeof(header);
+    if (header.magic != CONFIG_MAGIC || header.length != size - sizeof(header) ||
+        header.crc != crc32_le(0, payload, header.length)) {
+        Serial.println("Config record invalid, using defaults");
+        return false;
+    }
+
+    size_t pos = 0;
+    while (pos + 3 <= header.length) {
+        uint8_t tag = payload[pos];
+        uint8_t type = payload[pos + 1];
+        uint8_t length = payload[pos + 2];
+        pos += 3;
+        if (pos + length > header.length) break;
+        applyField(tag, type, payload + pos, length);
+        pos += length;
+    }
+    if (header.version < CONFIG_VERSION) {
+        migrateConfig(header.version);
+        Serial.printf("Config migrated from version %u\n", header.version);
+        saveConfiguration();
+    }
+    return true;
+}
+
+// One-time import of the JSON file used by older firmware
+static bool importJson() {
+    if (!SPIFFS.exists("/config.json")) return false;
+    File configFile = SPIFFS.open("/config.json", FILE_READ);
+    if (!configFile) return false;
+
+    DynamicJsonDocument doc(1024);
+    DeserializationError error = deserializeJson(doc, configFile);
+    configFile.close();
+    if (error) return false;
+
+    config.stationId = doc["station_id"].as<String>();
+    config.stationId2 = doc["station_id2"].as<String>();
+    config.limit = doc["limit"].as<int>();
+    config.offset = doc["offset"].as<int>();
+    config.defaultBrightness = doc["defaultBrightness"].as<int>();
+    config.staticIp = doc["staticIp"] | "";
+    config.nightModeEnabled = doc["nightModeEnabled"] | false;
+    config.nightModeStartHour = doc["nightModeStartHour"] | 22;
+    config.nightModeStartMinute = doc["nightModeStartMinute"] | 0;
+    config.nightModeEndHour = doc["nightModeEndHour"] | 7;
+    config.nightModeEndMinute = doc["nightModeEndMinute"] | 0;
+    config.nightModeWeekendDisable = doc["nightModeWeekendDisable"] | false;
+    config.nightDeepSleep = doc["nightDeepSleep"] | false;
+
+    saveConfiguration();
+    SPIFFS.remove("/config.json");
+    Serial.println("Config imported from /config.json");
+    return true;
+}
+
+void loadConfiguration() {
+    if (readRecord()) return;
+    if (!importJson()) {
+        Serial.println("No config found");
+    }
+}
+
+void saveConfiguration() {
+    uint8_t buffer[sizeof(ConfigHeader) + CONFIG_MAX_SIZE];
+    uint8_t* payload = buffer + sizeof(ConfigHeader);
+    size_t pos = 0;
+    bool ok = putString(payload, pos, CFG_STATION_ID, config.stationId) &&
+              putString(payload, pos, CFG_STATION_ID2, config.stationId2) &&
+              putInt(payload, pos, CFG_LIMIT, config.limit) &&
+              putInt(payload, pos, CFG_OFFSET, config.offset) &&
+              putInt(payload, pos, CFG_BRIGHTNESS, config.defaultBrightness) &&
+              putInt(payload, pos, CFG_NIGHT_ENABLED, config.nightModeEnabled) &&
+              putInt(payload, pos, CFG_NIGHT_START_HOUR, config.nightModeStartHour) &&
+              putInt(payload, pos, CFG_NIGHT_START_MINUTE, config.nightModeStartMinute) &&
+              putInt(payload, pos, CFG_NIGHT_END_HOUR, config.nightModeEndHour) &&
+              putInt(payload, pos, CFG_NIGHT_END_MINUTE, config.nightModeEndMinute) &&
+              putInt(payload, pos, CFG_NIGHT_WEEKEND_DISABLE, config.nightModeWeekendDisable) &&
+              putInt(payload, pos, CFG_NIGHT_DEEP_SLEEP, config.nightDeepSleep) &&
+              putString(payload, pos, CFG_STATIC_IP, config.staticIp) &&
+              putString(payload, pos, CFG_PROVIDER_URL, config.providerUrl) &&
+              putString(payload, pos, CFG_PROVIDER_KEY, config.providerKey) &&
+              putInt(payload, pos, CFG_PROVIDER, config.provider);
+    if (!ok) {
+        Serial.println("- config too large, not saved");
+        return;
+    }
+
+    ConfigHeader header = {CONFIG_MAGIC, CONFIG_VERSION, (uint16_t)pos, crc32_le(0, payload, pos)};
+    memcpy(buffer, &header, sizeof(header));
+    size_t size = sizeof(header) + pos;
+
+    Preferences prefs;
+    if (!prefs.begin("config", false)) {
+        Serial.println("- failed to open config namespace");
+        return;
+    }
+    // Unchanged records are not written again
+    uint8_t current[sizeof(buffer)];
+    if (prefs.getBytesLength("cfg") == size && prefs.getBytes("cfg", current, size) == size &&
+        memcmp(current, buffer, size) == 0) {
+        prefs.end();
+        return;
+    }
+    bool written = prefs.putBytes("cfg", buffer, size) == size;
+    prefs.end();
+    Serial.printf(written ? "Config saved (%u bytes)\n" : "- failed to save config (%u bytes)\n", (unsigned)size);
+}
+
+void configClear() {
+    Preferences prefs;
+    if (prefs.begin("config", false)) {
+        prefs.clear();
+        prefs.end();
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include <Arduino.h>
+
+// Config as a versioned binary record in NVS: a header with CRC followed by
+// tagged fields, so fields can be added, dropped or widened between versions.
+// loadConfiguration() and saveConfiguration() are declared in globals.h.
+void configClear();
+
+#endif // CONFIGSTORE_H
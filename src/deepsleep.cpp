@@ -0,0 +1,203 @@
+#include "deepsleep.h"
+#include "globals.h"
+#include "stationboard.h"
+#include "scheduler.h"
+#include "timesync.h"
+#include <WiFi.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <rom/crc.h>
+#include <sys/time.h>
+
+#define RTC_BOARD_ROWS 10
+#define BUTTON_WAKE GPIO_NUM_0  // Boot Button
+
+static const uint32_t RTC_MAGIC = 0x31535453;              // "STS1"
+static const uint64_t DEEP_SLEEP_MIN_DURATION = 120000;    // shorter idle windows stay in light sleep
+static const uint64_t DEEP_SLEEP_FETCH_INTERVAL = 3600000; // night fetches are spaced out, each wake is a full boot
+
+// Compact copy of a departure row, RTC memory is too small for full rows
+struct RtcTransport {
+    char name[12];
+    char category[6];
+    char number[5];
+    char departure[6];
+    char destination[26];
+    int16_t delay;
+};
+
+struct RtcBoard {
+    char station[27];
+    uint8_t count;
+    RtcTransport rows[RTC_BOARD_ROWS];
+};
+
+struct RtcState {
+    uint32_t magic;
+    uint32_t crc;
+    bool isFirstStation;
+    bool inNightMode;
+    int8_t brightnessIndex;
+    int64_t nightModeExitTime;
+    int64_t deadlines[TASK_COUNT];  // wall clock in ms, esp_timer restarts after deep sleep
+    TimeSyncState timeSync;
+    uint32_t wakes;
+    RtcBoard boards[2];
+};
+
+RTC_DATA_ATTR static RtcState rtcState;
+
+unsigned long deepSleepWakes = 0;
+
+static uint32_t rtcCrc() {
+    return crc32_le(0, (const uint8_t*)&rtcState + 8, sizeof(rtcState) - 8);
+}
+
+static int64_t wallMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void packBoard(uint8_t index, RtcBoard& board) {
+    String station;
+    std::vector<Transport> transports;
+    board.count = 0;
+    if (!stationCacheGet(index, station, transports)) return;
+
+    strlcpy(board.station, station.c_str(), sizeof(board.station));
+    for (const Transport& t : transports) {
+        if (board.count >= RTC_BOARD_ROWS) break;
+        RtcTransport& row = board.rows[board.count++];
+        strlcpy(row.name, t.name.c_str(), sizeof(row.name));
+        strlcpy(row.category, t.category.c_str(), sizeof(row.category));
+        strlcpy(row.number, t.number.c_str(), sizeof(row.number));
+        strlcpy(row.departure, t.departure.c_str(), sizeof(row.departure));
+        strlcpy(row.destination, t.destination.c_str(), sizeof(row.destination));
+        row.delay = t.delay.toInt();
+    }
+}
+
+static void unpackBoard(uint8_t index, const RtcBoard& board) {
+    if (board.count == 0) return;
+
+    std::vector<Transport> transports;
+    for (uint8_t i = 0; i < board.count && i < RTC_BOARD_ROWS; i++) {
+        const RtcTransport& row = board.rows[i];
+        Transport t;
+        t.name = row.name;
+        t.category = row.category;
+        t.number = row.number;
+        t.departure = row.departure;
+        t.destination = row.destination;
+        t.delay.format("%d", row.delay);
+        transports.push_back(t);
+    }
+    stationCacheRestore(index, board.station, transports);
+}
+
+// Earliest deadline with the night fetches stretched to the deep-sleep interval
+static uint64_t deepSleepDuration() {
+    uint64_t now = schedulerNow();
+    if (schedulerPending(TASK_FETCH) && schedulerDeadline(TASK_FETCH) < now + DEEP_SLEEP_FETCH_INTERVAL) {
+        schedulerSet(TASK_FETCH, now + DEEP_SLEEP_FETCH_INTERVAL);
+    }
+    uint64_t duration = schedulerTimeUntilNext();
+    return duration == SCHEDULER_NONE ? DEEP_SLEEP_FETCH_INTERVAL : duration;
+}
+
+bool deepSleepAllowed() {
+    if (!config.nightDeepSleep || !inNightMode || temporaryNightWake || portalRunning) return false;
+    // A prefetched board lives in the panel memory, which deep sleep would lose
+    if (nightPrefetched || !timeIsSynced()) return false;
+
+    uint64_t now = schedulerNow();
+    for (int i = 0; i < TASK_COUNT; i++) {
+        if (i == TASK_FETCH || !schedulerPending((SchedulerTask)i)) continue;
+        if (schedulerDeadline((SchedulerTask)i) < now + DEEP_SLEEP_MIN_DURATION) return false;
+    }
+    return true;
+}
+
+void deepSleepEnter() {
+    uint64_t sleepMs = deepSleepDuration();
+
+    rtcState.isFirstStation = isFirstStation;
+    rtcState.inNightMode = inNightMode;
+    rtcState.brightnessIndex = currentBrightnessIndex;
+    rtcState.nightModeExitTime = nightModeExitTime;
+    rtcState.wakes = deepSleepWakes;
+    timeSyncSave(rtcState.timeSync);
+
+    uint64_t now = schedulerNow();
+    int64_t nowWall = wallMs();
+    for (int i = 0; i < TASK_COUNT; i++) {
+        uint64_t deadline = schedulerDeadline((SchedulerTask)i);
+        if (deadline == SCHEDULER_NONE) {
+            rtcState.deadlines[i] = 0;
+        } else {
+            rtcState.deadlines[i] = nowWall + (deadline > now ? (int64_t)(deadline - now) : 0);
+        }
+    }
+    packBoard(0, rtcState.boards[0]);
+    packBoard(1, rtcState.boards[1]);
+    rtcState.magic = RTC_MAGIC;
+    rtcState.crc = rtcCrc();
+
+    // Panel off, the backlight pin is held low through deep sleep
+    tft.writecommand(0x28); // display off
+    tft.writecommand(0x10); // sleep in
+    ledcDetachPin(BACKLIGHT_PIN);
+    pinMode(BACKLIGHT_PIN, OUTPUT);
+    digitalWrite(BACKLIGHT_PIN, LOW);
+    gpio_hold_en((gpio_num_t)BACKLIGHT_PIN);
+    gpio_deep_sleep_hold_en();
+
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+
+    esp_sleep_enable_timer_wakeup(sleepMs * 1000ULL);
+    esp_sleep_enable_ext0_wakeup(BUTTON_WAKE, 0);
+
+    Serial.printf("Entering deep sleep for %llu s\n", sleepMs / 1000);
+    Serial.flush();
+    esp_deep_sleep_start();
+}
+
+bool deepSleepResume() {
+    gpio_hold_dis((gpio_num_t)BACKLIGHT_PIN);
+    gpio_deep_sleep_hold_dis();
+
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (cause != ESP_SLEEP_WAKEUP_TIMER && cause != ESP_SLEEP_WAKEUP_EXT0) return false;
+    if (rtcState.magic != RTC_MAGIC || rtcState.crc != rtcCrc()) {
+        Serial.println("No valid RTC state, full boot");
+        return false;
+    }
+    rtcState.magic = 0; // consumed, a crash later on takes the full boot path
+
+    isFirstStation = rtcState.isFirstStation;
+    inNightMode = rtcState.inNightMode;
+    currentBrightnessIndex = rtcState.brightnessIndex;
+    nightModeExitTime = rtcState.nightModeExitTime;
+    nightPrefetched = false;
+    deepSleepWakes = rtcState.wakes + 1;
+    timeSyncRestore(rtcState.timeSync);
+
+    uint64_t now = schedulerNow();
+    int64_t nowWall = wallMs();
+    for (int i = 0; i < TASK_COUNT; i++) {
+        if (rtcState.deadlines[i] == 0) {
+            schedulerCancel((SchedulerTask)i);
+        } else {
+            int64_t remaining = rtcState.deadlines[i] - nowWall;
+            schedulerSet((SchedulerTask)i, now + (remaining > 0 ? remaining : 0));
+        }
+    }
+    unpackBoard(0, rtcState.boards[0]);
+    unpackBoard(1, rtcState.boards[1]);
+
+    Serial.printf("Resumed from deep sleep (%s), wake %lu\n",
+                  cause == ESP_SLEEP_WAKEUP_EXT0 ? "button" : "timer", deepSleepWakes);
+    return true;
+}
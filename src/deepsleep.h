@@ -0,0 +1,15 @@
+#ifndef DEEPSLEEP_H
+#define DEEPSLEEP_H
+
+#include <Arduino.h>
+
+// Optional deep sleep through long dark windows (night mode). Boards, scheduler
+// deadlines and the clock discipline are kept in RTC slow memory, the wake path
+// skips WiFiManager and the reset prompt.
+extern unsigned long deepSleepWakes;
+
+bool deepSleepResume();
+bool deepSleepAllowed();
+void deepSleepEnter();
+
+#endif // DEEPSLEEP_H
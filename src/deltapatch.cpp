@@ -0,0 +1,171 @@
+#include "deltapatch.h"
+#include <string.h>
+
+// CRC-32 (zlib polynomial), nibble table to keep it small on the device
+static const uint32_t crcNibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t deltaCrc32(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crcNibble[crc & 0x0F];
+        crc = (crc >> 4) ^ crcNibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+void deltaWriteHeader(const DeltaHeader& header, uint8_t* out) {
+    writeU32(out, header.magic);
+    out[4] = header.version;
+    out[5] = header.version >> 8;
+    out[6] = header.flags;
+    out[7] = header.flags >> 8;
+    writeU32(out + 8, header.oldSize);
+    writeU32(out + 12, header.oldCrc);
+    writeU32(out + 16, header.newSize);
+    writeU32(out + 20, header.newCrc);
+}
+
+void deltaReadHeader(const uint8_t* in, DeltaHeader& header) {
+    header.magic = readU32(in);
+    header.version = in[4] | (in[5] << 8);
+    header.flags = in[6] | (in[7] << 8);
+    header.oldSize = readU32(in + 8);
+    header.oldCrc = readU32(in + 12);
+    header.newSize = readU32(in + 16);
+    header.newCrc = readU32(in + 20);
+}
+
+DeltaPatcher::DeltaPatcher(DeltaTarget& target) : target(target) {
+    reset();
+}
+
+void DeltaPatcher::reset() {
+    memset(&hdr, 0, sizeof(hdr));
+    state = HEADER;
+    argFill = 0;
+    literalLeft = 0;
+    outSize = 0;
+    outCrc = 0;
+    error = nullptr;
+}
+
+bool DeltaPatcher::fail(const char* message) {
+    if (!error) error = message;
+    return false;
+}
+
+// Header complete: the patch only applies to the exact image it was made from
+bool DeltaPatcher::start() {
+    deltaReadHeader(args, hdr);
+    if (hdr.magic != DELTA_MAGIC) return fail("not a delta patch");
+    if (hdr.version != DELTA_VERSION) return fail("unsupported patch version");
+
+    uint32_t crc = 0;
+    for (uint32_t offset = 0; offset < hdr.oldSize; offset += DELTA_WINDOW) {
+        uint32_t chunk = hdr.oldSize - offset < DELTA_WINDOW ? hdr.oldSize - offset : DELTA_WINDOW;
+        if (!target.readOld(offset, window, chunk)) return fail("old image read failed");
+        crc = deltaCrc32(crc, window, chunk);
+    }
+    if (crc != hdr.oldCrc) return fail("patch was made for a different firmware");
+    if (!target.begin(hdr)) return fail("target rejected the new image");
+    return true;
+}
+
+bool DeltaPatcher::emit(const uint8_t* buf, size_t len) {
+    if (outSize + len > hdr.newSize) return fail("patch writes past the new image");
+    if (!target.writeNew(buf, len)) return fail("new image write failed");
+    outCrc = deltaCrc32(outCrc, buf, len);
+    outSize += len;
+    return true;
+}
+
+bool DeltaPatcher::copy(uint32_t offset, uint32_t length) {
+    if (offset > hdr.oldSize || length > hdr.oldSize - offset) return fail("copy outside the old image");
+    while (length > 0) {
+        uint32_t chunk = length < DELTA_WINDOW ? length : DELTA_WINDOW;
+        if (!target.readOld(offset, window, chunk)) return fail("old image read failed");
+        if (!emit(window, chunk)) return false;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool DeltaPatcher::feed(const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len && !error) {
+        switch (state) {
+            case HEADER:
+                args[argFill++] = data[pos++];
+                if (argFill == DELTA_HEADER_SIZE) {
+                    argFill = 0;
+                    if (start()) state = OPCODE;
+                }
+                break;
+
+            case OPCODE: {
+                uint8_t op = data[pos++];
+                if (op == DELTA_OP_END) state = DONE;
+                else if (op == DELTA_OP_COPY) state = COPY_ARGS;
+                else if (op == DELTA_OP_LITERAL) state = LITERAL_ARGS;
+                else fail("unknown patch op");
+                break;
+            }
+
+            case COPY_ARGS:
+                args[argFill++] = data[pos++];
+                if (argFill == 8) {
+                    argFill = 0;
+                    if (copy(readU32(args), readU32(args + 4))) state = OPCODE;
+                }
+                break;
+
+            case LITERAL_ARGS:
+                args[argFill++] = data[pos++];
+                if (argFill == 4) {
+                    argFill = 0;
+                    literalLeft = readU32(args);
+                    state = literalLeft ? LITERAL_DATA : OPCODE;
+                }
+                break;
+
+            case LITERAL_DATA: {
+                size_t chunk = len - pos < literalLeft ? len - pos : literalLeft;
+                if (emit(data + pos, chunk)) {
+                    pos += chunk;
+                    literalLeft -= chunk;
+                    if (literalLeft == 0) state = OPCODE;
+                }
+                break;
+            }
+
+            case DONE:
+                fail("data after the end of the patch");
+                break;
+        }
+    }
+    return !error;
+}
+
+bool DeltaPatcher::finish() {
+    if (error) return false;
+    if (state != DONE) return fail("patch truncated");
+    if (outSize != hdr.newSize) return fail("new image size mismatch");
+    if (outCrc != hdr.newCrc) return fail("new image checksum mismatch");
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef DELTAPATCH_H
+#define DELTAPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Delta firmware patch, shared by the device applier and tools/deltagen.
+// No Arduino dependencies, the same code verifies patches on the host.
+//
+// Layout (little-endian):
+//   header   magic "SBD1", version, flags, old size/crc32, new size/crc32
+//   ops      DELTA_OP_COPY    u32 old offset, u32 length
+//            DELTA_OP_LITERAL u32 length, bytes
+//            DELTA_OP_END
+#define DELTA_MAGIC 0x31444253   // "SBD1"
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 24
+#define DELTA_WINDOW 1024        // RAM window for copies from the old image
+
+enum DeltaOp : uint8_t {
+    DELTA_OP_END = 0,
+    DELTA_OP_COPY = 1,
+    DELTA_OP_LITERAL = 2
+};
+
+struct DeltaHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t oldSize;
+    uint32_t oldCrc;
+    uint32_t newSize;
+    uint32_t newCrc;
+};
+
+uint32_t deltaCrc32(uint32_t crc, const uint8_t* data, size_t len);
+void deltaWriteHeader(const DeltaHeader& header, uint8_t* out);
+void deltaReadHeader(const uint8_t* in, DeltaHeader& header);
+
+// Old image in, new image out
+class DeltaTarget {
+public:
+    virtual ~DeltaTarget() {}
+    virtual bool readOld(uint32_t offset, uint8_t* buf, size_t len) = 0;
+    virtual bool begin(const DeltaHeader& header) = 0;   // old image verified
+    virtual bool writeNew(const uint8_t* buf, size_t len) = 0;
+};
+
+// Applies a patch fed in arbitrary chunks (e.g. straight from an HTTP upload)
+class DeltaPatcher {
+public:
+    explicit DeltaPatcher(DeltaTarget& target);
+
+    void reset();
+    bool feed(const uint8_t* data, size_t len);
+    bool finish();   // END seen, size and crc of the new image match
+
+    bool failed() const { return error != nullptr; }
+    const char* lastError() const { return error ? error : "none"; }
+    const DeltaHeader& header() const { return hdr; }
+    uint32_t written() const { return outSize; }
+
+private:
+    enum State : uint8_t { HEADER, OPCODE, COPY_ARGS, LITERAL_ARGS, LITERAL_DATA, DONE };
+
+    bool fail(const char* message);
+    bool start();
+    bool copy(uint32_t offset, uint32_t length);
+    bool emit(const uint8_t* buf, size_t len);
+
+    DeltaTarget& target;
+    DeltaHeader hdr;
+    State state;
+    uint8_t args[DELTA_HEADER_SIZE];
+    uint8_t argFill;
+    uint32_t literalLeft;
+    uint32_t outSize;
+    uint32_t outCrc;
+    const char* error;
+    uint8_t window[DELTA_WINDOW];
+};
+
+#endif // DELTAPATCH_H
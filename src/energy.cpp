@@ -0,0 +1,157 @@
+#include "energy.h"
+#include "globals.h"
+#include <SPIFFS.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+
+// Currents in mA, defaults from the board measurements in the README
+struct EnergyModel {
+    float cpu240 = 50.0f;
+    float cpu160 = 40.0f;
+    float cpu80 = 22.0f;
+    float lightSleep = 0.8f;
+    float radioActive = 100.0f;
+    float radioModemSleep = 5.0f;
+    float panel = 10.0f;
+    float backlight = 75.0f;     // at full duty, scaled linearly
+    float supplyVoltage = 5.0f;
+};
+
+static const char* PHASE_NAMES[ENERGY_PHASE_COUNT] = {"idle", "connect", "refresh", "sleep"};
+
+static EnergyModel model;
+
+// Current state
+static uint32_t cpuMhz = 240;
+static bool radioActive = true;
+static uint32_t backlightDuty = 0;
+static bool sleeping = false;
+static EnergyPhase phase = ENERGY_IDLE;
+static EnergyPhase phaseBeforeSleep = ENERGY_IDLE;
+
+// Integrated charge in mA*us per phase
+static int64_t lastUpdateUs = 0;
+static int64_t startUs = 0;
+static double charge[ENERGY_PHASE_COUNT] = {0, 0, 0, 0};
+static int64_t phaseTime[ENERGY_PHASE_COUNT] = {0, 0, 0, 0};
+static unsigned long refreshes = 0;
+
+static float awakeCurrent(uint32_t mhz) {
+    float current = mhz >= 240 ? model.cpu240 : mhz >= 160 ? model.cpu160 : model.cpu80;
+    current += radioActive ? model.radioActive : model.radioModemSleep;
+    return current + model.panel + model.backlight * backlightDuty / 255.0f;
+}
+
+static float stateCurrent() {
+    if (sleeping) {
+        return model.lightSleep + model.radioModemSleep + model.panel + model.backlight * backlightDuty / 255.0f;
+    }
+    return awakeCurrent(cpuMhz);
+}
+
+// Integrate the time since the last change at the old state
+static void energyUpdate() {
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - lastUpdateUs;
+    lastUpdateUs = now;
+    if (elapsed <= 0) return;
+    charge[phase] += (double)stateCurrent() * (double)elapsed;
+    phaseTime[phase] += elapsed;
+}
+
+static double toMah(double mAus) {
+    return mAus / 3.6e9;
+}
+
+void energyBegin() {
+    startUs = lastUpdateUs = esp_timer_get_time();
+    cpuMhz = getCpuFrequencyMhz();
+
+    if (!SPIFFS.exists("/energy.json")) return;
+    File file = SPIFFS.open("/energy.json", FILE_READ);
+    if (!file) return;
+
+    DynamicJsonDocument doc(512);
+    if (!deserializeJson(doc, file)) {
+        model.cpu240 = doc["cpu240"] | model.cpu240;
+        model.cpu160 = doc["cpu160"] | model.cpu160;
+        model.cpu80 = doc["cpu80"] | model.cpu80;
+        model.lightSleep = doc["lightSleep"] | model.lightSleep;
+        model.radioActive = doc["radioActive"] | model.radioActive;
+        model.radioModemSleep = doc["radioModemSleep"] | model.radioModemSleep;
+        model.panel = doc["panel"] | model.panel;
+        model.backlight = doc["backlight"] | model.backlight;
+        model.supplyVoltage = doc["supplyVoltage"] | model.supplyVoltage;
+        Serial.println("Energy model calibrated from /energy.json");
+    }
+    file.close();
+}
+
+void energyPhase(EnergyPhase next) {
+    if (next == phase) return;
+    energyUpdate();
+    phase = next;
+}
+
+void energyCpu(uint32_t mhz) {
+    if (mhz == cpuMhz) return;
+    energyUpdate();
+    cpuMhz = mhz;
+}
+
+void energyRadio(bool active) {
+    if (active == radioActive) return;
+    energyUpdate();
+    radioActive = active;
+}
+
+void energyBacklight(uint32_t duty) {
+    if (duty == backlightDuty) return;
+    energyUpdate();
+    backlightDuty = duty;
+}
+
+void energySleep(bool enter) {
+    if (enter == sleeping) return;
+    energyUpdate();
+    sleeping = enter;
+    if (enter) {
+        phaseBeforeSleep = phase;
+        phase = ENERGY_SLEEP;
+    } else {
+        phase = phaseBeforeSleep;
+    }
+}
+
+void energyRefreshDone() {
+    refreshes++;
+}
+
+float energyAverageCurrent() {
+    energyUpdate();
+    double total = 0;
+    for (int i = 0; i < ENERGY_PHASE_COUNT; i++) total += charge[i];
+    int64_t elapsed = lastUpdateUs - startUs;
+    return elapsed > 0 ? total / elapsed : 0.0f;
+}
+
+// Current of the present radio and backlight state at another CPU clock
+float energyCurrentAt(uint32_t mhz) {
+    return awakeCurrent(mhz);
+}
+
+void energyReport() {
+    float average = energyAverageCurrent();
+    double total = 0;
+    for (int i = 0; i < ENERGY_PHASE_COUNT; i++) total += charge[i];
+
+    Serial.printf("Energy v" FIRMWARE_VERSION ": %.1f mA avg (%.0f mW at %.1f V), %.2f mAh/h\n",
+                  average, average * model.supplyVoltage, model.supplyVoltage, average);
+    if (refreshes > 0) {
+        Serial.printf("Per refresh: %.3f mAh total, %.3f mAh connect+refresh (%lu refreshes)\n",
+                      toMah(total) / refreshes, toMah(charge[ENERGY_CONNECT] + charge[ENERGY_REFRESH]) / refreshes, refreshes);
+    }
+    for (int i = 0; i < ENERGY_PHASE_COUNT; i++) {
+        Serial.printf("  %-8s %6lu s %8.3f mAh\n", PHASE_NAMES[i], (unsigned long)(phaseTime[i] / 1000000), toMah(charge[i]));
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <Arduino.h>
+
+// Charge model integrated over CPU frequency, radio profile, light sleep and
+// backlight duty. Per-state currents come from /energy.json when present.
+enum EnergyPhase {
+    ENERGY_IDLE,
+    ENERGY_CONNECT,
+    ENERGY_REFRESH,
+    ENERGY_SLEEP,
+    ENERGY_PHASE_COUNT
+};
+
+void energyBegin();
+void energyPhase(EnergyPhase phase);
+void energyCpu(uint32_t mhz);
+void energyRadio(bool active);
+void energyBacklight(uint32_t duty);
+void energySleep(bool sleeping);
+void energyRefreshDone();
+float energyAverageCurrent();
+float energyCurrentAt(uint32_t mhz);
+void energyReport();
+
+#endif // ENERGY_H
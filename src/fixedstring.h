@@ -0,0 +1,174 @@
+#ifndef FIXEDSTRING_H
+#define FIXEDSTRING_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Inline string with a fixed capacity of N - 1 characters. Never allocates;
+// text that does not fit is cut and truncated() reports it. Used for
+// transport rows, URLs and formatted times on the refresh path.
+template <size_t N>
+class FixedString {
+public:
+    FixedString() { clear(); }
+    FixedString(const char* text) { assign(text); }
+    FixedString(const String& text) { assign(text.c_str(), text.length()); }
+    template <size_t M>
+    FixedString(const FixedString<M>& other) { assign(other.c_str(), other.length()); }
+
+    FixedString& operator=(const char* text) { return assign(text); }
+    FixedString& operator=(const String& text) { return assign(text.c_str(), text.length()); }
+    template <size_t M>
+    FixedString& operator=(const FixedString<M>& other) { return assign(other.c_str(), other.length()); }
+
+    FixedString& assign(const char* text, size_t count = SIZE_MAX) {
+        clear();
+        return append(text, count);
+    }
+
+    FixedString& append(char c) {
+        if (len < N - 1) {
+            buf[len++] = c;
+            buf[len] = '\0';
+        } else {
+            cut = true;
+        }
+        return *this;
+    }
+
+    FixedString& append(const char* text, size_t count = SIZE_MAX) {
+        if (!text) return *this;
+        while (count-- && *text) {
+            if (len >= N - 1) {
+                cut = true;
+                break;
+            }
+            buf[len++] = *text++;
+        }
+        buf[len] = '\0';
+        return *this;
+    }
+
+    template <size_t M>
+    FixedString& append(const FixedString<M>& other) { return append(other.c_str(), other.length()); }
+
+    FixedString& operator+=(char c) { return append(c); }
+    FixedString& operator+=(const char* text) { return append(text); }
+    template <size_t M>
+    FixedString& operator+=(const FixedString<M>& other) { return append(other); }
+
+    FixedString& appendf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        vappendf(fmt, args);
+        va_end(args);
+        return *this;
+    }
+
+    FixedString& format(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        clear();
+        va_list args;
+        va_start(args, fmt);
+        vappendf(fmt, args);
+        va_end(args);
+        return *this;
+    }
+
+    // Query-string encoding, unreserved characters stay as they are
+    FixedString& appendUrlEncoded(const char* text) {
+        static const char hex[] = "0123456789ABCDEF";
+        for (; text && *text; text++) {
+            uint8_t c = *text;
+            if (isAlphaNumeric(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+                append((char)c);
+            } else {
+                append('%');
+                append(hex[c >> 4]);
+                append(hex[c & 0xF]);
+            }
+        }
+        return *this;
+    }
+
+    // Pads with spaces up to width characters
+    FixedString& pad(size_t width) {
+        while (len < width && len < N - 1) append(' ');
+        return *this;
+    }
+
+    void truncate(size_t length) {
+        if (length < len) {
+            len = length;
+            buf[len] = '\0';
+        }
+    }
+
+    void trim() {
+        size_t start = 0;
+        while (start < len && isspace((uint8_t)buf[start])) start++;
+        while (len > start && isspace((uint8_t)buf[len - 1])) len--;
+        memmove(buf, buf + start, len - start);
+        len -= start;
+        buf[len] = '\0';
+    }
+
+    FixedString substring(size_t from, size_t to = SIZE_MAX) const {
+        FixedString result;
+        if (from < len) result.assign(buf + from, (to > len ? len : to) - from);
+        return result;
+    }
+
+    void clear() {
+        len = 0;
+        cut = false;
+        buf[0] = '\0';
+    }
+
+    const char* c_str() const { return buf; }
+    size_t length() const { return len; }
+    static constexpr size_t capacity() { return N - 1; }
+    bool isEmpty() const { return len == 0; }
+    bool truncated() const { return cut; }
+    long toInt() const { return atol(buf); }
+    bool startsWith(const char* prefix) const { return strncmp(buf, prefix, strlen(prefix)) == 0; }
+    bool endsWith(const char* suffix) const {
+        size_t n = strlen(suffix);
+        return n <= len && memcmp(buf + len - n, suffix, n) == 0;
+    }
+
+    const char* begin() const { return buf; }
+    const char* end() const { return buf + len; }
+    char operator[](size_t i) const { return i < len ? buf[i] : '\0'; }
+
+    bool operator==(const char* text) const { return strcmp(buf, text) == 0; }
+    bool operator!=(const char* text) const { return strcmp(buf, text) != 0; }
+    template <size_t M>
+    bool operator==(const FixedString<M>& other) const { return strcmp(buf, other.c_str()) == 0; }
+    template <size_t M>
+    bool operator!=(const FixedString<M>& other) const { return strcmp(buf, other.c_str()) != 0; }
+    template <size_t M>
+    bool operator<(const FixedString<M>& other) const { return strcmp(buf, other.c_str()) < 0; }
+    template <size_t M>
+    bool operator>(const FixedString<M>& other) const { return strcmp(buf, other.c_str()) > 0; }
+
+private:
+    void vappendf(const char* fmt, va_list args) {
+        int written = vsnprintf(buf + len, N - len, fmt, args);
+        if (written < 0) {
+            buf[len] = '\0';
+            return;
+        }
+        if ((size_t)written >= N - len) {
+            cut = true;
+            len = N - 1;
+        } else {
+            len += written;
+        }
+    }
+
+    char buf[N];
+    uint16_t len;
+    bool cut;
+};
+
+#endif // FIXEDSTRING_H
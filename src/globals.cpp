@@ -1,5 +1,4 @@
 #include "globals.h"
-#include <WiFiUDP.h>
 
 Config config;
 bool isFirstStation = true; // Start with first station
@@ -13,7 +12,6 @@ bool shouldSaveConfig = false;
 bool portalRunning = false;
 int numClicks = 0;
 
-const long timeOffset = 0; // UTC (DST handled by Timezone library in utilities.cpp)
 const unsigned long HTTP_TIMEOUT = 10000;
 const char* getBTCAPI = "https://api.coinbase.com/v2/prices/BTC-USD/spot";
 
@@ -33,16 +31,17 @@ const unsigned long TEMP_ON_DURATION = 300000;
 // Night mode state
 bool inNightMode = false;
 bool temporaryNightWake = false;
-unsigned long nightWakeStartTime = 0;
 const unsigned long NIGHT_WAKE_DURATION = 30000; // 30 seconds
 const unsigned long NIGHT_CHECK_INTERVAL = 300000; // 5 minutes
+const unsigned long NIGHT_PREFETCH_LEAD = 120000; // fetch the morning board 2 minutes before night mode ends
+time_t nightModeExitTime = 0;
+bool nightPrefetched = false;
 bool forceRefresh = false;
 
 unsigned long previousMillis = 0;
-const unsigned long SLEEP_DURATION = 57000000;    // 57 seconds (57,000,000 µs)
+const unsigned long MIN_SLEEP_DURATION = 50; // ms, shorter waits are spent in the loop
 const unsigned long UPDATE_INTERVAL = 60000; // 60 seconds between updates
 const unsigned long UPDATE_DURATION = 5000; // 5 seconds for update to complete
+const unsigned long INACTIVE_STATION_INTERVAL = 300000; // 5 minutes between fetches of the hidden station
 
 OneButton button(BUTTON_PIN, true);
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP, "pool.ntp.org", timeOffset);
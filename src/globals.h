@@ -5,7 +5,6 @@
 #include <TFT_eSPI.h>
 #include <WiFiManager.h>
 #include <OneButton.h>
-#include <NTPClient.h>
 #include "NotoSansBold15.h"
 
 // Config parameters from the WIFIManager Setup
@@ -15,6 +14,10 @@ struct Config {
     int limit = 8;
     int offset = 0;
     int defaultBrightness = 4;
+    String staticIp = "";  // empty: DHCP
+    int provider = 0;          // data source, ProviderId in provider.h
+    String providerUrl = "";   // empty: the provider's default endpoint
+    String providerKey = "";   // sent as the Authorization header
     // Night mode settings
     bool nightModeEnabled = false;
     int nightModeStartHour = 22;
@@ -22,6 +25,7 @@ struct Config {
     int nightModeEndHour = 7;
     int nightModeEndMinute = 0;
     bool nightModeWeekendDisable = false;
+    bool nightDeepSleep = false;  // deep sleep instead of light sleep while dark
 };
 
 extern Config config;
@@ -34,7 +38,6 @@ extern int numClicks;
 extern bool portalRunning;
 
 // Constants
-extern const long timeOffset;
 extern const unsigned long HTTP_TIMEOUT;
 extern const char* getBTCAPI;
 
@@ -71,25 +74,26 @@ extern const unsigned long TEMP_ON_DURATION;
 // Night mode state
 extern bool inNightMode;
 extern bool temporaryNightWake;
-extern unsigned long nightWakeStartTime;
 extern const unsigned long NIGHT_WAKE_DURATION;
 extern const unsigned long NIGHT_CHECK_INTERVAL;
+extern const unsigned long NIGHT_PREFETCH_LEAD;
+extern time_t nightModeExitTime;
+extern bool nightPrefetched;
 extern bool forceRefresh;
 
 // Loop refresh cycle
 extern unsigned long previousMillis;
-extern const unsigned long SLEEP_DURATION;
+extern const unsigned long MIN_SLEEP_DURATION;
 extern const unsigned long UPDATE_INTERVAL;
 extern const unsigned long UPDATE_DURATION;
+extern const unsigned long INACTIVE_STATION_INTERVAL;
 
 // Objects
 extern OneButton button;
-extern NTPClient timeClient;
-extern WiFiUDP ntpUDP;
 
 // Function declarations
 void displayStatus(bool isSuccess);
-void lightSleep();
+void lightSleep(uint64_t sleepDuration);
 void checkForConfigReset();
 void loadConfiguration();
 void saveConfiguration();
@@ -0,0 +1,96 @@
+#include "governor.h"
+#include "utilities.h"
+#include "energy.h"
+
+#define GOV_FREQ_COUNT 3
+
+static const uint32_t GOV_FREQS[GOV_FREQ_COUNT] = {80, 160, 240};
+static const uint32_t GOV_MIN_SAMPLES = 3;        // samples per clock before choosing
+static const uint32_t GOV_EXPLORE_EVERY = 32;     // retry the other clocks now and then
+static const float GOV_HYSTERESIS = 0.9f;         // a new clock has to be 10% cheaper
+static const unsigned long GOV_SWITCH_MIN_MS = 20; // shorter phases keep the current clock
+
+static const char* PHASE_NAMES[GOV_PHASE_COUNT] = {"idle", "network", "parse", "render", "ota"};
+
+struct PhaseStats {
+    uint32_t count;
+    uint32_t totalMs;
+    float charge;   // mA*ms, from the energy model at the time
+};
+
+static PhaseStats stats[GOV_PHASE_COUNT][GOV_FREQ_COUNT];
+static uint8_t chosen[GOV_PHASE_COUNT] = {0, 2, 2, 2, 2};
+static uint32_t phaseSamples[GOV_PHASE_COUNT];
+static GovernorPhase currentPhase = GOV_IDLE;
+static uint8_t currentFreq = 2;
+static unsigned long phaseStart = 0;
+
+static bool learned(GovernorPhase phase) {
+    return phase == GOV_NETWORK || phase == GOV_PARSE || phase == GOV_RENDER;
+}
+
+static float costPerInstance(GovernorPhase phase, uint8_t f) {
+    const PhaseStats& s = stats[phase][f];
+    return s.count ? s.charge / s.count : 0.0f;
+}
+
+static uint8_t selectFreq(GovernorPhase phase) {
+    if (phase == GOV_IDLE) return 0;
+    if (phase == GOV_OTA) return GOV_FREQ_COUNT - 1;
+
+    // Explore until every clock has a few samples, and once in a while after that
+    uint8_t least = 0;
+    for (uint8_t f = 1; f < GOV_FREQ_COUNT; f++) {
+        if (stats[phase][f].count < stats[phase][least].count) least = f;
+    }
+    if (stats[phase][least].count < GOV_MIN_SAMPLES) return least;
+    if (phaseSamples[phase] % GOV_EXPLORE_EVERY == 0) return least;
+
+    uint8_t best = chosen[phase];
+    for (uint8_t f = 0; f < GOV_FREQ_COUNT; f++) {
+        if (costPerInstance(phase, f) < costPerInstance(phase, best)) best = f;
+    }
+    if (costPerInstance(phase, best) < costPerInstance(phase, chosen[phase]) * GOV_HYSTERESIS) {
+        chosen[phase] = best;
+    }
+    return chosen[phase];
+}
+
+void governorPhase(GovernorPhase phase) {
+    if (phase == currentPhase) return;
+
+    // Close the running sample at the clock it ran with
+    unsigned long now = millis();
+    if (learned(currentPhase)) {
+        unsigned long duration = now - phaseStart;
+        PhaseStats& s = stats[currentPhase][currentFreq];
+        s.count++;
+        s.totalMs += duration;
+        s.charge += duration * energyCurrentAt(GOV_FREQS[currentFreq]);
+        phaseSamples[currentPhase]++;
+    }
+    currentPhase = phase;
+    phaseStart = now;
+
+    uint8_t f = selectFreq(phase);
+    if (f != currentFreq && learned(phase) && stats[phase][f].count >= GOV_MIN_SAMPLES &&
+        stats[phase][f].totalMs / stats[phase][f].count < GOV_SWITCH_MIN_MS) {
+        f = currentFreq; // too short to be worth the switch
+    }
+    currentFreq = f;
+    setCpuSpeed(GOV_FREQS[f]);
+}
+
+void governorReport() {
+    for (int p = GOV_NETWORK; p <= GOV_RENDER; p++) {
+        Serial.printf("Governor %s: %u MHz", PHASE_NAMES[p], GOV_FREQS[chosen[p]]);
+        for (uint8_t f = 0; f < GOV_FREQ_COUNT; f++) {
+            const PhaseStats& s = stats[p][f];
+            if (s.count == 0) continue;
+            // charge per instance in uAh
+            Serial.printf(" | %u: %lu ms %.2f uAh (%lu)", GOV_FREQS[f], (unsigned long)(s.totalMs / s.count),
+                          s.charge / s.count / 3600.0f, (unsigned long)s.count);
+        }
+        Serial.println();
+    }
+}
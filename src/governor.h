@@ -0,0 +1,21 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <Arduino.h>
+
+// CPU frequency per workload phase, learned from measured phase durations
+// and the energy model: each phase runs at the clock with the lowest charge
+// per instance, with hysteresis so short phases do not pay for a switch
+enum GovernorPhase {
+    GOV_IDLE,       // waiting for the next deadline, fixed at the lowest clock
+    GOV_NETWORK,    // connect, request, download
+    GOV_PARSE,      // JSON parsing
+    GOV_RENDER,     // sprite rasterizing and pushing
+    GOV_OTA,        // firmware upload, fixed at the highest clock
+    GOV_PHASE_COUNT
+};
+
+void governorPhase(GovernorPhase phase);
+void governorReport();
+
+#endif // GOVERNOR_H
@@ -0,0 +1,49 @@
+#include "gtfsprovider.h"
+#include "globals.h"
+#include "utilities.h"
+#include "timesync.h"
+#include <TimeLib.h>
+
+static const char* GTFS_URL = "https://api.opentransportdata.swiss/gtfsrt2020";
+
+GtfsProvider::GtfsProvider() : decoder(board), sink(nullptr), limit(0) {}
+
+// The feed is always the whole network, only the stop and limit are kept for parsing
+bool GtfsProvider::request(const char* stationId, int limit, const char* datetime, ProviderRequest& request) {
+    request.url = config.providerUrl.isEmpty() ? GTFS_URL : config.providerUrl.c_str();
+    if (!config.providerKey.isEmpty()) request.authorization = config.providerKey.c_str();
+    stopId = stationId;
+    this->limit = limit;
+    return !stopId.truncated();
+}
+
+void GtfsProvider::begin(DepartureSink& sink) {
+    this->sink = &sink;
+    board.begin(stopId.c_str(), timeIsSynced() ? timeNow() + config.offset * 60 : 0, limit);
+    decoder.reset();
+    sink.setStation(stopId.c_str());
+}
+
+bool GtfsProvider::feed(const uint8_t* data, size_t len) {
+    return decoder.feed(data, len);
+}
+
+bool GtfsProvider::finish() {
+    bool complete = decoder.finish();
+    Serial.printf("GTFS-RT: %u bytes, %u entities, %u trips at %s\n",
+                  decoder.consumed(), board.entities(), board.matches(), stopId.c_str());
+    if (!complete) return false;
+
+    for (size_t i = 0; i < board.count(); i++) {
+        const GtfsDeparture& d = board.row(i);
+        Transport t;
+        t.name = d.tripId; // journey key for polling
+        t.number = d.shortName[0] ? d.shortName : d.routeId;
+        t.destination = d.headsign;
+        time_t planned = localFromUtc(d.time - d.delay);
+        t.departure.format("%02d:%02d", hour(planned), minute(planned));
+        t.delay.format("%d", (d.delay + (d.delay >= 0 ? 30 : -30)) / 60);
+        if (!sink->add(t)) break;
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef GTFSPROVIDER_H
+#define GTFSPROVIDER_H
+
+#include "provider.h"
+#include "gtfsrt.h"
+
+// Departures at a stop from a GTFS-Realtime TripUpdates feed. The feed covers
+// every trip of the operator, it is decoded as it streams in and only the
+// rows at the stop are kept. Station IDs are stop IDs, the feed has no names.
+class GtfsProvider : public DataProvider {
+public:
+    GtfsProvider();
+
+    const char* name() const override { return "GTFS-RT"; }
+    bool request(const char* stationId, int limit, const char* datetime, ProviderRequest& request) override;
+    void begin(DepartureSink& sink) override;
+    bool feed(const uint8_t* data, size_t len) override;
+    bool finish() override;
+
+private:
+    GtfsBoard board;
+    ProtoDecoder decoder;
+    DepartureSink* sink;
+    FixedString<32> stopId;
+    int limit;
+};
+
+#endif // GTFSPROVIDER_H
@@ -0,0 +1,295 @@
+#include "gtfsrt.h"
+#include <string.h>
+
+// Field numbers from gtfs-realtime.proto
+enum : uint32_t {
+    FEED_HEADER = 1,
+    FEED_ENTITY = 2,
+    HEADER_TIMESTAMP = 3,
+    ENTITY_IS_DELETED = 2,
+    ENTITY_TRIP_UPDATE = 3,
+    TRIP_UPDATE_TRIP = 1,
+    TRIP_UPDATE_STOP_TIME = 2,
+    TRIP_UPDATE_VEHICLE = 3,
+    TRIP_UPDATE_DELAY = 5,
+    TRIP_UPDATE_PROPERTIES = 6,
+    TRIP_ID = 1,
+    TRIP_SCHEDULE = 4,
+    TRIP_ROUTE_ID = 5,
+    STOP_TIME_ARRIVAL = 2,
+    STOP_TIME_DEPARTURE = 3,
+    STOP_TIME_STOP_ID = 4,
+    STOP_TIME_SCHEDULE = 5,
+    EVENT_DELAY = 1,
+    EVENT_TIME = 2,
+    VEHICLE_LABEL = 2,
+    PROPERTIES_HEADSIGN = 5,
+    PROPERTIES_SHORT_NAME = 6,
+};
+
+static const uint64_t TRIP_CANCELED = 3;
+static const uint64_t TRIP_DELETED = 7;
+static const uint64_t STOP_SKIPPED = 1;
+static const uint64_t STOP_NO_DATA = 2;
+
+ProtoDecoder::ProtoDecoder(ProtoListener& listener) : listener(listener) {
+    reset();
+}
+
+void ProtoDecoder::reset() {
+    state = TAG;
+    value = 0;
+    shift = 0;
+    field = 0;
+    remaining = 0;
+    offset = 0;
+    depth = 0;
+    error = false;
+}
+
+// Back to the next tag, closing every message that ends here
+void ProtoDecoder::fieldDone() {
+    state = TAG;
+    while (depth > 0 && offset >= frames[depth - 1].end) {
+        if (offset > frames[depth - 1].end) {
+            error = true; // field ran past the end of its message
+            return;
+        }
+        depth--;
+        listener.end(depth, frames[depth].field);
+    }
+}
+
+bool ProtoDecoder::feed(const uint8_t* data, size_t len) {
+    size_t i = 0;
+    while (i < len && !error) {
+        if (state == BYTES || state == SKIP) {
+            size_t n = len - i < remaining ? len - i : remaining;
+            if (state == BYTES) listener.bytes(depth, field, data + i, n, n == remaining);
+            i += n;
+            offset += n;
+            remaining -= n;
+            if (remaining == 0) fieldDone();
+            continue;
+        }
+
+        uint8_t b = data[i++];
+        offset++;
+        if (shift > 63) {
+            error = true; // varint longer than 10 bytes
+            break;
+        }
+        value |= (uint64_t)(b & 0x7F) << shift;
+        shift += 7;
+        if (b & 0x80) continue;
+
+        uint64_t v = value;
+        value = 0;
+        shift = 0;
+        switch (state) {
+            case TAG:
+                field = v >> 3;
+                if (field == 0 || (v >> 32) != 0) {
+                    error = true;
+                    break;
+                }
+                switch (v & 7) {
+                    case 0: state = VARINT; break;
+                    case 1: state = SKIP; remaining = 8; break;   // fixed64
+                    case 2: state = LENGTH; break;
+                    case 5: state = SKIP; remaining = 4; break;   // fixed32
+                    default: error = true; break;                 // groups are not used by GTFS-RT
+                }
+                break;
+
+            case VARINT:
+                listener.varint(depth, field, v);
+                fieldDone();
+                break;
+
+            case LENGTH:
+                if (v > UINT32_MAX - offset || (depth > 0 && offset + v > frames[depth - 1].end)) {
+                    error = true;
+                    break;
+                }
+                if (depth < PROTO_MAX_DEPTH && listener.message(depth, field)) {
+                    frames[depth].field = field;
+                    frames[depth].end = offset + (uint32_t)v;
+                    depth++;
+                    fieldDone(); // an empty message closes right away
+                } else if (v == 0) {
+                    listener.bytes(depth, field, data + i, 0, true);
+                    fieldDone();
+                } else {
+                    state = BYTES;
+                    remaining = v;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+    return !error;
+}
+
+bool ProtoDecoder::finish() {
+    return !error && state == TAG && shift == 0 && depth == 0;
+}
+
+// Appends a piece of a string field, cut to the buffer
+static void appendText(char* text, size_t size, const uint8_t* data, size_t len) {
+    size_t used = strlen(text);
+    size_t n = len < size - 1 - used ? len : size - 1 - used;
+    memcpy(text + used, data, n);
+    text[used + n] = '\0';
+}
+
+void GtfsBoard::begin(const char* stop, int64_t fromTime, size_t maxRows) {
+    stopId = stop;
+    stopLength = strlen(stop);
+    from = fromTime;
+    limit = maxRows < GTFS_MAX_ROWS ? maxRows : GTFS_MAX_ROWS;
+    rows = 0;
+    entityCount = 0;
+    matchCount = 0;
+    feedTimestamp = 0;
+    beginEntity();
+}
+
+void GtfsBoard::beginEntity() {
+    memset(&current, 0, sizeof(current));
+    matched = false;
+    skipEntity = false;
+    delayKnown = false;
+    headsignSet = false;
+    tripDelay = 0;
+    hasTripDelay = false;
+}
+
+bool GtfsBoard::message(uint8_t depth, uint32_t field) {
+    path[depth] = field;
+    switch (depth) {
+        case 0:
+            if (field == FEED_ENTITY) {
+                entityCount++;
+                beginEntity();
+            }
+            return field == FEED_HEADER || field == FEED_ENTITY;
+        case 1:
+            // Vehicle positions and alerts are skipped unread
+            return path[0] == FEED_ENTITY && field == ENTITY_TRIP_UPDATE && !skipEntity;
+        case 2:
+            if (field == TRIP_UPDATE_STOP_TIME) {
+                stopMatch = STOP_MATCHING;
+                stopPos = 0;
+                skippedStop = false;
+                memset(&arrival, 0, sizeof(arrival));
+                memset(&departure, 0, sizeof(departure));
+            }
+            return field == TRIP_UPDATE_TRIP || field == TRIP_UPDATE_STOP_TIME ||
+                   field == TRIP_UPDATE_VEHICLE || field == TRIP_UPDATE_PROPERTIES;
+        case 3:
+            return path[2] == TRIP_UPDATE_STOP_TIME && (field == STOP_TIME_ARRIVAL || field == STOP_TIME_DEPARTURE);
+        default:
+            return false;
+    }
+}
+
+void GtfsBoard::varint(uint8_t depth, uint32_t field, uint64_t value) {
+    if (depth == 1 && path[0] == FEED_HEADER && field == HEADER_TIMESTAMP) {
+        feedTimestamp = value;
+    } else if (depth == 1 && path[0] == FEED_ENTITY && field == ENTITY_IS_DELETED) {
+        if (value) skipEntity = true;
+    } else if (depth == 2 && field == TRIP_UPDATE_DELAY) {
+        tripDelay = (int32_t)value;
+        hasTripDelay = true;
+    } else if (depth == 3 && path[2] == TRIP_UPDATE_TRIP && field == TRIP_SCHEDULE) {
+        if (value == TRIP_CANCELED || value == TRIP_DELETED) skipEntity = true;
+    } else if (depth == 3 && path[2] == TRIP_UPDATE_STOP_TIME && field == STOP_TIME_SCHEDULE) {
+        if (value == STOP_SKIPPED || value == STOP_NO_DATA) skippedStop = true;
+    } else if (depth == 4) {
+        Event& event = path[3] == STOP_TIME_DEPARTURE ? departure : arrival;
+        if (field == EVENT_DELAY) {
+            event.delay = (int32_t)value;
+            event.hasDelay = true;
+        } else if (field == EVENT_TIME) {
+            event.time = (int64_t)value;
+            event.hasTime = true;
+        }
+    }
+}
+
+void GtfsBoard::bytes(uint8_t depth, uint32_t field, const uint8_t* data, size_t len, bool) {
+    if (depth != 3) return;
+    uint32_t parent = path[2];
+
+    if (parent == TRIP_UPDATE_STOP_TIME && field == STOP_TIME_STOP_ID) {
+        // Compared piece by piece against the wanted stop, nothing is copied
+        for (size_t i = 0; i < len && stopMatch == STOP_MATCHING; i++) {
+            if (stopPos < stopLength && data[i] == (uint8_t)stopId[stopPos]) {
+                stopPos++;
+            } else if (stopPos == stopLength && data[i] == ':') {
+                stopMatch = STOP_PLATFORM;
+            } else {
+                stopMatch = STOP_OTHER;
+            }
+        }
+    } else if (parent == TRIP_UPDATE_TRIP && field == TRIP_ID) {
+        appendText(current.tripId, sizeof(current.tripId), data, len);
+    } else if (parent == TRIP_UPDATE_TRIP && field == TRIP_ROUTE_ID) {
+        appendText(current.routeId, sizeof(current.routeId), data, len);
+    } else if (parent == TRIP_UPDATE_VEHICLE && field == VEHICLE_LABEL && !headsignSet) {
+        appendText(current.headsign, sizeof(current.headsign), data, len);
+    } else if (parent == TRIP_UPDATE_PROPERTIES && field == PROPERTIES_HEADSIGN) {
+        if (!headsignSet) current.headsign[0] = '\0';
+        headsignSet = true;
+        appendText(current.headsign, sizeof(current.headsign), data, len);
+    } else if (parent == TRIP_UPDATE_PROPERTIES && field == PROPERTIES_SHORT_NAME) {
+        appendText(current.shortName, sizeof(current.shortName), data, len);
+    }
+}
+
+void GtfsBoard::end(uint8_t depth, uint32_t field) {
+    if (depth == 2 && path[1] == ENTITY_TRIP_UPDATE && field == TRIP_UPDATE_STOP_TIME) {
+        endStopTimeUpdate();
+    } else if (depth == 0 && field == FEED_ENTITY) {
+        commit();
+    }
+}
+
+void GtfsBoard::endStopTimeUpdate() {
+    // A trip that passes the stop twice is shown at its first visit after from
+    if (matched || skippedStop || stopLength == 0) return;
+    bool isStop = (stopMatch == STOP_MATCHING && stopPos == stopLength) || stopMatch == STOP_PLATFORM;
+    if (!isStop) return;
+
+    // Delay-only updates need the static schedule, they are left out
+    const Event& event = departure.hasTime ? departure : arrival;
+    if (!event.hasTime || event.time < from) return;
+
+    current.time = event.time;
+    if (event.hasDelay) {
+        current.delay = event.delay;
+        delayKnown = true;
+    } else if (arrival.hasDelay) {
+        current.delay = arrival.delay;
+        delayKnown = true;
+    }
+    matched = true;
+}
+
+void GtfsBoard::commit() {
+    if (!matched || skipEntity) return;
+    matchCount++;
+    if (!delayKnown && hasTripDelay) current.delay = tripDelay;
+
+    // Earliest departures first, later ones fall off the end
+    size_t pos = rows;
+    while (pos > 0 && departures[pos - 1].time > current.time) pos--;
+    if (pos >= limit) return;
+    size_t last = rows < limit ? rows : limit - 1;
+    memmove(&departures[pos + 1], &departures[pos], (last - pos) * sizeof(GtfsDeparture));
+    departures[pos] = current;
+    if (rows < limit) rows++;
+}
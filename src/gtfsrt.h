@@ -0,0 +1,132 @@
+#ifndef GTFSRT_H
+#define GTFSRT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// GTFS-Realtime TripUpdates, decoded while the feed streams in. Shared with
+// tools/gtfsrt, no Arduino dependencies.
+//
+// ProtoDecoder walks the protobuf wire format with a fixed nesting stack and
+// hands string fields to the listener as slices of the fed buffer. GtfsBoard
+// keeps only the trip of the entity being read and the departures at one
+// stop, everything else in the feed is skipped without copying.
+#define PROTO_MAX_DEPTH 8
+#define GTFS_MAX_ROWS 16
+
+class ProtoListener {
+public:
+    virtual ~ProtoListener() {}
+    // Length-delimited field, true descends into it as a message
+    virtual bool message(uint8_t depth, uint32_t field) = 0;
+    virtual void varint(uint8_t depth, uint32_t field, uint64_t value) = 0;
+    // Length-delimited field that was not entered, in pieces as they arrive
+    virtual void bytes(uint8_t depth, uint32_t field, const uint8_t* data, size_t len, bool last) = 0;
+    virtual void end(uint8_t depth, uint32_t field) = 0;
+};
+
+class ProtoDecoder {
+public:
+    explicit ProtoDecoder(ProtoListener& listener);
+
+    void reset();
+    bool feed(const uint8_t* data, size_t len);
+    bool finish();   // the stream must end between top-level fields
+
+    bool failed() const { return error; }
+    uint32_t consumed() const { return offset; }
+
+private:
+    enum State : uint8_t { TAG, VARINT, LENGTH, BYTES, SKIP };
+
+    struct Frame {
+        uint32_t field;
+        uint32_t end;
+    };
+
+    void fieldDone();
+
+    ProtoListener& listener;
+    State state;
+    uint64_t value;
+    uint8_t shift;
+    uint32_t field;
+    uint32_t remaining;
+    uint32_t offset;
+    uint8_t depth;
+    bool error;
+    Frame frames[PROTO_MAX_DEPTH];
+};
+
+// One departure at the selected stop. time is the predicted departure (or
+// arrival at the last stop), delay in seconds.
+struct GtfsDeparture {
+    char tripId[24];
+    char routeId[24];
+    char shortName[8];   // trip_short_name from trip_properties
+    char headsign[32];   // trip_headsign, else the vehicle label
+    int64_t time;
+    int32_t delay;
+};
+
+class GtfsBoard : public ProtoListener {
+public:
+    // stopId matches itself and its platforms ("8503000" matches "8503000:0:7")
+    void begin(const char* stopId, int64_t from, size_t limit);
+
+    size_t count() const { return rows; }
+    const GtfsDeparture& row(size_t i) const { return departures[i]; }   // by time
+    uint32_t entities() const { return entityCount; }
+    uint32_t matches() const { return matchCount; }
+    uint64_t timestamp() const { return feedTimestamp; }
+
+    bool message(uint8_t depth, uint32_t field) override;
+    void varint(uint8_t depth, uint32_t field, uint64_t value) override;
+    void bytes(uint8_t depth, uint32_t field, const uint8_t* data, size_t len, bool last) override;
+    void end(uint8_t depth, uint32_t field) override;
+
+private:
+    struct Event {
+        int64_t time;
+        int32_t delay;
+        bool hasTime;
+        bool hasDelay;
+    };
+
+    enum StopMatch : uint8_t { STOP_MATCHING, STOP_PLATFORM, STOP_OTHER };
+
+    void beginEntity();
+    void endStopTimeUpdate();
+    void commit();
+
+    const char* stopId;
+    size_t stopLength;
+    int64_t from;
+    size_t limit;
+    GtfsDeparture departures[GTFS_MAX_ROWS];
+    size_t rows;
+    uint32_t entityCount;
+    uint32_t matchCount;
+    uint64_t feedTimestamp;
+
+    // Field numbers of the open messages, path[0] is the top-level field
+    uint32_t path[PROTO_MAX_DEPTH];
+
+    // Entity being read
+    GtfsDeparture current;
+    bool matched;
+    bool skipEntity;
+    bool delayKnown;
+    bool headsignSet;    // trip_headsign seen, the vehicle label no longer applies
+    int32_t tripDelay;
+    bool hasTripDelay;
+
+    // Stop time update being read
+    StopMatch stopMatch;
+    size_t stopPos;
+    bool skippedStop;
+    Event arrival;
+    Event departure;
+};
+
+#endif // GTFSRT_H
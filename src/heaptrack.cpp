@@ -0,0 +1,225 @@
+#include "heaptrack.h"
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifdef HEAP_TRACKER
+
+#define HEAP_TABLE_SIZE 512          // live tagged blocks, 4 KB
+#define HEAP_MAP_LOW 0x3FFAE000      // internal DRAM heap range
+#define HEAP_MAP_HIGH 0x40000000
+#define HEAP_MAP_CELL 1024
+#define HEAP_MAP_COLUMNS 64
+
+struct TagStats {
+    uint32_t liveBytes;
+    uint32_t liveBlocks;
+    uint32_t peakBytes;
+    uint32_t allocs;
+    uint32_t allocsAtReport;
+};
+
+// Open addressing, backward-shift deletion; size in the low 24 bits, tag above
+struct Block {
+    uintptr_t ptr;
+    uint32_t sizeTag;
+};
+
+static Block table[HEAP_TABLE_SIZE];
+static TagStats stats[HEAP_TAG_COUNT];
+static volatile uint32_t liveEntries = 0;
+static uint32_t overflows = 0;
+static volatile HeapTag currentTag = HEAP_TAG_NONE;
+static TaskHandle_t tagTask = nullptr;
+static portMUX_TYPE heapLock = portMUX_INITIALIZER_UNLOCKED;
+static unsigned long lastReport = 0;
+
+static const char tagLetters[HEAP_TAG_COUNT] = {'.', 'H', 'P', 'T', 'S', 'F'};
+static const char* tagNames[HEAP_TAG_COUNT] = {"none", "http", "parser", "transports", "sprite", "font"};
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+}
+
+static inline uint32_t slotOf(uintptr_t ptr) {
+    return (ptr >> 3) * 2654435761u % HEAP_TABLE_SIZE;
+}
+
+static void track(void* ptr, size_t size, HeapTag tag) {
+    if (!ptr) return;
+    portENTER_CRITICAL(&heapLock);
+    if (liveEntries >= HEAP_TABLE_SIZE - HEAP_TABLE_SIZE / 8) {
+        overflows++; // keep probes short, the block stays untracked
+    } else {
+        uint32_t slot = slotOf((uintptr_t)ptr);
+        while (table[slot].ptr) slot = (slot + 1) % HEAP_TABLE_SIZE;
+        table[slot].ptr = (uintptr_t)ptr;
+        table[slot].sizeTag = (size & 0xFFFFFF) | ((uint32_t)tag << 24);
+        liveEntries++;
+
+        TagStats& s = stats[tag];
+        s.liveBytes += size;
+        s.liveBlocks++;
+        s.allocs++;
+        if (s.liveBytes > s.peakBytes) s.peakBytes = s.liveBytes;
+    }
+    portEXIT_CRITICAL(&heapLock);
+}
+
+// Returns the tag of a tracked block, HEAP_TAG_NONE otherwise
+static HeapTag untrack(void* ptr) {
+    if (!ptr || liveEntries == 0) return HEAP_TAG_NONE;
+    HeapTag tag = HEAP_TAG_NONE;
+    portENTER_CRITICAL(&heapLock);
+    uint32_t slot = slotOf((uintptr_t)ptr);
+    while (table[slot].ptr && table[slot].ptr != (uintptr_t)ptr) slot = (slot + 1) % HEAP_TABLE_SIZE;
+    if (table[slot].ptr) {
+        tag = (HeapTag)(table[slot].sizeTag >> 24);
+        TagStats& s = stats[tag];
+        s.liveBytes -= table[slot].sizeTag & 0xFFFFFF;
+        s.liveBlocks--;
+        liveEntries--;
+
+        // Move following entries of the probe run back into the hole
+        uint32_t hole = slot;
+        uint32_t next = (hole + 1) % HEAP_TABLE_SIZE;
+        while (table[next].ptr) {
+            uint32_t home = slotOf(table[next].ptr);
+            bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+            if (movable) {
+                table[hole] = table[next];
+                hole = next;
+            }
+            next = (next + 1) % HEAP_TABLE_SIZE;
+        }
+        table[hole].ptr = 0;
+    }
+    portEXIT_CRITICAL(&heapLock);
+    return tag;
+}
+
+static inline HeapTag activeTag() {
+    HeapTag tag = currentTag;
+    if (tag == HEAP_TAG_NONE || xTaskGetCurrentTaskHandle() != tagTask) return HEAP_TAG_NONE;
+    return tag;
+}
+
+extern "C" {
+void* __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    HeapTag tag = activeTag();
+    if (tag != HEAP_TAG_NONE) track(ptr, size, tag);
+    return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    void* ptr = __real_calloc(count, size);
+    HeapTag tag = activeTag();
+    if (tag != HEAP_TAG_NONE) track(ptr, count * size, tag);
+    return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    HeapTag tag = untrack(ptr);
+    void* moved = __real_realloc(ptr, size);
+    if (!moved && size) return nullptr; // the old block stays live, untracked
+    // A grown block keeps its original owner
+    if (tag == HEAP_TAG_NONE) tag = activeTag();
+    if (tag != HEAP_TAG_NONE) track(moved, size, tag);
+    return moved;
+}
+
+void __wrap_free(void* ptr) {
+    untrack(ptr);
+    __real_free(ptr);
+}
+}
+
+void heapTag(HeapTag tag) {
+    if (!tagTask) tagTask = xTaskGetCurrentTaskHandle();
+    currentTag = tag;
+}
+
+#endif // HEAP_TRACKER
+
+static void heapSummary() {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    Serial.printf("Heap: %u free, %u largest block, %u free blocks, %u min free, %u allocated blocks\n",
+                  info.total_free_bytes, info.largest_free_block, info.free_blocks,
+                  info.minimum_free_bytes, info.allocated_blocks);
+}
+
+void heapReport() {
+    heapSummary();
+#ifdef HEAP_TRACKER
+    // Copy under the lock, printing allocates
+    TagStats copy[HEAP_TAG_COUNT];
+    portENTER_CRITICAL(&heapLock);
+    memcpy(copy, stats, sizeof(copy));
+    for (uint8_t i = 0; i < HEAP_TAG_COUNT; i++) stats[i].allocsAtReport = stats[i].allocs;
+    portEXIT_CRITICAL(&heapLock);
+
+    unsigned long elapsed = millis() - lastReport;
+    lastReport = millis();
+    for (uint8_t i = 1; i < HEAP_TAG_COUNT; i++) {
+        uint32_t recent = copy[i].allocs - copy[i].allocsAtReport;
+        Serial.printf("  %-10s live %6u B in %4u blocks, peak %6u B, %5lu allocs/min, %u total\n", tagNames[i],
+                      copy[i].liveBytes, copy[i].liveBlocks, copy[i].peakBytes,
+                      elapsed ? (unsigned long)((uint64_t)recent * 60000 / elapsed) : 0UL, copy[i].allocs);
+    }
+    if (overflows) Serial.printf("  %u allocations not tracked (table full)\n", overflows);
+#else
+    Serial.println("  Build with -DHEAP_TRACKER for per-subsystem tags");
+#endif
+}
+
+void heapMap() {
+    heapSummary();
+#ifdef HEAP_TRACKER
+    // One character per KB of DRAM: letter of the tag holding most bytes in it
+    static const uint32_t cells = (HEAP_MAP_HIGH - HEAP_MAP_LOW) / HEAP_MAP_CELL;
+    static uint16_t cellBytes[(HEAP_MAP_HIGH - HEAP_MAP_LOW) / HEAP_MAP_CELL];
+    static uint8_t cellTag[(HEAP_MAP_HIGH - HEAP_MAP_LOW) / HEAP_MAP_CELL];
+    memset(cellBytes, 0, sizeof(cellBytes));
+    memset(cellTag, 0, sizeof(cellTag));
+
+    portENTER_CRITICAL(&heapLock);
+    for (uint32_t i = 0; i < HEAP_TABLE_SIZE; i++) {
+        if (!table[i].ptr || table[i].ptr < HEAP_MAP_LOW || table[i].ptr >= HEAP_MAP_HIGH) continue;
+        uint32_t cell = (table[i].ptr - HEAP_MAP_LOW) / HEAP_MAP_CELL;
+        uint32_t size = table[i].sizeTag & 0xFFFFFF;
+        uint8_t tag = table[i].sizeTag >> 24;
+        // Large blocks cover several cells
+        for (uint32_t c = cell; c < cells && size > 0; c++) {
+            uint32_t part = std::min<uint32_t>(size, HEAP_MAP_CELL);
+            if (part >= cellBytes[c]) {
+                cellBytes[c] = part;
+                cellTag[c] = tag;
+            }
+            size -= part;
+        }
+    }
+    portEXIT_CRITICAL(&heapLock);
+
+    char row[HEAP_MAP_COLUMNS + 1];
+    for (uint32_t start = 0; start < cells; start += HEAP_MAP_COLUMNS) {
+        uint32_t n = std::min<uint32_t>(HEAP_MAP_COLUMNS, cells - start);
+        for (uint32_t c = 0; c < n; c++) row[c] = tagLetters[cellTag[start + c]];
+        row[n] = 0;
+        Serial.printf("%08x %s\n", HEAP_MAP_LOW + start * HEAP_MAP_CELL, row);
+    }
+    Serial.println("H http, P parser, T transports, S sprite, F font, . free or untagged");
+#endif
+}
+
+void heapResetPeaks() {
+#ifdef HEAP_TRACKER
+    portENTER_CRITICAL(&heapLock);
+    for (uint8_t i = 0; i < HEAP_TAG_COUNT; i++) stats[i].peakBytes = stats[i].liveBytes;
+    portEXIT_CRITICAL(&heapLock);
+#endif
+}
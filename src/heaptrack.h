@@ -0,0 +1,30 @@
+#ifndef HEAPTRACK_H
+#define HEAPTRACK_H
+
+#include <Arduino.h>
+
+// Heap allocations tagged by subsystem. Code marks what it is about to
+// allocate with heapTag(), like governorPhase(); allocations of the loop task
+// are attributed to the current tag. Only built with -DHEAP_TRACKER (see the
+// ESP32-2432S028R-heap environment), otherwise heapTag() compiles to nothing.
+enum HeapTag : uint8_t {
+    HEAP_TAG_NONE,
+    HEAP_TAG_HTTP,        // HTTPClient buffers and response strings
+    HEAP_TAG_PARSER,      // response parsers of the providers
+    HEAP_TAG_TRANSPORTS,  // std::vector<Transport> and its rows
+    HEAP_TAG_SPRITE,      // TFT_eSprite::callocSprite
+    HEAP_TAG_FONT,        // smooth font metrics (loadMetrics)
+    HEAP_TAG_COUNT
+};
+
+#ifdef HEAP_TRACKER
+void heapTag(HeapTag tag);
+#else
+inline void heapTag(HeapTag) {}
+#endif
+
+void heapReport();          // per-tag live bytes, peak and allocation rate
+void heapMap();             // address map of tagged blocks plus heap summary
+void heapResetPeaks();
+
+#endif // HEAPTRACK_H
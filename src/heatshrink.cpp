@@ -0,0 +1,101 @@
+#include "heatshrink.h"
+#include <string.h>
+
+static const uint16_t WINDOW_MASK = (1 << HEATSHRINK_WINDOW_BITS) - 1;
+
+HeatshrinkDecoder::HeatshrinkDecoder(ByteSink& sink) : sink(sink) {
+    reset();
+}
+
+void HeatshrinkDecoder::reset() {
+    memset(window, 0, sizeof(window));
+    state = TAG;
+    bitBuffer = 0;
+    bitCount = 0;
+    index = 0;
+    head = 0;
+    outTotal = 0;
+    outFill = 0;
+    error = false;
+}
+
+bool HeatshrinkDecoder::flush() {
+    if (outFill && !sink.write(out, outFill)) error = true;
+    outFill = 0;
+    return !error;
+}
+
+bool HeatshrinkDecoder::put(uint8_t value) {
+    window[head++ & WINDOW_MASK] = value;
+    out[outFill++] = value;
+    outTotal++;
+    return outFill < sizeof(out) || flush();
+}
+
+bool HeatshrinkDecoder::feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len && !error; i++) {
+        bitBuffer = (bitBuffer << 8) | data[i];
+        bitCount += 8;
+
+        // Decode every token that is complete in the bit buffer
+        bool progress = true;
+        while (progress && !error) {
+            progress = false;
+            switch (state) {
+                case TAG:
+                    if (bitCount >= 1) {
+                        bitCount--;
+                        state = ((bitBuffer >> bitCount) & 1) ? LITERAL : INDEX;
+                        progress = true;
+                    }
+                    break;
+
+                case LITERAL:
+                    if (bitCount >= 8) {
+                        bitCount -= 8;
+                        put((bitBuffer >> bitCount) & 0xFF);
+                        state = TAG;
+                        progress = true;
+                    }
+                    break;
+
+                case INDEX:
+                    if (bitCount >= HEATSHRINK_WINDOW_BITS) {
+                        bitCount -= HEATSHRINK_WINDOW_BITS;
+                        index = ((bitBuffer >> bitCount) & WINDOW_MASK) + 1;
+                        state = COUNT;
+                        progress = true;
+                    }
+                    break;
+
+                case COUNT:
+                    if (bitCount >= HEATSHRINK_LOOKAHEAD_BITS) {
+                        bitCount -= HEATSHRINK_LOOKAHEAD_BITS;
+                        uint16_t count = ((bitBuffer >> bitCount) & ((1 << HEATSHRINK_LOOKAHEAD_BITS) - 1)) + 1;
+                        if (index > outTotal) {
+                            error = true; // reference before the start of the stream
+                            break;
+                        }
+                        for (uint16_t n = 0; n < count && !error; n++) {
+                            put(window[(head - index) & WINDOW_MASK]);
+                        }
+                        state = TAG;
+                        progress = true;
+                    }
+                    break;
+            }
+        }
+        bitBuffer &= (1u << bitCount) - 1;
+    }
+    return !error;
+}
+
+bool HeatshrinkDecoder::finish() {
+    if (error) return false;
+    // The encoder pads the last byte with zero bits
+    if (state == LITERAL || state == COUNT || bitCount >= 8 || bitBuffer != 0) {
+        error = true;
+        return false;
+    }
+    return flush();
+}
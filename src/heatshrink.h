@@ -0,0 +1,50 @@
+#ifndef HEATSHRINK_H
+#define HEATSHRINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming decoder for heatshrink (LZSS) compressed OTA images, shared with
+// tools/otapack. Compatible with `heatshrink -e -w 11 -l 4`.
+//   literal  1 + 8 bits
+//   backref  0 + window bits (distance - 1) + lookahead bits (length - 1)
+#define HEATSHRINK_WINDOW_BITS 11     // 2 KB window, the only history kept in RAM
+#define HEATSHRINK_LOOKAHEAD_BITS 4   // backrefs up to 16 bytes
+
+class ByteSink {
+public:
+    virtual ~ByteSink() {}
+    virtual bool write(const uint8_t* buf, size_t len) = 0;
+};
+
+class HeatshrinkDecoder {
+public:
+    explicit HeatshrinkDecoder(ByteSink& sink);
+
+    void reset();
+    bool feed(const uint8_t* data, size_t len);
+    bool finish();   // flushes the output, trailing bits must be padding
+
+    bool failed() const { return error; }
+    uint32_t written() const { return outTotal; }
+
+private:
+    enum State : uint8_t { TAG, LITERAL, INDEX, COUNT };
+
+    bool put(uint8_t value);
+    bool flush();
+
+    ByteSink& sink;
+    State state;
+    uint32_t bitBuffer;
+    uint8_t bitCount;
+    uint16_t index;
+    uint16_t head;
+    uint32_t outTotal;
+    uint16_t outFill;
+    bool error;
+    uint8_t window[1 << HEATSHRINK_WINDOW_BITS];
+    uint8_t out[256];
+};
+
+#endif // HEATSHRINK_H
@@ -0,0 +1,254 @@
+#include "jsonsax.h"
+
+static bool isSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+JsonTokenizer::JsonTokenizer(JsonHandler& handler) : handler(handler) {
+    reset();
+}
+
+void JsonTokenizer::reset() {
+    state = VALUE;
+    isKey = false;
+    error = false;
+    depth = 0;
+    objects = 0;
+    hexCount = 0;
+    hexValue = 0;
+    highSurrogate = 0;
+    length = 0;
+}
+
+void JsonTokenizer::append(uint8_t c) {
+    if (length < JSON_TOKEN_SIZE - 1) buffer[length++] = c;
+}
+
+void JsonTokenizer::appendCodePoint(uint32_t code) {
+    if (code < 0x80) {
+        append(code);
+    } else if (code < 0x800) {
+        append(0xC0 | (code >> 6));
+        append(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        append(0xE0 | (code >> 12));
+        append(0x80 | ((code >> 6) & 0x3F));
+        append(0x80 | (code & 0x3F));
+    } else {
+        append(0xF0 | (code >> 18));
+        append(0x80 | ((code >> 12) & 0x3F));
+        append(0x80 | ((code >> 6) & 0x3F));
+        append(0x80 | (code & 0x3F));
+    }
+}
+
+// Terminated token, a UTF-8 sequence cut at the buffer end is dropped
+const char* JsonTokenizer::token() {
+    if (length == JSON_TOKEN_SIZE - 1) {
+        uint16_t start = length;
+        while (start > 0 && (buffer[start - 1] & 0xC0) == 0x80) start--;
+        if (start > 0 && (uint8_t)buffer[start - 1] >= 0xC0) {
+            uint8_t lead = buffer[start - 1];
+            uint16_t needed = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+            if (length - (start - 1) < needed) length = start - 1;
+        }
+    }
+    buffer[length] = '\0';
+    length = 0;
+    return buffer;
+}
+
+void JsonTokenizer::push(bool object) {
+    if (depth >= JSON_MAX_DEPTH) {
+        error = true;
+        return;
+    }
+    if (object) {
+        objects |= 1UL << depth;
+    } else {
+        objects &= ~(1UL << depth);
+    }
+    depth++;
+    if (object) {
+        handler.startObject();
+        state = KEY_OR_END;
+    } else {
+        handler.startArray();
+        state = VALUE_OR_END;
+    }
+}
+
+void JsonTokenizer::pop(bool object) {
+    if (depth == 0 || ((objects >> (depth - 1)) & 1) != object) {
+        error = true;
+        return;
+    }
+    depth--;
+    if (object) {
+        handler.endObject();
+    } else {
+        handler.endArray();
+    }
+    endValue();
+}
+
+void JsonTokenizer::endValue() {
+    state = depth == 0 ? DONE : AFTER_VALUE;
+}
+
+void JsonTokenizer::startValue(uint8_t c) {
+    if (c == '{') {
+        push(true);
+    } else if (c == '[') {
+        push(false);
+    } else if (c == '"') {
+        isKey = false;
+        state = STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+        append(c);
+        state = LITERAL;
+    } else {
+        error = true;
+    }
+}
+
+// One byte, returns false when it has to be looked at again in the new state
+bool JsonTokenizer::put(uint8_t c) {
+    switch (state) {
+        case VALUE:
+            if (!isSpace(c)) startValue(c);
+            break;
+
+        case VALUE_OR_END:
+            if (c == ']') {
+                pop(false);
+            } else if (!isSpace(c)) {
+                startValue(c);
+            }
+            break;
+
+        case KEY_OR_END:
+        case KEY:
+            if (c == '}' && state == KEY_OR_END) {
+                pop(true);
+            } else if (c == '"') {
+                isKey = true;
+                state = STRING;
+            } else if (!isSpace(c)) {
+                error = true;
+            }
+            break;
+
+        case COLON:
+            if (c == ':') {
+                state = VALUE;
+            } else if (!isSpace(c)) {
+                error = true;
+            }
+            break;
+
+        case AFTER_VALUE: {
+            bool inObject = (objects >> (depth - 1)) & 1;
+            if (c == ',') {
+                state = inObject ? KEY : VALUE;
+            } else if (c == '}' || c == ']') {
+                pop(c == '}');
+            } else if (!isSpace(c)) {
+                error = true;
+            }
+            break;
+        }
+
+        case STRING:
+            if (c == '"') {
+                if (isKey) {
+                    handler.key(token());
+                    state = COLON;
+                } else {
+                    handler.value(token());
+                    endValue();
+                }
+            } else if (c == '\\') {
+                state = ESCAPE;
+            } else if (c < 0x20) {
+                error = true;
+            } else {
+                append(c);
+            }
+            break;
+
+        case ESCAPE:
+            state = STRING;
+            switch (c) {
+                case '"': append('"'); break;
+                case '\\': append('\\'); break;
+                case '/': append('/'); break;
+                case 'b': append('\b'); break;
+                case 'f': append('\f'); break;
+                case 'n': append('\n'); break;
+                case 'r': append('\r'); break;
+                case 't': append('\t'); break;
+                case 'u':
+                    state = UNICODE;
+                    hexCount = 0;
+                    hexValue = 0;
+                    break;
+                default: error = true; break;
+            }
+            break;
+
+        case UNICODE: {
+            uint8_t digit;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else {
+                error = true;
+                break;
+            }
+            hexValue = hexValue << 4 | digit;
+            if (++hexCount < 4) break;
+            state = STRING;
+            if (hexValue >= 0xD800 && hexValue < 0xDC00) {
+                highSurrogate = hexValue; // completed by the next escape
+            } else if (hexValue >= 0xDC00 && hexValue < 0xE000 && highSurrogate) {
+                appendCodePoint(0x10000 + ((highSurrogate - 0xD800) << 10) + (hexValue - 0xDC00));
+                highSurrogate = 0;
+            } else {
+                appendCodePoint(hexValue);
+                highSurrogate = 0;
+            }
+            break;
+        }
+
+        case LITERAL:
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                c == '.' || c == '+' || c == '-') {
+                append(c);
+                break;
+            }
+            handler.value(token());
+            endValue();
+            return false;
+
+        case DONE:
+            if (!isSpace(c)) error = true;
+            break;
+    }
+    return true;
+}
+
+bool JsonTokenizer::feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len && !error; i++) {
+        if (!put(data[i]) && !error) put(data[i]);
+    }
+    return !error;
+}
+
+bool JsonTokenizer::finish() {
+    if (!error && state == LITERAL && depth == 0) {
+        handler.value(token());
+        state = DONE;
+    }
+    return !error && state == DONE;
+}
@@ -0,0 +1,72 @@
+#ifndef JSONSAX_H
+#define JSONSAX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming JSON tokenizer with fixed buffers, no Arduino dependencies.
+// Keys and scalar values are handed over as C strings, escapes (including
+// \uXXXX) are decoded to UTF-8; numbers, true, false and null come as their
+// text. Strings longer than JSON_TOKEN_SIZE - 1 bytes are cut.
+#define JSON_TOKEN_SIZE 128
+#define JSON_MAX_DEPTH 32
+
+class JsonHandler {
+public:
+    virtual ~JsonHandler() {}
+    virtual void startObject() {}
+    virtual void endObject() {}
+    virtual void startArray() {}
+    virtual void endArray() {}
+    virtual void key(const char* /*key*/) {}
+    virtual void value(const char* /*value*/) {}
+};
+
+class JsonTokenizer {
+public:
+    explicit JsonTokenizer(JsonHandler& handler);
+
+    void reset();
+    bool feed(const uint8_t* data, size_t len);
+    bool finish();   // one complete top-level value
+
+    bool failed() const { return error; }
+
+private:
+    enum State : uint8_t {
+        VALUE,          // a value must follow
+        VALUE_OR_END,   // after '['
+        KEY_OR_END,     // after '{'
+        KEY,            // after ',' in an object
+        COLON,
+        AFTER_VALUE,
+        STRING,
+        ESCAPE,
+        UNICODE,
+        LITERAL,
+        DONE
+    };
+
+    bool put(uint8_t c);
+    void startValue(uint8_t c);
+    void endValue();
+    void push(bool object);
+    void pop(bool object);
+    void append(uint8_t c);
+    void appendCodePoint(uint32_t code);
+    const char* token();
+
+    JsonHandler& handler;
+    State state;
+    bool isKey;
+    bool error;
+    uint8_t depth;
+    uint32_t objects;      // bit per level, set for objects
+    uint8_t hexCount;
+    uint32_t hexValue;
+    uint32_t highSurrogate;
+    uint16_t length;
+    char buffer[JSON_TOKEN_SIZE];
+};
+
+#endif // JSONSAX_H
@@ -0,0 +1,101 @@
+#include "latency.h"
+#include "globals.h"
+#include <esp_timer.h>
+
+static const uint32_t LOOP_GAP_SLO_MS = 100;   // button.tick() at least every 100 ms
+static const uint32_t INPUT_SLO_MS = 150;      // on top of the gesture's own click timeout
+static const uint32_t GESTURE_DELAY_MS = 500;  // button.setClickMs(), multi-click is attached
+
+static LatencyHistogram loopGaps = {{0}, 0, 0, 0, LOOP_GAP_SLO_MS, 0};
+static LatencyHistogram inputs[INPUT_COUNT] = {
+    {{0}, 0, 0, 0, INPUT_SLO_MS, 0},
+    {{0}, 0, 0, 0, INPUT_SLO_MS, 0},
+    {{0}, 0, 0, 0, INPUT_SLO_MS, 0},
+};
+static const char* inputNames[INPUT_COUNT] = {"click", "double_click", "multi_click"};
+
+static int64_t lastLoopUs = 0;
+static volatile int64_t lastEdgeUs = 0;
+static volatile uint32_t buttonEdges = 0;
+
+static void IRAM_ATTR onButtonEdge() {
+    lastEdgeUs = esp_timer_get_time();
+    buttonEdges++;
+}
+
+static void record(LatencyHistogram& histogram, uint32_t ms) {
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && ms >= (1u << bucket)) bucket++;
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.sumMs += ms;
+    if (ms > histogram.maxMs) histogram.maxMs = ms;
+    if (ms > histogram.sloMs) histogram.overSlo++;
+}
+
+void latencyBegin() {
+    // Edges are timestamped in the ISR, OneButton still polls the level
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonEdge, CHANGE);
+    lastLoopUs = esp_timer_get_time();
+}
+
+void latencyLoop() {
+    int64_t now = esp_timer_get_time();
+    if (lastLoopUs) record(loopGaps, (now - lastLoopUs) / 1000);
+    lastLoopUs = now;
+}
+
+// Light sleep is idle time, not a gap in servicing the button
+void latencySleepEnd() {
+    lastLoopUs = esp_timer_get_time();
+}
+
+void latencyInput(InputHandler handler) {
+    if (handler >= INPUT_COUNT || lastEdgeUs == 0) return;
+    int64_t sinceEdge = (esp_timer_get_time() - lastEdgeUs) / 1000;
+    int64_t excess = sinceEdge - GESTURE_DELAY_MS;
+    record(inputs[handler], excess > 0 ? excess : 0);
+    if (excess > INPUT_SLO_MS) {
+        Serial.printf("Input latency: %s handled %lld ms late\n", inputNames[handler], excess);
+    }
+}
+
+const LatencyHistogram& latencyLoopGaps() {
+    return loopGaps;
+}
+
+const LatencyHistogram& latencyInputs(InputHandler handler) {
+    return inputs[handler < INPUT_COUNT ? handler : 0];
+}
+
+const char* latencyInputName(InputHandler handler) {
+    return inputNames[handler < INPUT_COUNT ? handler : 0];
+}
+
+// Upper bound of the bucket holding the percentile
+uint32_t latencyPercentile(const LatencyHistogram& histogram, uint8_t percent) {
+    if (histogram.count == 0) return 0;
+    uint32_t target = ((uint64_t)histogram.count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= target) return 1u << i;
+    }
+    return histogram.maxMs;
+}
+
+static void printHistogram(const char* name, const LatencyHistogram& h) {
+    Serial.printf("  %-13s n=%lu p50<=%lu p95<=%lu p99<=%lu max=%lu ms, %lu over %lu ms SLO\n", name,
+                  (unsigned long)h.count, (unsigned long)latencyPercentile(h, 50),
+                  (unsigned long)latencyPercentile(h, 95), (unsigned long)latencyPercentile(h, 99),
+                  (unsigned long)h.maxMs, (unsigned long)h.overSlo, (unsigned long)h.sloMs);
+    Serial.print("   ");
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) Serial.printf(" %lu", (unsigned long)h.buckets[i]);
+    Serial.println();
+}
+
+void latencyReport() {
+    Serial.printf("Latency (buckets <1, <2, <4 ... ms), %lu button edges\n", (unsigned long)buttonEdges);
+    printHistogram("loop_gap", loopGaps);
+    for (uint8_t i = 0; i < INPUT_COUNT; i++) printHistogram(inputNames[i], inputs[i]);
+}
@@ -0,0 +1,37 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <Arduino.h>
+
+// Responsiveness instrumentation: gaps between loop iterations (intentional
+// sleep excluded) and the delay from the last button edge to the handler,
+// in log2 histograms with a budget (SLO) per histogram
+#define LATENCY_BUCKETS 16   // <1 ms, then [2^(i-1), 2^i) ms, the last one open
+
+enum InputHandler {
+    INPUT_CLICK,          // cycleBrightness
+    INPUT_DOUBLE_CLICK,   // switchStation
+    INPUT_MULTI_CLICK,    // startConfigPortal
+    INPUT_COUNT
+};
+
+struct LatencyHistogram {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint64_t sumMs;
+    uint32_t maxMs;
+    uint32_t sloMs;
+    uint32_t overSlo;
+};
+
+void latencyBegin();
+void latencyLoop();
+void latencySleepEnd();
+void latencyInput(InputHandler handler);
+const LatencyHistogram& latencyLoopGaps();
+const LatencyHistogram& latencyInputs(InputHandler handler);
+const char* latencyInputName(InputHandler handler);
+uint32_t latencyPercentile(const LatencyHistogram& histogram, uint8_t percent);
+void latencyReport();
+
+#endif // LATENCY_H
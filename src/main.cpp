@@ -7,16 +7,27 @@
 #include "stationboard.h"
 #include "ota.h"
 #include "nightmode.h"
+#include "snapshot.h"
+#include "timetable.h"
+#include "timesync.h"
+#include "scheduler.h"
+#include "deepsleep.h"
+#include "wificache.h"
+#include "radiopower.h"
+#include "energy.h"
+#include "polling.h"
+#include "governor.h"
+#include "bootprofile.h"
+#include "metrics.h"
+#include "ticker.h"
+#include "latency.h"
 
 #define BUTTON_SLEEP GPIO_NUM_0  // Boot Button
 
-void lightSleep() {
-    Serial.println("Preparing for sleep...");
-    
-    // Determine sleep duration based on night mode
-    unsigned long sleepDuration = inNightMode ? NIGHT_CHECK_INTERVAL * 1000ULL : SLEEP_DURATION;
-    
+void lightSleep(uint64_t sleepDuration) {
     if (currentBrightnessIndex > 3 || inNightMode) {
+        Serial.printf("Preparing for sleep (%llu ms)...\n", sleepDuration / 1000);
+
         // Configure wake-up sources
         esp_sleep_enable_timer_wakeup(sleepDuration);
         esp_sleep_enable_ext0_wakeup(BUTTON_SLEEP, 0);
@@ -25,14 +36,17 @@ void lightSleep() {
         Serial.println("Entering light sleep");
         Serial.flush();
         
+        energySleep(true);
         esp_light_sleep_start();
+        energySleep(false);
+        latencySleepEnd();
         
         // After waking up
         esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
         
         if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 && inNightMode) {
             temporaryNightWake = true;
-            nightWakeStartTime = millis();
+            schedulerSetIn(TASK_NIGHT_WAKE_END, NIGHT_WAKE_DURATION);
         }
 
         // Restore PWM configuration
@@ -42,19 +56,20 @@ void lightSleep() {
             updateBrightness();
         } else {
             Serial.printf("Wake keep dark: night=%d tempWake=%d\n", inNightMode, temporaryNightWake);
-            ledcWrite(PWM_CHANNEL, 0);
+            setBacklight(0);
         }
         
         if(wakeup_reason == ESP_SLEEP_WAKEUP_EXT0) {
             Serial.println("Woken up by button");
+            // Stay awake until the click sequence is complete
+            schedulerSetIn(TASK_STAY_AWAKE, UPDATE_DURATION);
             button.tick();
         } else {
             Serial.println("Woken up by timer");
         }
     } else {
-        Serial.println("No light sleep, reduce CPU frequency");
-        setCpuFrequencyMhz(80);
-        Serial.println("CPU:" + String(getCpuFrequencyMhz()) + "MHz");
+        // No light sleep, the governor keeps the CPU at its lowest clock
+        governorPhase(GOV_IDLE);
     }
 
 }
@@ -62,86 +77,241 @@ void lightSleep() {
 void reconnectWiFi() {
     if (WiFi.status() != WL_CONNECTED) {
         Serial.println("WiFi not connected, reconnecting...");
-        WiFi.disconnect();
-        delay(100);
-        WiFi.reconnect();
-        int attempts = 0;
-        while (WiFi.status() != WL_CONNECTED && attempts < 10) {
-            delay(500);
-            attempts++;
-        }
+        wifiConnect();
+    }
+}
+
+void nightPrefetch() {
+    static unsigned long lastAttempt = 0;
+    static bool attempted = false;
+    if (attempted && millis() - lastAttempt < UPDATE_INTERVAL) return;
+    attempted = true;
+    lastAttempt = millis();
+
+    Serial.println("Prefetching board before night mode ends");
+    radioSetProfile(RADIO_ACTIVE);
+    energyPhase(ENERGY_CONNECT);
+    governorPhase(GOV_NETWORK);
+    reconnectWiFi();
+    if (WiFi.status() != WL_CONNECTED) {
+        energyPhase(ENERGY_IDLE);
+        return;
     }
+    energyPhase(ENERGY_REFRESH);
+
+    // Backlight stays off, the board is ready when night mode ends
+    tft.fillScreen(TFT_BLUE);
+    tft.fillRect(0, tft.height() - 25 , tft.width(), 25, TFT_WHITE);
+    drawCurrentTime();
+    displayStatus(drawStationboard());
+    tickerService(true);
+    prerenderInactiveStation();
+    nightPrefetched = true;
+    energyPhase(ENERGY_IDLE);
+    energyRefreshDone();
+    Serial.println("============ End of night prefetch ==================");
+}
+
+// Next pages of a running timetable download, in between refresh cycles
+void timetableSlice() {
+    radioSetProfile(RADIO_ACTIVE);
+    energyPhase(ENERGY_CONNECT);
+    governorPhase(GOV_NETWORK);
+    reconnectWiFi();
+    energyPhase(ENERGY_REFRESH);
+    timetableService(); // a failed page ends the download, it is retried later
+    energyPhase(ENERGY_IDLE);
 }
 
 void setup() {
     Serial.begin(115200);
+    bootMark("serial");
+
+    // Night wake from deep sleep: state comes from RTC memory, the panel stays dark
+    bool resumed = deepSleepResume();
 
     if (SPIFFS.begin(true)) {
         Serial.println("SPIFFS Mounted");
     }
+    energyBegin();
+    bootMark("spiffs");
 
     // Initialize display
     tft.init();
     tft.setRotation(1);
-    tft.fillScreen(TFT_BLACK);
+    bootMark("tft");
+
+    // Show the last board before anything else, marked as stale
+    bool restored = !resumed && snapshotRestore();
+    if (!restored) {
+        tft.fillScreen(TFT_BLACK);
+    }
     tft.setTextColor(TFT_WHITE);
 
     // Initialize PWM for backlight
     ledcSetup(PWM_CHANNEL, PWM_FREQ, PWM_RESOLUTION);
     ledcAttachPin(BACKLIGHT_PIN, PWM_CHANNEL);
-    updateBrightness(); //initial value
+    if (resumed) {
+        setBacklight(0);
+    } else {
+        updateBrightness(); //initial value
+    }
+    if (restored) bootFirstFrame("snapshot");
+    bootMark("snapshot");
 
     // Button Setup
     pinMode(BUTTON_PIN, INPUT_PULLUP);
 
     // Set up button callbacks
     button.setClickMs(500); // 500ms for single click
-    button.attachClick(cycleBrightness);
-    button.attachDoubleClick(switchStation);
-    button.attachMultiClick(startConfigPortal);
+    button.attachClick([]() { latencyInput(INPUT_CLICK); cycleBrightness(); });
+    button.attachDoubleClick([]() { latencyInput(INPUT_DOUBLE_CLICK); switchStation(); });
+    button.attachMultiClick([]() { latencyInput(INPUT_MULTI_CLICK); startConfigPortal(); });
     button.setPressMs(10000); // 10 seconds for long press
     button.attachLongPressStart(handleLongPress);
+    latencyBegin();
 
-    // Call WiFiManager setup
-    setupWiFiManager();
-    esp_wifi_set_ps(WIFI_PS_NONE); // Disable WiFi power save mode
-    
-    // Set custom brightness
-    currentBrightnessIndex = config.defaultBrightness; //setting initial brightness from setup
-    updateBrightness();
+    if (resumed) {
+        // Brightness and night state were restored, WiFi connects on the first refresh
+        setupWiFiResume();
+    } else {
+        // Reset gesture is watched in the background while WiFi comes up
+        beginConfigResetWatch();
+
+        // Known network: connect directly, otherwise the WiFiManager portal
+        if (!setupWiFiFast()) {
+            checkForConfigReset();
+            setupWiFiManager();
+        }
+        bootMark("wifi");
+        checkForConfigReset();
+        
+        // Set custom brightness
+        currentBrightnessIndex = config.defaultBrightness; //setting initial brightness from setup
+        updateBrightness();
+    }
+    radioPowerBegin(); // full power for the boot fetch, modem sleep from the first loop on
          
-    // Initialize time client (UTC - DST conversion handled by Timezone library)
-    timeClient.begin();
-    timeClient.setUpdateInterval(3600000); // Update every 60 minutes (3600000)
+    // Start background SNTP (UTC - DST conversion handled by Timezone library)
+    timeSyncBegin();
+
+    // Only a departure offset needs the local date before the first request,
+    // otherwise the fetch runs while SNTP syncs in the background
+    unsigned long syncStart = millis();
+    while (config.offset != 0 && WiFi.status() == WL_CONNECTED && !timeIsSynced() && millis() - syncStart < 5000) {
+        delay(50);
+    }
 
-    // Initial Screen Setup
-    tft.fillScreen(TFT_BLUE);
-    tft.fillRect(0, tft.height() - 25 , tft.width(), 25, TFT_WHITE); //footer
     tft.loadFont(AA_FONT_SMALL);
     tft.setTextColor(TFT_WHITE, TFT_BLUE);
 
+    if (resumed) {
+        // Deadlines were restored, a button wake lights the board temporarily
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0) {
+            handleNightModeButton();
+        }
+        Serial.println("============ End of resume ==================");
+        return;
+    }
+
+    // Initial Screen Setup (keep the restored snapshot until fresh data arrives)
+    if (snapshotStale) {
+        drawStaleMarker();
+    } else {
+        tft.fillScreen(TFT_BLUE);
+        tft.fillRect(0, tft.height() - 25 , tft.width(), 25, TFT_WHITE); //footer
+    }
+
     // Initial data fetch
     if (WiFi.status() == WL_CONNECTED) {
-        drawCurrentTime();
-        drawStationboard();
-        drawBTC();
+        if (timeIsSynced()) drawCurrentTime();
+        bool fetched = drawStationboard();
+        displayStatus(fetched);
+        if (fetched) bootFirstFrame("fetch"); // an empty board with the error dot is not useful
+        bootMark("board");
+        checkForConfigReset();
+        tickerService();
     }
+    bootMark("setup done");
 
     debugInfo();
-    // lightSleep();
+    bootReport();
+
+    // First deadlines, the refresh cycle above counts as the first fetch
+    schedulerSetIn(TASK_FETCH, UPDATE_INTERVAL);
+    schedulerSetIn(TASK_STAY_AWAKE, UPDATE_DURATION);
+    scheduleMinuteTick();
     Serial.println("============ End of setup ==================");
 }
 
-// Global variables for timing
-unsigned long lastUpdate = 0;
+void refreshCycle() {
+    unsigned long cycleStart = millis();
+    radioSetProfile(RADIO_ACTIVE);
 
+    energyPhase(ENERGY_CONNECT);
+    governorPhase(GOV_NETWORK);
+    reconnectWiFi();
+    energyPhase(ENERGY_REFRESH);
+
+    if (WiFi.status() == WL_CONNECTED) {
+        // Update time only when display is allowed to render
+        if (!inNightMode || temporaryNightWake || forceRefresh) {
+            drawCurrentTime();
+        }
+
+        // Only update stationboard and ticker if not in night mode or during temporary wake
+        // AND if config portal is not running
+        if ((!inNightMode || temporaryNightWake || forceRefresh) && !portalRunning) {
+            displayStatus(drawStationboard());
+            tickerService(forceRefresh); // the screen was cleared when forced
+            prerenderInactiveStation();
+            governorPhase(GOV_IDLE);
+            debugInfo();
+            Serial.println("============ End of refresh cycle ==================");
+        }
+
+        // Nightly download of the planned timetable (also runs while the display is dark),
+        // continued in slices from loop()
+        if (!portalRunning) {
+            timetableService();
+        }
+    } else {
+        displayStatus(false);
+    }
+    forceRefresh = false;
+    energyPhase(ENERGY_IDLE);
+    energyRefreshDone();
+    metricsRecordCycle(millis() - cycleStart);
+}
 
 void loop() {
-    button.tick();
-    unsigned long currentMillis = millis();
-    static unsigned long updateStartTime = 0;
-    static bool isUpdating = false;
+    latencyLoop();
+    // GPIO0 is the reset trigger while the boot window is open, not a click
+    if (configResetWatchActive()) {
+        button.reset();
+    } else {
+        button.tick();
+    }
+
+    // A button press is someone looking at the board
+    static bool buttonWasIdle = true;
+    bool buttonIdle = button.isIdle();
+    if (buttonWasIdle && !buttonIdle) pollingViewed();
+    buttonWasIdle = buttonIdle;
     
+    // Reset gesture from the boot window
+    checkForConfigReset();
+
+    // Drift compensation of the local clock, no network access
+    timeSyncService();
+
+    // Clock became valid or was adjusted, redraw it right away
+    static unsigned long seenSyncs = 0;
+    if (timeSyncCount != seenSyncs) {
+        seenSyncs = timeSyncCount;
+        schedulerSet(TASK_MINUTE_TICK, schedulerNow());
+    }
+
     // Check night mode state (handles entering/exiting night mode based on time)
     checkNightMode();
     
@@ -152,51 +322,60 @@ void loop() {
         wm.process();
     }
 
+    // Scrape endpoint, always available while connected
+    metricsService();
+
+    // Heap and latency reports on request
+    consoleService();
+
     // OTA is disabled during night mode
     if (!inNightMode) {
         handleOTA();
     }
 
-    if (!otaMode) {
-        // Determine update interval based on night mode
-        unsigned long currentInterval = inNightMode ? NIGHT_CHECK_INTERVAL : UPDATE_INTERVAL;
-        
-        if (forceRefresh || (!isUpdating && currentMillis - lastUpdate >= currentInterval)) {
-            if (getCpuFrequencyMhz() != 240) setCpuFrequencyMhz(240); // Set CPU frequency to 240MHz
-
-            reconnectWiFi();
-
-            if (WiFi.status() == WL_CONNECTED) {
-                // Update time only when display is allowed to render
-                if (!inNightMode || temporaryNightWake || forceRefresh) {
-                    drawCurrentTime();
-                }
-
-                // Only update stationboard and BTC if not in night mode or during temporary wake
-                // AND if config portal is not running
-                if ((!inNightMode || temporaryNightWake || forceRefresh) && !portalRunning) {
-                    drawStationboard();
-                    drawBTC();
-                    debugInfo();
-                    Serial.println("============ End of refresh cycle ==================");
-                }
-
-                updateStartTime = currentMillis;
-                isUpdating = true;
-                forceRefresh = false;
-            } else {
-                displayStatus(false);
-                forceRefresh = false;
-            }
-        }
-        
-        // Check if update display time is over
-        if (isUpdating && currentMillis - updateStartTime >= UPDATE_DURATION) {
-            if (!portalRunning && !(inNightMode && temporaryNightWake)) {
-                lightSleep();
-            }
-            lastUpdate = currentMillis;
-            isUpdating = false;
-        }
+    // Radio at full power only for OTA, the portal and the refresh cycle itself
+    radioSetProfile((otaMode || portalRunning) ? RADIO_ACTIVE : RADIO_IDLE);
+    governorPhase(otaMode ? GOV_OTA : GOV_IDLE);
+
+    if (otaMode) return;
+
+    if (nightPrefetchDue()) {
+        nightPrefetch();
+    }
+
+    // Clock redraw on the minute edge, suspended while the display is dark
+    bool displayOn = !inNightMode || temporaryNightWake;
+    if (!displayOn) {
+        schedulerCancel(TASK_MINUTE_TICK);
+    } else if (schedulerDue(TASK_MINUTE_TICK) || !schedulerPending(TASK_MINUTE_TICK)) {
+        if (!portalRunning && timeIsSynced()) drawCurrentTime();
+        scheduleMinuteTick();
+    }
+
+    if (forceRefresh || schedulerDue(TASK_FETCH)) {
+        refreshCycle();
+        // Interval learned from the fresh board, fixed while dark
+        schedulerSetIn(TASK_FETCH, inNightMode ? NIGHT_CHECK_INTERVAL : pollingInterval());
+        schedulerSetIn(TASK_STAY_AWAKE, UPDATE_DURATION);
+    }
+
+    // Timetable downloads run a slice at a time, buttons and the clock stay live
+    if (schedulerDue(TASK_TIMETABLE) && !portalRunning) {
+        timetableSlice();
+    }
+
+    scheduleNightBoundary();
+
+    // Sleep until the earliest deadline, unless something keeps the device awake
+    if (schedulerPending(TASK_STAY_AWAKE) && !schedulerDue(TASK_STAY_AWAKE)) return;
+    if (portalRunning || (inNightMode && temporaryNightWake) || !button.isIdle()) return;
+
+    if (deepSleepAllowed()) {
+        deepSleepEnter(); // does not return, the next wake runs setup() again
+    }
+
+    uint64_t sleepMs = std::min<uint64_t>(schedulerTimeUntilNext(), NIGHT_CHECK_INTERVAL);
+    if (sleepMs >= MIN_SLEEP_DURATION) {
+        lightSleep(sleepMs * 1000ULL);
     }
 }
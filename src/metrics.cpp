@@ -0,0 +1,222 @@
+#include "metrics.h"
+#include "globals.h"
+#include "stationboard.h"
+#include "provider.h"
+#include "altboard.h"
+#include "timetable.h"
+#include "timesync.h"
+#include "wificache.h"
+#include "deepsleep.h"
+#include "polling.h"
+#include "energy.h"
+#include "tlssession.h"
+#include "latency.h"
+#include <WiFi.h>
+#include <WebServer.h>
+#include <stdarg.h>
+
+#define METRICS_PORT 9100
+#define HISTORY_SLOTS 48                               // 4 hours of 5 minute buckets
+static const unsigned long SAMPLE_INTERVAL = 60000;
+static const unsigned long BUCKET_INTERVAL = 300000;
+
+static WebServer metricsServer(METRICS_PORT);
+static bool serverStarted = false;
+
+// Counters fed by the refresh path
+static unsigned long cycles = 0;
+static unsigned long cycleLastMs = 0;
+static unsigned long cycleMaxMs = 0;
+static unsigned long fetches = 0;
+static unsigned long fetchErrors = 0;
+static unsigned long fetchLastMs = 0;
+static unsigned long fetchTotalMs = 0;
+
+// Downsampled history, each bucket keeps the worst or average of its samples
+struct HistoryBucket {
+    uint32_t uptime;        // s at the end of the bucket
+    uint32_t heapFreeMin;
+    uint32_t heapBlockMin;
+    int16_t rssiAvg;
+    uint16_t cycleMaxMs;
+    uint16_t fetchAvgMs;
+    uint16_t samples;
+};
+
+static HistoryBucket history[HISTORY_SLOTS];
+static uint8_t historyHead = 0;
+static uint8_t historyCount = 0;
+static HistoryBucket current;
+static int32_t rssiSum = 0;
+static unsigned long bucketFetches = 0;
+static unsigned long bucketFetchMs = 0;
+static unsigned long lastSample = 0;
+static unsigned long bucketStart = 0;
+
+void metricsRecordCycle(unsigned long ms) {
+    cycles++;
+    cycleLastMs = ms;
+    if (ms > cycleMaxMs) cycleMaxMs = ms;
+    if (ms > current.cycleMaxMs) current.cycleMaxMs = ms > 65535 ? 65535 : ms;
+}
+
+void metricsRecordFetch(unsigned long ms, bool success) {
+    fetches++;
+    if (!success) fetchErrors++;
+    fetchLastMs = ms;
+    fetchTotalMs += ms;
+    bucketFetches++;
+    bucketFetchMs += ms;
+}
+
+static void resetBucket() {
+    memset(&current, 0, sizeof(current));
+    current.heapFreeMin = UINT32_MAX;
+    current.heapBlockMin = UINT32_MAX;
+    rssiSum = 0;
+    bucketFetches = 0;
+    bucketFetchMs = 0;
+    bucketStart = millis();
+}
+
+static void sample() {
+    uint32_t heapFree = ESP.getFreeHeap();
+    uint32_t heapBlock = ESP.getMaxAllocHeap();
+    if (heapFree < current.heapFreeMin) current.heapFreeMin = heapFree;
+    if (heapBlock < current.heapBlockMin) current.heapBlockMin = heapBlock;
+    rssiSum += WiFi.RSSI();
+    current.samples++;
+
+    if (millis() - bucketStart < BUCKET_INTERVAL) return;
+    current.uptime = millis() / 1000;
+    current.rssiAvg = rssiSum / current.samples;
+    current.fetchAvgMs = bucketFetches ? bucketFetchMs / bucketFetches : 0;
+    history[historyHead] = current;
+    historyHead = (historyHead + 1) % HISTORY_SLOTS;
+    if (historyCount < HISTORY_SLOTS) historyCount++;
+    resetBucket();
+}
+
+// One line at a time from a stack buffer to the socket. A line that does not
+// fit is dropped whole, a cut one would run into the next line.
+static void writeLine(const char* format, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length >= (int)sizeof(line)) {
+        Serial.printf("Metrics: line of %d bytes dropped\n", length);
+        return;
+    }
+    if (length > 0) metricsServer.sendContent(line, length);
+}
+
+static void writeMetric(const char* name, const char* type, const char* help, double value) {
+    writeLine("# HELP stationboard_%s %s\n", name, help);
+    writeLine("# TYPE stationboard_%s %s\n", name, type);
+    writeLine("stationboard_%s %.6g\n", name, value);
+}
+
+static void writeRatio(const char* name, const char* help, unsigned long hits, unsigned long misses) {
+    writeMetric(name, "gauge", help, hits + misses ? (double)hits / (hits + misses) : 0.0);
+}
+
+// Prometheus histogram series from the log2 latency buckets, label may be empty
+static void writeHistogram(const char* name, const char* label, const LatencyHistogram& h) {
+    const char* sep = *label ? "," : "";
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        cumulative += h.buckets[i];
+        writeLine("stationboard_%s_bucket{%s%sle=\"%u\"} %u\n", name, label, sep, 1u << i, cumulative);
+    }
+    writeLine("stationboard_%s_bucket{%s%sle=\"+Inf\"} %u\n", name, label, sep, h.count);
+    writeLine("stationboard_%s_sum{%s} %llu\n", name, label, h.sumMs);
+    writeLine("stationboard_%s_count{%s} %u\n", name, label, h.count);
+}
+
+static void handleMetrics() {
+    metricsServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    metricsServer.send(200, "text/plain; version=0.0.4", "");
+
+    writeMetric("uptime_seconds", "counter", "Seconds since boot", millis() / 1000);
+    writeMetric("cycles_total", "counter", "Refresh cycles", cycles);
+    writeMetric("cycle_last_ms", "gauge", "Duration of the last refresh cycle", cycleLastMs);
+    writeMetric("cycle_max_ms", "gauge", "Longest refresh cycle since boot", cycleMaxMs);
+    writeMetric("fetches_total", "counter", "Stationboard requests", fetches);
+    writeMetric("fetch_errors_total", "counter", "Failed stationboard requests", fetchErrors);
+    writeMetric("fetch_last_ms", "gauge", "Latency of the last stationboard request", fetchLastMs);
+    writeMetric("fetch_avg_ms", "gauge", "Average stationboard request latency", fetches ? fetchTotalMs / fetches : 0);
+    writeMetric("fetch_bytes_total", "counter", "Stationboard response bytes", stationboardBytes);
+    writeMetric("heap_free_bytes", "gauge", "Free heap", ESP.getFreeHeap());
+    writeMetric("heap_largest_block_bytes", "gauge", "Largest allocatable heap block", ESP.getMaxAllocHeap());
+    writeMetric("stack_watermark_bytes", "gauge", "Loop task stack high watermark", uxTaskGetStackHighWaterMark(NULL));
+    writeMetric("wifi_rssi_dbm", "gauge", "WiFi signal strength", WiFi.RSSI());
+    writeMetric("wifi_connects_total", "counter", "WiFi (re)connect attempts", wifiConnects);
+    writeMetric("wifi_fast_connects_total", "counter", "Connects via the cached BSSID", wifiFastConnects);
+    writeMetric("wifi_fallbacks_total", "counter", "Directed connects that fell back to a scan", wifiFallbacks);
+    writeMetric("wifi_connect_last_ms", "gauge", "Duration of the last connect", wifiLastConnectMs);
+    writeRatio("altboard_hit_ratio", "Station switches served from the prerendered board", altBoardHits, altBoardMisses);
+    writeRatio("timetable_hit_ratio", "Boards served from the timetable store", timetableHits, timetableMisses);
+    writeMetric("timetable_live_skips_total", "counter", "Live polls left out, no departure close", timetableLiveSkips);
+    writeMetric("time_syncs_total", "counter", "SNTP syncs", timeSyncCount);
+    writeMetric("poll_interval_seconds", "gauge", "Current adaptive refresh interval", pollingInterval() / 1000);
+    writeMetric("poll_requests_total", "counter", "Stationboard polls by the adaptive interval", pollingRequests);
+    writeMetric("view_staleness_seconds_sum", "counter", "Age of the shown board summed over views", pollingStalenessTotal);
+    writeMetric("view_staleness_seconds_count", "counter", "Views (button press or wake) with a fetched board", pollingViews);
+    writeMetric("view_staleness_seconds_max", "gauge", "Oldest board seen at a view since boot", pollingStalenessMax);
+    writeMetric("deep_sleep_wakes_total", "counter", "Wakes from night deep sleep", deepSleepWakes);
+    writeMetric("tls_full_handshakes_total", "counter", "TLS handshakes without session resumption", tlsFullHandshakes);
+    writeMetric("tls_resumed_handshakes_total", "counter", "TLS handshakes resuming a cached session", tlsResumedHandshakes);
+    writeMetric("tls_full_handshake_ms", "gauge", "Duration of the last full TLS handshake", tlsFullHandshakeMs);
+    writeMetric("tls_resumed_handshake_ms", "gauge", "Duration of the last resumed TLS handshake", tlsResumedHandshakeMs);
+    writeMetric("tls_full_handshake_cycles", "gauge", "CPU cycles of the last full TLS handshake", tlsFullHandshakeCycles);
+    writeMetric("tls_resumed_handshake_cycles", "gauge", "CPU cycles of the last resumed TLS handshake", tlsResumedHandshakeCycles);
+    writeLine("# HELP stationboard_loop_gap_ms Gap between loop iterations, light sleep excluded\n");
+    writeLine("# TYPE stationboard_loop_gap_ms histogram\n");
+    writeHistogram("loop_gap_ms", "", latencyLoopGaps());
+    writeMetric("loop_gap_slo_violations_total", "counter", "Loop gaps over the budget", latencyLoopGaps().overSlo);
+    writeLine("# HELP stationboard_input_latency_ms Button edge to handler beyond the click timeout\n");
+    writeLine("# TYPE stationboard_input_latency_ms histogram\n");
+    unsigned long inputViolations = 0;
+    for (uint8_t i = 0; i < INPUT_COUNT; i++) {
+        char label[32];
+        snprintf(label, sizeof(label), "handler=\"%s\"", latencyInputName((InputHandler)i));
+        writeHistogram("input_latency_ms", label, latencyInputs((InputHandler)i));
+        inputViolations += latencyInputs((InputHandler)i).overSlo;
+    }
+    writeMetric("input_latency_slo_violations_total", "counter", "Button handlers later than the budget", inputViolations);
+    writeMetric("current_avg_ma", "gauge", "Average current from the energy model", energyAverageCurrent());
+    metricsServer.sendContent("", 0);
+}
+
+static void handleHistory() {
+    metricsServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    metricsServer.send(200, "text/plain", "");
+    writeLine("# uptime_s heap_free_min heap_block_min rssi_avg cycle_max_ms fetch_avg_ms samples\n");
+    uint8_t first = (historyHead + HISTORY_SLOTS - historyCount) % HISTORY_SLOTS;
+    for (uint8_t i = 0; i < historyCount; i++) {
+        const HistoryBucket& b = history[(first + i) % HISTORY_SLOTS];
+        writeLine("%lu %lu %lu %d %u %u %u\n", (unsigned long)b.uptime, (unsigned long)b.heapFreeMin,
+                  (unsigned long)b.heapBlockMin, b.rssiAvg, b.cycleMaxMs, b.fetchAvgMs, b.samples);
+    }
+    metricsServer.sendContent("", 0);
+}
+
+void metricsService() {
+    if (!serverStarted) {
+        if (WiFi.status() != WL_CONNECTED) return;
+        metricsServer.on("/metrics", HTTP_GET, handleMetrics);
+        metricsServer.on("/metrics/history", HTTP_GET, handleHistory);
+        metricsServer.begin();
+        serverStarted = true;
+        resetBucket();
+        Serial.printf("Metrics at http://%s:%d/metrics\n", WiFi.localIP().toString().c_str(), METRICS_PORT);
+    }
+    metricsServer.handleClient();
+
+    if (millis() - lastSample >= SAMPLE_INTERVAL) {
+        lastSample = millis();
+        sample();
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+// Prometheus text endpoint on port 9100 (port 80 belongs to the portal and OTA):
+// /metrics for the current counters, /metrics/history for the last hours
+void metricsService();
+void metricsRecordCycle(unsigned long ms);
+void metricsRecordFetch(unsigned long ms, bool success);
+
+#endif // METRICS_H
@@ -1,13 +1,18 @@
 #include "networking.h"
 #include <WiFi.h>
+#include <esp_wifi.h>
 #include <TFT_eSPI.h>
 #include "globals.h"
+#include "snapshot.h"
+#include "wificache.h"
+#include "radiopower.h"
+#include "governor.h"
+#include "fixedstring.h"
 
 extern WiFiManager wm;
 extern Config config;
 extern TFT_eSPI tft;
 extern const unsigned long HTTP_TIMEOUT;
-extern const char* getBTCAPI;
 
 // Define HTTP_CODE_OK if it's not already defined
 #ifndef HTTP_CODE_OK
@@ -15,6 +20,7 @@ extern const char* getBTCAPI;
 #endif
 
 void onConfigPortalStart(WiFiManager* myWiFiManager) {
+    snapshotStale = false; // instructions replace the restored board
     tft.fillScreen(TFT_BLACK);
     tft.loadFont(AA_FONT_SMALL);
     tft.setTextColor(TFT_WHITE, TFT_BLACK);
@@ -27,75 +33,149 @@ void onConfigPortalStart(WiFiManager* myWiFiManager) {
     tft.drawString("   192.168.4.1", 20, 135);
 }
 
-void setupWiFiManager() {
-    // Check for reset trigger first
-    Serial.println("Entering reset routine");
-    checkForConfigReset();
-
-    // Load existing configuration
-    Serial.println("Trying to load config from file");
-    loadConfiguration();
+// Portal fields, WiFiManager keeps pointers to them for the boot portal and
+// the on-demand web portal alike
+static const char* welcomeHTML = ""
+    "<div style='text-align:left; padding:15px; margin:10px; background:#666; color:white; border-radius:4px'>"
+    "<h2>Welcome to Stationboard Setup!</h2>"
+    "<p><small>Firmware v" FIRMWARE_VERSION "</small></p>"
+    "<p>This device shows real-time public transport departures for Swiss stations.</p>"
+    "<p><b>To configure your display:</b></p>"
+    "<ol>"
+    "<li>Enter your WiFi credentials</li>"
+    "<li>Set your station ID (doesn't need to be exact)</li>"
+    "<li>Configure display preferences</li>"
+    "<li>For firmware updates, press the button for 10 seconds on the main screen</li>"
+    "</ol>"
+    "<p><b>Need help? Contact:</b></p>"
+    "<p>✉️ pascal.holzmann@gmail.com</p>"
+    "<p>🌐 https://github.com/pashol/Stationboard</p>"
+    "</div>";
+
+static const char* nightModeHTML = ""
+    "<br/><hr/><br/>"
+    "<h3>Night Mode Settings</h3>"
+    "<p>Automatically turn off display during night hours to save power and reduce light pollution.</p>";
+
+static WiFiManagerParameter custom_html(welcomeHTML);
+static WiFiManagerParameter custom_station_id("station", "Station ID 1", "", 150);
+static WiFiManagerParameter custom_station_id2("station2", "Station ID 2", "", 150);
+static WiFiManagerParameter custom_limit("limit", "Number of Entries", "", 2);
+static WiFiManagerParameter custom_offset("offset", "Time to station (min)", "", 2);
+static WiFiManagerParameter custom_brightness("defaultBrightness", "Brightness level (0=off to 4=max)", "", 1);
+static WiFiManagerParameter custom_static_ip("staticIp", "Static IP (empty for DHCP)", "", 15);
+// Data source, station IDs are stop IDs for all but transport.opendata.ch
+static WiFiManagerParameter custom_provider("provider", "Data source (0=transport.opendata.ch, 1=GTFS-RT, 2=TRIAS, 3=OJP)", "", 1);
+static WiFiManagerParameter custom_provider_url("providerUrl", "Data source URL (empty for the default)", "", 200);
+static WiFiManagerParameter custom_provider_key("providerKey", "Data source API key", "", 100);
+static WiFiManagerParameter custom_nightmode_html(nightModeHTML);
+static WiFiManagerParameter custom_nightmode_enabled("nightModeEnabled", "Enable Night Mode (0 or 1)", "", 1);
+static WiFiManagerParameter custom_nightmode_start_hour("nightModeStartHour", "Start Hour (0-23)", "", 2);
+static WiFiManagerParameter custom_nightmode_start_min("nightModeStartMinute", "Start Minute (0-59)", "", 2);
+static WiFiManagerParameter custom_nightmode_end_hour("nightModeEndHour", "End Hour (0-23)", "", 2);
+static WiFiManagerParameter custom_nightmode_end_min("nightModeEndMinute", "End Minute (0-59)", "", 2);
+static WiFiManagerParameter custom_nightmode_weekend("nightModeWeekendDisable", "Disable on weekends (0 or 1)", "", 1);
+static WiFiManagerParameter custom_nightmode_deepsleep("nightDeepSleep", "Deep sleep at night (0 or 1)", "", 1);
+
+static bool portalParametersAdded = false;
+
+static void readPortalParameters() {
+    config.stationId = custom_station_id.getValue();
+    config.stationId2 = custom_station_id2.getValue();
+    config.limit = atoi(custom_limit.getValue());
+    config.offset = atoi(custom_offset.getValue());
+    config.defaultBrightness = atoi(custom_brightness.getValue());
+    config.staticIp = custom_static_ip.getValue();
+    config.staticIp.trim();
+    config.provider = atoi(custom_provider.getValue());
+    config.providerUrl = custom_provider_url.getValue();
+    config.providerUrl.trim();
+    config.providerKey = custom_provider_key.getValue();
+    config.providerKey.trim();
+    
+    // Night mode parameters
+    config.nightModeEnabled = atoi(custom_nightmode_enabled.getValue()) != 0;
+    config.nightModeStartHour = atoi(custom_nightmode_start_hour.getValue());
+    config.nightModeStartMinute = atoi(custom_nightmode_start_min.getValue());
+    config.nightModeEndHour = atoi(custom_nightmode_end_hour.getValue());
+    config.nightModeEndMinute = atoi(custom_nightmode_end_min.getValue());
+    config.nightModeWeekendDisable = atoi(custom_nightmode_weekend.getValue()) != 0;
+    config.nightDeepSleep = atoi(custom_nightmode_deepsleep.getValue()) != 0;
+}
 
-    // Set config save notify callback
-    wm.setSaveConfigCallback(saveConfigCallback);
+// Saved from the on-demand web portal, the board picks it up on the next refresh
+static void savePortalParameters() {
+    readPortalParameters();
+    saveConfiguration();
+    Serial.println("Portal parameters saved");
+}
 
-    // First, create the welcome message as a parameter
-    const char* welcomeHTML = ""
-        "<div style='text-align:left; padding:15px; margin:10px; background:#666; color:white; border-radius:4px'>"
-        "<h2>Welcome to Stationboard Setup!</h2>"
-        "<p><small>Firmware v" FIRMWARE_VERSION "</small></p>"
-        "<p>This device shows real-time public transport departures for Swiss stations.</p>"
-        "<p><b>To configure your display:</b></p>"
-        "<ol>"
-        "<li>Enter your WiFi credentials</li>"
-        "<li>Set your station ID (doesn't need to be exact)</li>"
-        "<li>Configure display preferences</li>"
-        "<li>For firmware updates, press the button for 10 seconds on the main screen</li>"
-        "</ol>"
-        "<p><b>Need help? Contact:</b></p>"
-        "<p>✉️ pascal.holzmann@gmail.com</p>"
-        "<p>🌐 https://github.com/pashol/Stationboard</p>"
-        "</div>";
-    
-    // Add welcome message as a parameter FIRST
-    WiFiManagerParameter custom_html(welcomeHTML);
+// Fills the portal fields from the current config and registers them once.
+// Called before the boot portal and before every on-demand web portal.
+void setupPortalParameters() {
+    // Defaults formatted into fixed buffers, WiFiManager copies them
+    FixedString<8> limitText, offsetText, brightnessText, providerText;
+    limitText.format("%d", config.limit);
+    offsetText.format("%d", config.offset);
+    brightnessText.format("%d", config.defaultBrightness);
+    providerText.format("%d", config.provider);
+    custom_station_id.setValue(config.stationId.c_str(), 150);
+    custom_station_id2.setValue(config.stationId2.c_str(), 150);
+    custom_limit.setValue(limitText.c_str(), 2);
+    custom_offset.setValue(offsetText.c_str(), 2);
+    custom_brightness.setValue(brightnessText.c_str(), 1);
+    custom_static_ip.setValue(config.staticIp.c_str(), 15);
+    custom_provider.setValue(providerText.c_str(), 1);
+    custom_provider_url.setValue(config.providerUrl.c_str(), 200);
+    custom_provider_key.setValue(config.providerKey.c_str(), 100);
+
+    FixedString<4> startHourText, startMinuteText, endHourText, endMinuteText;
+    startHourText.format("%d", config.nightModeStartHour);
+    startMinuteText.format("%d", config.nightModeStartMinute);
+    endHourText.format("%d", config.nightModeEndHour);
+    endMinuteText.format("%d", config.nightModeEndMinute);
+    custom_nightmode_enabled.setValue(config.nightModeEnabled ? "1" : "0", 1);
+    custom_nightmode_start_hour.setValue(startHourText.c_str(), 2);
+    custom_nightmode_start_min.setValue(startMinuteText.c_str(), 2);
+    custom_nightmode_end_hour.setValue(endHourText.c_str(), 2);
+    custom_nightmode_end_min.setValue(endMinuteText.c_str(), 2);
+    custom_nightmode_weekend.setValue(config.nightModeWeekendDisable ? "1" : "0", 1);
+    custom_nightmode_deepsleep.setValue(config.nightDeepSleep ? "1" : "0", 1);
+
+    if (portalParametersAdded) return;
+    portalParametersAdded = true;
+
+    // Welcome message FIRST
     wm.addParameter(&custom_html);
-
-    // Add custom parameters for transport display settings
-    WiFiManagerParameter custom_station_id("station", "Station ID 1", String(config.stationId).c_str(), 150);
-    WiFiManagerParameter custom_station_id2("station2", "Station ID 2", String(config.stationId2).c_str(), 150);
-    WiFiManagerParameter custom_limit("limit", "Number of Entries", String(config.limit).c_str(), 2);
-    WiFiManagerParameter custom_offset("offset", "Time to station (min)", String(config.offset).c_str(), 2);
-    WiFiManagerParameter custom_brightness("defaultBrightness", "Brightness level (0=off to 4=max)", String(config.defaultBrightness).c_str(), 1);
-    
     wm.addParameter(&custom_station_id);
     wm.addParameter(&custom_station_id2);
     wm.addParameter(&custom_limit);
     wm.addParameter(&custom_offset);
     wm.addParameter(&custom_brightness);
-
-    // Night mode section header
-    const char* nightModeHTML = ""
-        "<br/><hr/><br/>"
-        "<h3>Night Mode Settings</h3>"
-        "<p>Automatically turn off display during night hours to save power and reduce light pollution.</p>";
-    WiFiManagerParameter custom_nightmode_html(nightModeHTML);
+    wm.addParameter(&custom_static_ip);
+    wm.addParameter(&custom_provider);
+    wm.addParameter(&custom_provider_url);
+    wm.addParameter(&custom_provider_key);
     wm.addParameter(&custom_nightmode_html);
-
-    // Night mode parameters
-    WiFiManagerParameter custom_nightmode_enabled("nightModeEnabled", "Enable Night Mode (0 or 1)", String(config.nightModeEnabled ? "1" : "0").c_str(), 1);
-    WiFiManagerParameter custom_nightmode_start_hour("nightModeStartHour", "Start Hour (0-23)", String(config.nightModeStartHour).c_str(), 2);
-    WiFiManagerParameter custom_nightmode_start_min("nightModeStartMinute", "Start Minute (0-59)", String(config.nightModeStartMinute).c_str(), 2);
-    WiFiManagerParameter custom_nightmode_end_hour("nightModeEndHour", "End Hour (0-23)", String(config.nightModeEndHour).c_str(), 2);
-    WiFiManagerParameter custom_nightmode_end_min("nightModeEndMinute", "End Minute (0-59)", String(config.nightModeEndMinute).c_str(), 2);
-    WiFiManagerParameter custom_nightmode_weekend("nightModeWeekendDisable", "Disable on weekends (0 or 1)", String(config.nightModeWeekendDisable ? "1" : "0").c_str(), 1);
-    
     wm.addParameter(&custom_nightmode_enabled);
     wm.addParameter(&custom_nightmode_start_hour);
     wm.addParameter(&custom_nightmode_start_min);
     wm.addParameter(&custom_nightmode_end_hour);
     wm.addParameter(&custom_nightmode_end_min);
     wm.addParameter(&custom_nightmode_weekend);
+    wm.addParameter(&custom_nightmode_deepsleep);
+    wm.setSaveParamsCallback(savePortalParameters);
+}
+
+void setupWiFiManager() {
+    // Load existing configuration
+    Serial.println("Trying to load config from file");
+    loadConfiguration();
+
+    // Set config save notify callback
+    wm.setSaveConfigCallback(saveConfigCallback);
+
+    setupPortalParameters();
 
     // Customize the configuration portal
     wm.setTitle("Stationboard Setup");
@@ -124,24 +204,15 @@ void setupWiFiManager() {
         delay(5000);
     } else {
         // If you get here you have connected to the WiFi
-        tft.drawString("Successfully connected to WiFi network!", 20, 100);
+        if (!snapshotStale) {
+            tft.drawString("Successfully connected to WiFi network!", 20, 100);
+        }
         Serial.println("Successfully connected to WiFi network!");
+        wifiRemember(true);
     }
 
     // Read updated parameters
-    config.stationId = custom_station_id.getValue();
-    config.stationId2 = custom_station_id2.getValue();
-    config.limit = String(custom_limit.getValue()).toInt();
-    config.offset = String(custom_offset.getValue()).toInt();
-    config.defaultBrightness = String(custom_brightness.getValue()).toInt();
-    
-    // Night mode parameters
-    config.nightModeEnabled = String(custom_nightmode_enabled.getValue()).toInt() != 0;
-    config.nightModeStartHour = String(custom_nightmode_start_hour.getValue()).toInt();
-    config.nightModeStartMinute = String(custom_nightmode_start_min.getValue()).toInt();
-    config.nightModeEndHour = String(custom_nightmode_end_hour.getValue()).toInt();
-    config.nightModeEndMinute = String(custom_nightmode_end_min.getValue()).toInt();
-    config.nightModeWeekendDisable = String(custom_nightmode_weekend.getValue()).toInt() != 0;
+    readPortalParameters();
 
     // Save the custom parameters to config
     if (shouldSaveConfig) {
@@ -149,50 +220,18 @@ void setupWiFiManager() {
     }
 }
 
-void drawBTC() {
-    HTTPClient http;
-    http.setConnectTimeout(HTTP_TIMEOUT);
-    http.setTimeout(HTTP_TIMEOUT);
-    http.begin(getBTCAPI);
-    
-    int httpCode = http.GET();
-    Serial.print("HTTPCODE: ");
-    Serial.println(httpCode);
-
-    String bitcoin_price = "N/A";
-    
-    if (httpCode == HTTP_CODE_OK) {
-        String payload = http.getString();
-        DynamicJsonDocument doc(1024);
-        DeserializationError error = deserializeJson(doc, payload);
-        
-        if (!error && doc.containsKey("data") && doc["data"].containsKey("amount")) {
-            bitcoin_price = doc["data"]["amount"].as<String>().toInt();
-        }
-        displayStatus(true);
-    } else {
-        displayStatus(false);
-    }
-    
-    http.end();
+// Stored credentials: connect directly, the boot portal is only set up when
+// this fails. The on-demand portal registers its parameters itself.
+bool setupWiFiFast() {
+    loadConfiguration();
+    WiFi.mode(WIFI_STA);
+    wifi_config_t conf;
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK || conf.sta.ssid[0] == 0) return false;
+    return wifiConnect();
+}
 
-    // Create temporary sprite for BTC price display
-    TFT_eSprite btcSprite(&tft);
-    btcSprite.setColorDepth(8);
-    btcSprite.createSprite((tft.width() / 2) - 25, 25);
-    btcSprite.loadFont(AA_FONT_SMALL);
-    
-    // Clear sprite and set background
-    btcSprite.fillSprite(TFT_WHITE);
-    
-    // Draw BTC price
-    btcSprite.setTextDatum(TR_DATUM);
-    btcSprite.setTextColor(TFT_BLACK, TFT_WHITE);
-    btcSprite.drawString("BTC $" + bitcoin_price, btcSprite.width(), 5);
-    
-    // Push to bottom-right of screen
-    btcSprite.pushSprite(tft.width() / 2, tft.height() - 25);
-    
-    Serial.print("Bitcoin Price: ");
-    Serial.println(bitcoin_price);
+// Wake from deep sleep: stored credentials, no reset prompt and no portal
+void setupWiFiResume() {
+    loadConfiguration();
+    WiFi.mode(WIFI_STA);
 }
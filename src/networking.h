@@ -15,7 +15,9 @@ void saveConfigCallback();
 void displayStatus(bool isSuccess);
 
 void setupWiFiManager();
-void drawBTC();
+void setupPortalParameters();
+void setupWiFiResume();
+bool setupWiFiFast();
 
 // ArduinoJson forward declarations
 using ArduinoJson::DynamicJsonDocument;
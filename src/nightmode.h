@@ -11,5 +11,8 @@ void enterNightMode();
 void exitNightMode();
 void handleNightModeButton();
 void updateNightModeDisplay();
+time_t nextNightModeChange(time_t utc);
+bool nightPrefetchDue();
+void scheduleNightBoundary();
 
 #endif // NIGHTMODE_H
@@ -0,0 +1,105 @@
+#include "opendata.h"
+#include "globals.h"
+
+static const char* OPENDATA_URL = "http://transport.opendata.ch/v1/stationboard";
+
+OpendataProvider::OpendataProvider() : tokenizer(*this), sink(nullptr) {}
+
+bool OpendataProvider::request(const char* stationId, int limit, const char* datetime, ProviderRequest& request) {
+    request.url = config.providerUrl.isEmpty() ? OPENDATA_URL : config.providerUrl.c_str();
+    request.url.append("?id=").appendUrlEncoded(stationId).appendf("&limit=%d", limit);
+    if (datetime[0] != '\0') {
+        request.url.append("&datetime=").appendUrlEncoded(datetime); // without it the server answers for now
+    }
+    return true;
+}
+
+void OpendataProvider::begin(DepartureSink& sink) {
+    this->sink = &sink;
+    tokenizer.reset();
+    currentPath.clear();
+    currentKey.clear();
+    currentTransport = Transport();
+}
+
+bool OpendataProvider::feed(const uint8_t* data, size_t len) {
+    return tokenizer.feed(data, len);
+}
+
+bool OpendataProvider::finish() {
+    return tokenizer.finish();
+}
+
+void OpendataProvider::key(const char* key) {
+    currentKey = key;
+}
+
+void OpendataProvider::value(const char* value) {
+    FixedString<128> fullPath = currentPath;
+    fullPath.append('/').append(currentKey);
+
+    if (fullPath == "/station/name") {
+        sink->setStation(value);
+    }
+
+    if (fullPath.endsWith("/stop/departure")) {
+        // "YYYY-MM-DDTHH:MM:SS+0100", keep HH:MM
+        currentTransport.departure.clear();
+        if (strlen(value) >= 16) currentTransport.departure.assign(value + 11, 5);
+    }
+    else if (fullPath.endsWith("/stop/delay")) {
+        currentTransport.delay = value;
+    }
+    else if (fullPath.endsWith("/name")) {
+        currentTransport.name = value;
+    }
+    else if (fullPath.endsWith("/category")) {
+        currentTransport.category = value;
+    }
+    else if (fullPath.endsWith("/number")) {
+        if (strcmp(value, "null") != 0) {
+            int numValue = atoi(value);
+            currentTransport.number.clear();
+            if (numValue < 1000) currentTransport.number.format("%d", numValue);
+        }
+    }
+    else if (fullPath.endsWith("/to")) {
+        if (strlen(value) > 25) {
+            currentTransport.destination.assign(value, 22).append("...");
+        } else {
+            currentTransport.destination = value;
+        }
+        sink->add(currentTransport);
+        currentTransport = Transport();
+    }
+}
+
+// Objects and arrays extend the path by the key they belong to
+void OpendataProvider::enter() {
+    if (currentKey.length() > 0) {
+        currentPath.append('/').append(currentKey);
+    }
+}
+
+void OpendataProvider::leave() {
+    const char* lastSlash = strrchr(currentPath.c_str(), '/');
+    if (lastSlash) {
+        currentPath.truncate(lastSlash - currentPath.c_str());
+    }
+}
+
+void OpendataProvider::startObject() {
+    enter();
+}
+
+void OpendataProvider::endObject() {
+    leave();
+}
+
+void OpendataProvider::startArray() {
+    enter();
+}
+
+void OpendataProvider::endArray() {
+    leave();
+}
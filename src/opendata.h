@@ -0,0 +1,38 @@
+#ifndef OPENDATA_H
+#define OPENDATA_H
+
+#include "provider.h"
+#include "jsonsax.h"
+
+// transport.opendata.ch stationboard JSON. Rows are recognised by the path
+// of the keys, a row is complete with its "to" field.
+class OpendataProvider : public DataProvider, private JsonHandler {
+public:
+    OpendataProvider();
+
+    const char* name() const override { return "transport.opendata.ch"; }
+    bool request(const char* stationId, int limit, const char* datetime, ProviderRequest& request) override;
+    void begin(DepartureSink& sink) override;
+    bool feed(const uint8_t* data, size_t len) override;
+    bool finish() override;
+    bool pagesByTime() const override { return true; }
+
+private:
+    void key(const char* key) override;
+    void value(const char* value) override;
+    void startObject() override;
+    void endObject() override;
+    void startArray() override;
+    void endArray() override;
+
+    void enter();
+    void leave();
+
+    JsonTokenizer tokenizer;
+    DepartureSink* sink;
+    FixedString<32> currentKey;
+    FixedString<96> currentPath;
+    Transport currentTransport;
+};
+
+#endif // OPENDATA_H
@@ -1,7 +1,13 @@
 #include "ota.h"
 #include "globals.h"
 #include "nightmode.h"
+#include "utilities.h"
+#include "governor.h"
+#include "deltapatch.h"
+#include "heatshrink.h"
 #include <WiFi.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
 
 int ota_progress_millis = 0;
 WebServer server(80);
@@ -26,6 +32,110 @@ void onOTAEnd(bool success) {
     }
 }
 
+// Delta update: the running partition is the old image, the patch is applied
+// while it uploads and only a DELTA_WINDOW buffer is held in RAM
+class PartitionTarget : public DeltaTarget {
+public:
+    bool readOld(uint32_t offset, uint8_t* buf, size_t len) override {
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        return running && offset + len <= running->size &&
+               esp_partition_read(running, offset, buf, len) == ESP_OK;
+    }
+    bool begin(const DeltaHeader& header) override {
+        return Update.begin(header.newSize);
+    }
+    bool writeNew(const uint8_t* buf, size_t len) override {
+        return Update.write((uint8_t*)buf, len) == len;
+    }
+};
+
+static PartitionTarget deltaTarget;
+static DeltaPatcher deltaPatcher(deltaTarget);
+static bool deltaSuccess = false;
+
+static void handleDeltaUpload() {
+    HTTPUpload& upload = server.upload();
+    if (upload.status == UPLOAD_FILE_START) {
+        onOTAStart();
+        deltaPatcher.reset();
+        deltaSuccess = false;
+    } else if (upload.status == UPLOAD_FILE_WRITE) {
+        if (!deltaPatcher.failed()) {
+            deltaPatcher.feed(upload.buf, upload.currentSize);
+            onOTAProgress(deltaPatcher.written(), deltaPatcher.header().newSize);
+        }
+    } else if (upload.status == UPLOAD_FILE_END) {
+        deltaSuccess = deltaPatcher.finish() && Update.end(true);
+        if (!deltaSuccess) {
+            Serial.printf("Delta update failed: %s\n", deltaPatcher.lastError());
+            Update.abort();
+        }
+        onOTAEnd(deltaSuccess);
+    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+        Update.abort();
+    }
+}
+
+static void handleDeltaDone() {
+    if (deltaSuccess) {
+        server.send(200, "text/plain", "OK");
+        delay(500);
+        ESP.restart();
+    } else {
+        server.send(400, "text/plain", String("Delta update failed: ") + deltaPatcher.lastError());
+    }
+}
+
+// Compressed full image: decoded while it uploads, only the 2 KB window is kept
+class UpdateSink : public ByteSink {
+public:
+    bool write(const uint8_t* buf, size_t len) override {
+        return Update.write((uint8_t*)buf, len) == len;
+    }
+};
+
+static UpdateSink updateSink;
+static HeatshrinkDecoder compressedDecoder(updateSink);
+static bool compressedSuccess = false;
+
+static void handleCompressedUpload() {
+    HTTPUpload& upload = server.upload();
+    if (upload.status == UPLOAD_FILE_START) {
+        onOTAStart();
+        compressedDecoder.reset();
+        compressedSuccess = false;
+        if (!Update.begin(UPDATE_SIZE_UNKNOWN)) {
+            Serial.println("Compressed update: no OTA partition");
+        }
+    } else if (upload.status == UPLOAD_FILE_WRITE) {
+        if (!compressedDecoder.failed() && !Update.hasError()) {
+            compressedDecoder.feed(upload.buf, upload.currentSize);
+            onOTAProgress(upload.totalSize, server.clientContentLength());
+        }
+    } else if (upload.status == UPLOAD_FILE_END) {
+        compressedSuccess = !Update.hasError() && compressedDecoder.finish() && Update.end(true);
+        if (!compressedSuccess) {
+            Serial.printf("Compressed update failed after %u decoded bytes\n", compressedDecoder.written());
+            Update.abort();
+        } else {
+            Serial.printf("Compressed update: %u -> %u bytes\n", upload.totalSize, compressedDecoder.written());
+        }
+        onOTAEnd(compressedSuccess);
+    } else if (upload.status == UPLOAD_FILE_ABORTED) {
+        Update.abort();
+    }
+}
+
+static void handleCompressedDone() {
+    if (compressedSuccess) {
+        server.send(200, "text/plain", "OK");
+        delay(500);
+        ESP.restart();
+    } else {
+        server.send(400, "text/plain", "Compressed update failed");
+    }
+}
+
 void handleLongPress() {
     // OTA is disabled during night mode
     if (inNightMode) {
@@ -34,11 +144,13 @@ void handleLongPress() {
     }
     
     if (!otaMode) {
-        setCpuFrequencyMhz(240);
+        governorPhase(GOV_OTA);
         otaMode = true;
         server.on("/", HTTP_GET, []() {
             server.send(200, "text/html", "<a href='/update'>Update</a>");
         });
+        server.on("/delta", HTTP_POST, handleDeltaDone, handleDeltaUpload);
+        server.on("/ota", HTTP_POST, handleCompressedDone, handleCompressedUpload);
         ElegantOTA.begin(&server);
         // ElegantOTA callbacks
         ElegantOTA.onStart(onOTAStart);
@@ -0,0 +1,151 @@
+#include "polling.h"
+#include "globals.h"
+#include "utilities.h"
+#include "timesync.h"
+#include <Preferences.h>
+
+static const unsigned long POLL_MIN = 20000;    // delays moving or departure leaving
+static const unsigned long POLL_MAX = 300000;   // stable board, nothing leaving soon
+static const float CHANGE_GAIN = 0.3f;          // recent volatility, per poll
+static const float PROFILE_GAIN = 0.02f;        // hourly profile, settles over a few days
+#define POLL_TRACKED 16
+
+struct TrackedDelay {
+    uint32_t key;
+    int16_t delay;
+};
+
+static TrackedDelay tracked[POLL_TRACKED];
+static uint8_t trackedCount = 0;
+static uint8_t trackedStation = 255;
+
+static float volatility = 0.5f;                 // share of rows with a changed delay, smoothed
+static float hourProfile[24];
+static bool profileLoaded = false;
+static int profileHour = -1;
+
+static unsigned long currentInterval = UPDATE_INTERVAL;
+static unsigned long lastFetch = 0;
+
+unsigned long pollingRequests = 0;
+static unsigned long intervalTotal = 0;
+unsigned long pollingViews = 0;
+unsigned long pollingStalenessTotal = 0;
+unsigned long pollingStalenessMax = 0;
+
+static uint32_t rowKey(const Transport& t) {
+    uint32_t hash = 2166136261u;
+    for (char c : t.name) hash = (hash ^ (uint8_t)c) * 16777619u;
+    for (char c : t.departure) hash = (hash ^ (uint8_t)c) * 16777619u;
+    return hash;
+}
+
+static void loadProfile() {
+    profileLoaded = true;
+    for (int h = 0; h < 24; h++) hourProfile[h] = 0.5f;
+    Preferences prefs;
+    if (prefs.begin("poll", true)) {
+        if (prefs.getBytesLength("profile") == sizeof(hourProfile)) {
+            prefs.getBytes("profile", hourProfile, sizeof(hourProfile));
+        }
+        prefs.end();
+    }
+}
+
+// Once per hour, the profile changes slowly
+static void saveProfile() {
+    Preferences prefs;
+    if (prefs.begin("poll", false)) {
+        prefs.putBytes("profile", hourProfile, sizeof(hourProfile));
+        prefs.end();
+    }
+}
+
+// Milliseconds until the earliest row (with delay) leaves, or POLL_MAX
+static unsigned long untilFirstDeparture(const std::vector<Transport>& transports) {
+    if (!timeIsSynced()) return POLL_MAX;
+    const LocalTime& now = localTime();
+    int nowMinute = now.hour * 60 + now.minute;
+    long best = POLL_MAX;
+    for (const Transport& t : transports) {
+        if (t.name == "null" || t.departure.length() < 5) continue;
+        int minute = atoi(t.departure.c_str()) * 60 + atoi(t.departure.c_str() + 3) + t.delay.toInt();
+        int diff = ((minute - nowMinute) % 1440 + 1440) % 1440;
+        if (diff > 720) continue; // already gone
+        // Just after the minute it leaves, so the row drops off
+        long ms = (long)(diff + 1) * 60000L - (long)(timeNow() % 60) * 1000L;
+        if (ms < best) best = ms;
+    }
+    return best < (long)POLL_MIN ? POLL_MIN : (unsigned long)best;
+}
+
+void pollingObserve(uint8_t stationIndex, const std::vector<Transport>& transports) {
+    if (!profileLoaded) loadProfile();
+    pollingRequests++;
+    lastFetch = millis();
+
+    // Delay changes against the previous board of the same station
+    int compared = 0;
+    int changed = 0;
+    TrackedDelay next[POLL_TRACKED];
+    uint8_t nextCount = 0;
+    for (const Transport& t : transports) {
+        if (nextCount >= POLL_TRACKED) break;
+        TrackedDelay row = {rowKey(t), (int16_t)t.delay.toInt()};
+        next[nextCount++] = row;
+        if (trackedStation != stationIndex) continue;
+        for (uint8_t i = 0; i < trackedCount; i++) {
+            if (tracked[i].key != row.key) continue;
+            compared++;
+            if (tracked[i].delay != row.delay) changed++;
+            break;
+        }
+    }
+    memcpy(tracked, next, sizeof(TrackedDelay) * nextCount);
+    trackedCount = nextCount;
+    trackedStation = stationIndex;
+
+    int hour = timeIsSynced() ? localTime().hour : -1;
+    if (compared > 0) {
+        float rate = (float)changed / compared;
+        volatility += (rate - volatility) * CHANGE_GAIN;
+        if (hour >= 0) hourProfile[hour] += (rate - hourProfile[hour]) * PROFILE_GAIN;
+    }
+    if (hour >= 0 && hour != profileHour) {
+        if (profileHour >= 0) saveProfile();
+        profileHour = hour;
+    }
+
+    // Busy boards poll fast, stable ones back off, never past the next departure
+    float activity = volatility;
+    if (hour >= 0 && hourProfile[hour] > activity) activity = hourProfile[hour];
+    activity = constrain(activity, 0.0f, 1.0f);
+    unsigned long interval = POLL_MAX - (unsigned long)((POLL_MAX - POLL_MIN) * activity);
+    currentInterval = std::min(interval, untilFirstDeparture(transports));
+    intervalTotal += currentInterval / 1000;
+
+    Serial.printf("Polling: %d/%d delays changed, activity %.2f, next in %lu s\n",
+                  changed, compared, activity, currentInterval / 1000);
+}
+
+unsigned long pollingInterval() {
+    return currentInterval;
+}
+
+// Someone looks at the board (button press or wake), how old is what they see
+void pollingViewed() {
+    if (lastFetch == 0) return;
+    unsigned long age = millis() - lastFetch;
+    pollingViews++;
+    pollingStalenessTotal += age / 1000;
+    if (age / 1000 > pollingStalenessMax) pollingStalenessMax = age / 1000;
+}
+
+void pollingReport() {
+    Serial.printf("Polling: %lu requests, avg interval %lu s, activity %.2f\n", pollingRequests,
+                  pollingRequests ? intervalTotal / pollingRequests : 0, volatility);
+    if (pollingViews > 0) {
+        Serial.printf("Staleness at view: avg %lu s, max %lu s (%lu views)\n",
+                      pollingStalenessTotal / pollingViews, pollingStalenessMax, pollingViews);
+    }
+}
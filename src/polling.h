@@ -0,0 +1,21 @@
+#ifndef POLLING_H
+#define POLLING_H
+
+#include <Arduino.h>
+#include <vector>
+#include "stationboard.h"
+
+// Refresh interval learned from the board: short while delays change or the
+// next departure is about to leave, long when the board is stable, biased by
+// a per-hour activity profile kept in NVS
+extern unsigned long pollingRequests;
+extern unsigned long pollingViews;
+extern unsigned long pollingStalenessTotal;   // s, summed over the views
+extern unsigned long pollingStalenessMax;     // s
+
+void pollingObserve(uint8_t stationIndex, const std::vector<Transport>& transports);
+unsigned long pollingInterval();
+void pollingViewed();
+void pollingReport();
+
+#endif // POLLING_H
@@ -0,0 +1,132 @@
+#include "provider.h"
+#include "globals.h"
+#include "opendata.h"
+#include "trias.h"
+#include "gtfsprovider.h"
+#include "radiopower.h"
+#include "governor.h"
+#include "metrics.h"
+#include "heaptrack.h"
+#include "tlssession.h"
+#include <HTTPClient.h>
+
+unsigned long stationboardRequests = 0;
+unsigned long stationboardBytes = 0;
+
+void DepartureSink::begin(size_t capacity) {
+    this->capacity = capacity;
+    stationName.clear();
+    rows.clear();
+}
+
+void DepartureSink::setStation(const char* name) {
+    if (!stationName.isEmpty() || name[0] == '\0') return;
+    stationName = name;
+    Serial.printf("Found station: %s\n", name);
+}
+
+bool DepartureSink::add(const Transport& transport) {
+    if (full()) return false;
+    rows.push_back(transport);
+    return true;
+}
+
+DataProvider& activeProvider() {
+    static OpendataProvider opendata;
+    static GtfsProvider gtfs;
+    static TriasProvider trias(false);
+    static TriasProvider ojp(true);
+    switch (config.provider) {
+        case PROVIDER_GTFS_RT: return gtfs;
+        case PROVIDER_TRIAS: return trias;
+        case PROVIDER_OJP: return ojp;
+        default: return opendata;
+    }
+}
+
+// One board from the configured provider, the response is parsed while it is read
+bool fetchDepartures(const String& stationId, int limit, const char* datetime,
+                     String& station, std::vector<Transport>& transports) {
+    DataProvider& provider = activeProvider();
+    static ProviderRequest request;
+    request = ProviderRequest();
+    if (!provider.request(stationId.c_str(), limit, datetime, request) || request.url.truncated() ||
+        request.body.truncated()) {
+        Serial.printf("%s: no request for %s\n", provider.name(), stationId.c_str());
+        return false;
+    }
+
+    Serial.printf("Relative Time: %s\n", datetime);
+    Serial.printf("URL: %s\n", request.url.c_str());
+
+    HTTPClient http;
+    http.setConnectTimeout(HTTP_TIMEOUT);
+    http.setTimeout(HTTP_TIMEOUT);
+    http.useHTTP10(true); // no chunked encoding, the body is read straight from the socket
+    TlsSessionClient secureClient;
+    WiFiClient plainClient;
+    heapTag(HEAP_TAG_HTTP);
+    bool secure = request.url.startsWith("https://");
+    if (secure) {
+        http.begin(secureClient, request.url.c_str());
+    } else {
+        http.begin(plainClient, request.url.c_str());
+    }
+    // The API key only goes out over a session with a verified certificate
+    if (request.authorization && secure) {
+        http.addHeader("Authorization", request.authorization);
+    } else if (request.authorization) {
+        Serial.printf("%s: API key not sent over plain HTTP\n", provider.name());
+    }
+    if (request.contentType) http.addHeader("Content-Type", request.contentType);
+    governorPhase(GOV_NETWORK);
+
+    unsigned long requestStart = millis();
+    int httpCode = request.body.isEmpty() ? http.GET()
+                                          : http.POST((uint8_t*)request.body.c_str(), request.body.length());
+    radioRecordLatency(millis() - requestStart);
+    metricsRecordFetch(millis() - requestStart, httpCode == HTTP_CODE_OK);
+
+    static DepartureSink sink;
+    bool success = false;
+    if (httpCode == HTTP_CODE_OK) {
+        stationboardRequests++;
+        governorPhase(GOV_PARSE);
+        heapTag(HEAP_TAG_PARSER);
+        sink.begin(PROVIDER_MAX_ROWS);
+        provider.begin(sink);
+
+        WiFiClient* stream = http.getStreamPtr();
+        int remaining = http.getSize(); // -1 without Content-Length, read until close
+        uint8_t chunk[256];
+        unsigned long lastData = millis();
+        bool parsed = true;
+        while (parsed && http.connected() && (remaining > 0 || remaining == -1)) {
+            size_t available = stream->available();
+            if (available == 0) {
+                if (millis() - lastData > HTTP_TIMEOUT) break;
+                delay(1);
+                continue;
+            }
+            int count = stream->readBytes(chunk, std::min(available, sizeof(chunk)));
+            lastData = millis();
+            stationboardBytes += count;
+            parsed = provider.feed(chunk, count);
+            if (remaining > 0) remaining -= count;
+        }
+        success = parsed && remaining <= 0 && provider.finish();
+        Serial.printf("%s: %u departures in %lu ms%s\n", provider.name(), sink.departures().size(),
+                      millis() - requestStart, success ? "" : ", incomplete");
+    } else {
+        Serial.printf("%s: HTTP %d\n", provider.name(), httpCode);
+    }
+    http.end();
+
+    if (success) {
+        heapTag(HEAP_TAG_TRANSPORTS);
+        if (station != sink.station()) station = sink.station();
+        transports = sink.departures();
+    }
+    heapTag(HEAP_TAG_NONE);
+    return success;
+}
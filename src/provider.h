@@ -0,0 +1,68 @@
+#ifndef PROVIDER_H
+#define PROVIDER_H
+
+#include <Arduino.h>
+#include <vector>
+#include "stationboard.h"
+#include "fixedstring.h"
+
+// Departure data sources. A provider builds the request for a board and
+// parses the response while it streams in, handing rows to a bounded sink.
+// The board cache and the renderer only ever see Transport rows, so a
+// provider can change its wire format without touching the display code.
+#define PROVIDER_MAX_ROWS 32
+
+enum ProviderId {
+    PROVIDER_OPENDATA = 0,   // transport.opendata.ch JSON
+    PROVIDER_GTFS_RT = 1,    // GTFS-Realtime TripUpdates
+    PROVIDER_TRIAS = 2,      // TRIAS 1.1 StopEventRequest
+    PROVIDER_OJP = 3,        // OJP 1.0 StopEventRequest
+};
+
+struct ProviderRequest {
+    FixedString<256> url;
+    FixedString<1024> body;              // sent as POST when not empty
+    const char* contentType = nullptr;
+    const char* authorization = nullptr; // Authorization header, nullptr: none
+};
+
+// Rows past the capacity are dropped, the first station name sticks
+class DepartureSink {
+public:
+    void begin(size_t capacity);
+    void setStation(const char* name);
+    bool add(const Transport& transport);   // false once full
+    bool full() const { return rows.size() >= capacity; }
+
+    const char* station() const { return stationName.c_str(); }
+    const std::vector<Transport>& departures() const { return rows; }
+
+private:
+    FixedString<64> stationName;
+    std::vector<Transport> rows;
+    size_t capacity = 0;
+};
+
+class DataProvider {
+public:
+    virtual ~DataProvider() {}
+    virtual const char* name() const = 0;
+
+    // datetime is local "YYYY-MM-DD HH:MM", empty for now
+    virtual bool request(const char* stationId, int limit, const char* datetime, ProviderRequest& request) = 0;
+    virtual void begin(DepartureSink& sink) = 0;
+    virtual bool feed(const uint8_t* data, size_t len) = 0;   // false stops the transfer
+    virtual bool finish() = 0;                                // the response was complete
+
+    // Boards can be requested from any time of day, the timetable store needs this
+    virtual bool pagesByTime() const { return false; }
+};
+
+extern unsigned long stationboardRequests;
+extern unsigned long stationboardBytes;
+
+DataProvider& activeProvider();
+bool fetchDepartures(const String& stationId, int limit, const char* datetime,
+                     String& station, std::vector<Transport>& transports);
+
+#endif // PROVIDER_H
@@ -0,0 +1,72 @@
+#include "radiopower.h"
+#include "energy.h"
+#include <esp_wifi.h>
+
+static const uint16_t RADIO_LISTEN_INTERVAL = 10; // beacons (~1 s), only used in modem sleep
+
+static RadioProfile currentProfile = RADIO_ACTIVE;
+static unsigned long profileSince = 0;
+static unsigned long timeInProfile[2] = {0, 0};
+static unsigned long profileSwitches = 0;
+
+// Request latency per profile in effect when the request started
+static unsigned long latencyCount[2] = {0, 0};
+static unsigned long latencyTotal[2] = {0, 0};
+static unsigned long latencyMax[2] = {0, 0};
+
+static void applyProfile(RadioProfile profile) {
+    esp_wifi_set_ps(profile == RADIO_ACTIVE ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+    energyRadio(profile == RADIO_ACTIVE);
+}
+
+void radioPowerBegin() {
+    // Boot fetches run at full power, the loop drops to modem sleep afterwards
+    currentProfile = RADIO_ACTIVE;
+    profileSince = millis();
+    applyProfile(currentProfile);
+}
+
+void radioSetProfile(RadioProfile profile) {
+    if (profile == currentProfile) return;
+
+    unsigned long now = millis();
+    timeInProfile[currentProfile] += now - profileSince;
+    profileSince = now;
+    currentProfile = profile;
+    profileSwitches++;
+    applyProfile(profile);
+}
+
+RadioProfile radioProfile() {
+    return currentProfile;
+}
+
+// Listen interval is part of the station config and applies from the next association
+void radioTuneStaConfig() {
+    wifi_config_t conf;
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK) return;
+    if (conf.sta.listen_interval == RADIO_LISTEN_INTERVAL) return;
+    conf.sta.listen_interval = RADIO_LISTEN_INTERVAL;
+    esp_wifi_set_config(WIFI_IF_STA, &conf);
+}
+
+void radioRecordLatency(unsigned long ms) {
+    latencyCount[currentProfile]++;
+    latencyTotal[currentProfile] += ms;
+    if (ms > latencyMax[currentProfile]) latencyMax[currentProfile] = ms;
+}
+
+void radioPowerReport() {
+    unsigned long active = timeInProfile[RADIO_ACTIVE];
+    unsigned long idle = timeInProfile[RADIO_IDLE];
+    unsigned long running = millis() - profileSince;
+    if (currentProfile == RADIO_ACTIVE) active += running; else idle += running;
+
+    Serial.printf("Radio: %lu s full power, %lu s modem sleep, %lu switches\n",
+                  active / 1000, idle / 1000, profileSwitches);
+    for (int p = RADIO_ACTIVE; p >= RADIO_IDLE; p--) {
+        if (latencyCount[p] == 0) continue;
+        Serial.printf("Requests (%s): %lu, avg %lu ms, max %lu ms\n", p == RADIO_ACTIVE ? "full power" : "modem sleep",
+                      latencyCount[p], latencyTotal[p] / latencyCount[p], latencyMax[p]);
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef RADIOPOWER_H
+#define RADIOPOWER_H
+
+#include <Arduino.h>
+
+// Radio power profile: modem sleep with a long listen interval while idle,
+// full power only around fetches, OTA and the config portal
+enum RadioProfile {
+    RADIO_IDLE,     // WIFI_PS_MAX_MODEM, wakes every RADIO_LISTEN_INTERVAL beacons
+    RADIO_ACTIVE    // WIFI_PS_NONE
+};
+
+void radioPowerBegin();
+void radioSetProfile(RadioProfile profile);
+RadioProfile radioProfile();
+void radioTuneStaConfig();
+void radioRecordLatency(unsigned long ms);
+void radioPowerReport();
+
+#endif // RADIOPOWER_H
@@ -0,0 +1,79 @@
+#include "scheduler.h"
+
+#ifdef ARDUINO
+#include <esp_timer.h>
+
+// esp_timer keeps counting through light sleep
+static uint64_t defaultClock() {
+    return esp_timer_get_time() / 1000;
+}
+#else
+#include <chrono>
+
+static uint64_t defaultClock() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+static SchedulerClock schedulerClock = defaultClock;
+static uint64_t deadlines[TASK_COUNT] = {SCHEDULER_NONE, SCHEDULER_NONE, SCHEDULER_NONE, SCHEDULER_NONE, SCHEDULER_NONE,
+                                         SCHEDULER_NONE};
+
+void schedulerSetClock(SchedulerClock clock) {
+    schedulerClock = clock ? clock : defaultClock;
+}
+
+uint64_t schedulerNow() {
+    return schedulerClock();
+}
+
+void schedulerSet(SchedulerTask task, uint64_t dueMs) {
+    deadlines[task] = dueMs;
+}
+
+void schedulerSetIn(SchedulerTask task, uint64_t delayMs) {
+    deadlines[task] = schedulerNow() + delayMs;
+}
+
+void schedulerCancel(SchedulerTask task) {
+    deadlines[task] = SCHEDULER_NONE;
+}
+
+bool schedulerPending(SchedulerTask task) {
+    return deadlines[task] != SCHEDULER_NONE;
+}
+
+// True once when the deadline has passed, the task has to register its next one
+bool schedulerDue(SchedulerTask task) {
+    if (deadlines[task] == SCHEDULER_NONE || schedulerNow() < deadlines[task]) return false;
+    deadlines[task] = SCHEDULER_NONE;
+    return true;
+}
+
+uint64_t schedulerDeadline(SchedulerTask task) {
+    return deadlines[task];
+}
+
+uint64_t schedulerNextDeadline(SchedulerTask* task) {
+    uint64_t next = SCHEDULER_NONE;
+    for (int i = 0; i < TASK_COUNT; i++) {
+        if (deadlines[i] < next) {
+            next = deadlines[i];
+            if (task) *task = (SchedulerTask)i;
+        }
+    }
+    return next;
+}
+
+uint64_t schedulerTimeUntilNext() {
+    uint64_t next = schedulerNextDeadline();
+    if (next == SCHEDULER_NONE) return SCHEDULER_NONE;
+    uint64_t now = schedulerNow();
+    return next > now ? next - now : 0;
+}
+
+// Next clock redraw right after the minute edge of the wall-clock time wallMs
+void schedulerSetMinuteTick(uint64_t wallMs) {
+    schedulerSetIn(TASK_MINUTE_TICK, 60000ULL - wallMs % 60000ULL + MINUTE_TICK_GUARD);
+}
@@ -0,0 +1,36 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Deadlines registered by the subsystems, the device sleeps until the earliest one.
+// Plain C++ without Arduino dependencies, the clock can be replaced for host tests.
+enum SchedulerTask {
+    TASK_MINUTE_TICK = 0,   // redraw the clock on the minute edge
+    TASK_FETCH,             // next refresh cycle
+    TASK_NIGHT_BOUNDARY,    // night mode flips, or the morning prefetch
+    TASK_NIGHT_WAKE_END,    // temporary night wake expires
+    TASK_STAY_AWAKE,        // awake window after a refresh or button activity
+    TASK_TIMETABLE,         // next slice of a timetable download
+    TASK_COUNT
+};
+
+#define SCHEDULER_NONE UINT64_MAX
+#define MINUTE_TICK_GUARD 20   // ms after the minute edge, so the new minute is shown
+
+typedef uint64_t (*SchedulerClock)(); // milliseconds, monotonic
+
+void schedulerSetClock(SchedulerClock clock);
+uint64_t schedulerNow();
+
+void schedulerSet(SchedulerTask task, uint64_t dueMs);
+void schedulerSetIn(SchedulerTask task, uint64_t delayMs);
+void schedulerCancel(SchedulerTask task);
+bool schedulerPending(SchedulerTask task);
+bool schedulerDue(SchedulerTask task);
+uint64_t schedulerDeadline(SchedulerTask task);
+uint64_t schedulerNextDeadline(SchedulerTask* task = nullptr);
+uint64_t schedulerTimeUntilNext();
+void schedulerSetMinuteTick(uint64_t wallMs);
+
+#endif // SCHEDULER_H
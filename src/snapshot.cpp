@@ -0,0 +1,262 @@
+#include "snapshot.h"
+#include "globals.h"
+#include "utilities.h"
+#include <SPIFFS.h>
+#include <rom/crc.h>
+
+// The board sprites are 8 bit (RGB332), so every pixel is already a palette
+// byte. Each region is stored PackBits-style in its own file:
+//   control byte < 128  -> copy the next (control + 1) bytes
+//   control byte >= 128 -> repeat the next byte (control - 126) times
+
+static const uint32_t SNAPSHOT_MAGIC = 0x50414E53; // "SNAP"
+static const unsigned long SNAPSHOT_WRITE_INTERVAL = 300000; // 5 minutes between flash writes
+static const int SNAPSHOT_MAX_WIDTH = 320;
+static const char* SNAPSHOT_META = "/snap.meta";
+static const char* SNAPSHOT_FILES[SNAPSHOT_REGION_COUNT] = {"/snap0.rle", "/snap1.rle", "/snap2.rle"};
+
+struct SnapshotRegionHeader {
+    uint32_t magic;
+    uint32_t crc;
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+};
+
+struct SnapshotMeta {
+    uint32_t magic;
+    uint8_t stationIndex;
+    char label[27];
+};
+
+bool snapshotStale = false;
+
+static uint32_t regionCrc[SNAPSHOT_REGION_COUNT] = {0};
+static bool regionChanged = false;
+static bool snapshotWritten = false;
+static unsigned long lastSnapshotWrite = 0;
+static char snapshotLabel[27] = "";
+
+// Small buffered reader so decoding does not hit the VFS for every byte
+struct SnapshotReader {
+    File& file;
+    uint8_t buffer[256];
+    size_t length = 0;
+    size_t position = 0;
+
+    explicit SnapshotReader(File& f) : file(f) {}
+
+    bool next(uint8_t& b) {
+        if (position >= length) {
+            length = file.read(buffer, sizeof(buffer));
+            position = 0;
+            if (length == 0) return false;
+        }
+        b = buffer[position++];
+        return true;
+    }
+};
+
+static void encodeRegion(File& file, const uint8_t* data, size_t len) {
+    uint8_t out[129];
+    size_t i = 0;
+
+    while (i < len) {
+        size_t run = 1;
+        while (i + run < len && run < 129 && data[i + run] == data[i]) run++;
+
+        if (run >= 2) {
+            out[0] = run + 126;
+            out[1] = data[i];
+            file.write(out, 2);
+            i += run;
+            continue;
+        }
+
+        // Literal block ends where the next run of two starts
+        size_t lit = 1;
+        while (i + lit < len && lit < 128) {
+            if (i + lit + 1 < len && data[i + lit] == data[i + lit + 1]) break;
+            lit++;
+        }
+        out[0] = lit - 1;
+        memcpy(out + 1, data + i, lit);
+        file.write(out, lit + 1);
+        i += lit;
+    }
+}
+
+static bool writeRegion(SnapshotRegion region, const uint8_t* pixels, int16_t width, int16_t height,
+                        int32_t x, int32_t y, uint32_t crc) {
+    String tmpPath = String(SNAPSHOT_FILES[region]) + ".tmp";
+    File file = SPIFFS.open(tmpPath, FILE_WRITE);
+    if (!file) {
+        Serial.println("Snapshot: failed to open file for writing");
+        return false;
+    }
+
+    SnapshotRegionHeader header = {SNAPSHOT_MAGIC, crc, (int16_t)x, (int16_t)y, (uint16_t)width, (uint16_t)height};
+    file.write((const uint8_t*)&header, sizeof(header));
+    encodeRegion(file, pixels, (size_t)width * height);
+    size_t size = file.size();
+    file.close();
+
+    SPIFFS.remove(SNAPSHOT_FILES[region]);
+    if (!SPIFFS.rename(tmpPath.c_str(), SNAPSHOT_FILES[region])) {
+        Serial.println("Snapshot: failed to rename region file");
+        return false;
+    }
+
+    Serial.printf("Snapshot region %d written: %u bytes (raw %u)\n", region, size, width * height);
+    return true;
+}
+
+static bool readRegionHeader(File& file, SnapshotRegionHeader& header) {
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+    return header.magic == SNAPSHOT_MAGIC && header.width > 0 && header.width <= SNAPSHOT_MAX_WIDTH;
+}
+
+static bool drawRegion(SnapshotRegion region) {
+    File file = SPIFFS.open(SNAPSHOT_FILES[region], FILE_READ);
+    if (!file) return false;
+
+    SnapshotRegionHeader header;
+    if (!readRegionHeader(file, header)) {
+        file.close();
+        return false;
+    }
+
+    SnapshotReader reader(file);
+    uint8_t line[SNAPSHOT_MAX_WIDTH];
+    uint16_t col = 0;
+    uint16_t row = 0;
+
+    auto emit = [&](uint8_t pixel) {
+        line[col++] = pixel;
+        if (col == header.width) {
+            tft.pushImage(header.x, header.y + row, header.width, 1, line, true);
+            col = 0;
+            row++;
+        }
+    };
+
+    uint8_t ctrl, pixel;
+    while (row < header.height && reader.next(ctrl)) {
+        if (ctrl < 128) {
+            for (int i = 0; i <= ctrl && row < header.height; i++) {
+                if (!reader.next(pixel)) break;
+                emit(pixel);
+            }
+        } else {
+            if (!reader.next(pixel)) break;
+            for (int i = 0; i < ctrl - 126 && row < header.height; i++) {
+                emit(pixel);
+            }
+        }
+    }
+    file.close();
+
+    regionCrc[region] = header.crc;
+    return row == header.height;
+}
+
+bool snapshotRestore() {
+    unsigned long start = millis();
+
+    File metaFile = SPIFFS.open(SNAPSHOT_META, FILE_READ);
+    if (!metaFile) {
+        Serial.println("No boot snapshot found");
+        return false;
+    }
+    SnapshotMeta meta;
+    size_t read = metaFile.read((uint8_t*)&meta, sizeof(meta));
+    metaFile.close();
+    if (read != sizeof(meta) || meta.magic != SNAPSHOT_MAGIC) {
+        Serial.println("Boot snapshot invalid");
+        return false;
+    }
+
+    for (int i = 0; i < SNAPSHOT_REGION_COUNT; i++) {
+        if (!SPIFFS.exists(SNAPSHOT_FILES[i])) {
+            Serial.println("Boot snapshot incomplete");
+            return false;
+        }
+    }
+
+    tft.fillScreen(TFT_BLUE);
+    for (int i = 0; i < SNAPSHOT_REGION_COUNT; i++) {
+        if (!drawRegion((SnapshotRegion)i)) {
+            Serial.printf("Boot snapshot region %d corrupt\n", i);
+            memset(regionCrc, 0, sizeof(regionCrc));
+            return false;
+        }
+    }
+
+    // Continue with the station that was on screen
+    isFirstStation = meta.stationIndex == 0;
+    strlcpy(snapshotLabel, meta.label, sizeof(snapshotLabel));
+    snapshotStale = true;
+    drawStaleMarker();
+
+    Serial.printf("Boot snapshot restored in %lu ms\n", millis() - start);
+    return true;
+}
+
+void snapshotCapture(SnapshotRegion region, TFT_eSprite& sprite, int32_t x, int32_t y) {
+    if (sprite.getColorDepth() != 8) return;
+
+    // Flash writes are rate limited, the snapshot may lag the panel a few minutes
+    if (snapshotWritten && millis() - lastSnapshotWrite < SNAPSHOT_WRITE_INTERVAL) return;
+
+    const uint8_t* pixels = (const uint8_t*)sprite.getPointer();
+    if (!pixels) return;
+
+    size_t len = (size_t)sprite.width() * sprite.height();
+    uint32_t crc = crc32_le(0, pixels, len);
+    if (crc == regionCrc[region]) return;
+
+    if (writeRegion(region, pixels, sprite.width(), sprite.height(), x, y, crc)) {
+        regionCrc[region] = crc;
+        regionChanged = true;
+    }
+}
+
+void snapshotCommit() {
+    if (!regionChanged) return;
+
+    SnapshotMeta meta = {};
+    meta.magic = SNAPSHOT_MAGIC;
+    meta.stationIndex = isFirstStation ? 0 : 1;
+    strlcpy(meta.label, getTimeWithoutSeconds(), sizeof(meta.label));
+
+    File metaFile = SPIFFS.open(SNAPSHOT_META, FILE_WRITE);
+    if (metaFile) {
+        metaFile.write((const uint8_t*)&meta, sizeof(meta));
+        metaFile.close();
+    } else {
+        Serial.println("Snapshot: failed to write meta");
+    }
+
+    regionChanged = false;
+    snapshotWritten = true;
+    lastSnapshotWrite = millis();
+}
+
+void snapshotClear() {
+    SPIFFS.remove(SNAPSHOT_META);
+    for (int i = 0; i < SNAPSHOT_REGION_COUNT; i++) {
+        SPIFFS.remove(SNAPSHOT_FILES[i]);
+    }
+    memset(regionCrc, 0, sizeof(regionCrc));
+    Serial.println("Boot snapshot deleted");
+}
+
+void drawStaleMarker() {
+    tft.fillRect(0, tft.height() - 25, tft.width(), 25, TFT_WHITE);
+    tft.loadFont(AA_FONT_SMALL);
+    tft.setTextColor(TFT_BLACK, TFT_WHITE);
+    tft.setTextDatum(TL_DATUM);
+    tft.drawString("Cached " + String(snapshotLabel), 4, tft.height() - 20);
+    displayStatus(true); // orange while stale
+}
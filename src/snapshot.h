@@ -0,0 +1,24 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+
+// Screen regions of the board that are kept as boot snapshot
+enum SnapshotRegion {
+    SNAPSHOT_HEADER = 0,
+    SNAPSHOT_ROWS_TOP,
+    SNAPSHOT_ROWS_BOTTOM,
+    SNAPSHOT_REGION_COUNT
+};
+
+// True while the panel shows the restored snapshot instead of fresh data
+extern bool snapshotStale;
+
+bool snapshotRestore();
+void snapshotCapture(SnapshotRegion region, TFT_eSprite& sprite, int32_t x, int32_t y);
+void snapshotCommit();
+void snapshotClear();
+void drawStaleMarker();
+
+#endif // SNAPSHOT_H
@@ -1,126 +1,15 @@
 #include "stationboard.h"
 #include "globals.h"
 #include "utilities.h"
+#include "snapshot.h"
+#include "altboard.h"
+#include "timetable.h"
+#include "provider.h"
+#include "polling.h"
+#include "governor.h"
+#include "timesync.h"
+#include "heaptrack.h"
 // #include "NotoSansBold15.h"
-#include <HTTPClient.h>
-#include <JsonStreamingParser.h>
-
-TransportListener::TransportListener() : inStationboard(false), inStop(false) {}
-
-const std::vector<Transport>& TransportListener::getTransports() const {
-    return transports;
-}
-
-String TransportListener::getStation() const {
-    return station;
-}
-
-void TransportListener::whitespace(char c) {
-    // Ignore whitespace characters
-}
-
-void TransportListener::startDocument() {   
-    Serial.println("Start parsing");
-    transports.clear();
-    station = "";
-    inStationboard = false;
-    currentPath = "";
-    currentKey = "";
-    inStop = false;
-}
-
-void TransportListener::key(String key) {
-    currentKey = key;
-    
-    if (inStationboard) {
-        if (inStop) {
-            currentPath = "stationboard/stop/" + key;
-        } else {
-            currentPath = "stationboard/" + key;
-        }
-    }
-}
-
-void TransportListener::value(String value) {
-    String fullPath = currentPath + "/" + currentKey;
-
-    if (station.isEmpty()){
-        if (fullPath == "/station/name") {
-            station = value;
-            Serial.print("Found station: ");
-            Serial.println(value);
-        }
-    }
-
-    if (fullPath.endsWith("/stop/departure")) {
-        currentTransport.departure = extractTime(value);
-    }
-    else if (fullPath.endsWith("/stop/delay")) {
-        currentTransport.delay = value;
-    }
-    else if (fullPath.endsWith("/name")) {
-        currentTransport.name = value;
-    }
-    else if (fullPath.endsWith("/category")) {
-        currentTransport.category = value;
-    }
-    else if (fullPath.endsWith("/number")) {
-        if (value != "null") {
-            int numValue = value.toInt();
-            currentTransport.number = (numValue < 1000) ? String(numValue) : "";
-        }
-    }
-    else if (fullPath.endsWith("/to")) {
-        if (value.length() > 25) {
-            value = value.substring(0, 22) + "...";
-        }
-        currentTransport.destination = value;
-        transports.push_back(currentTransport);
-        resetTransport();
-    }
-}
-
-void TransportListener::endArray() {
-    int lastSlash = currentPath.lastIndexOf('/');
-    if (lastSlash >= 0) {
-        currentPath = currentPath.substring(0, lastSlash);
-    }
-}
-
-void TransportListener::startArray() {
-    if (currentKey.length() > 0) {
-        currentPath += "/" + currentKey;
-    }
-}
-
-void TransportListener::startObject() {
-    if (currentKey.length() > 0) {
-        currentPath += "/" + currentKey;
-    }
-}
-
-void TransportListener::endObject() {
-    int lastSlash = currentPath.lastIndexOf('/');
-    if (lastSlash >= 0) {
-        currentPath = currentPath.substring(0, lastSlash);
-    }
-}
-
-void TransportListener::endDocument() {
-    Serial.println("Ende JSON");
-    Serial.println("----------------------------");
-}
-
-void TransportListener::resetTransport() {
-    currentTransport = Transport();
-}
-
-String TransportListener::extractTime(const String& isoTime) {
-    if (isoTime.length() >= 16) {
-        return isoTime.substring(11, 16); // Extract HH:MM
-    }
-    return "";
-}
 
 void drawTransport(TFT_eSprite& sprite, const Transport& transport, int yPos) {
     const char* LONG_DISTANCE[] = {"IR", "IC", "EC", "ICE", "ICN", "TGV"};
@@ -128,30 +17,38 @@ void drawTransport(TFT_eSprite& sprite, const Transport& transport, int yPos) {
     const char* NIGHT[] = {"N", "SN"};
     if (transport.name == "null") return;
 
+    FixedString<16> label = transport.category;
+    label.append(transport.number);
+    FixedString<12> delayText;
+    if (transport.delay.toInt() > 0) delayText.appendf("+%s", transport.delay.c_str());
+
     // Format table row - content widths must match borders
-    String line = transport.category + transport.number;
+    FixedString<16> line = label;
     line.trim();
-    if (line.length() > 6) line = line.substring(0, 6);
-    while (line.length() < 6) line += " ";
+    line.truncate(6);
+    line.pad(6);
     
-    String dest = transport.destination;
-    if (dest.length() > 25) dest = dest.substring(0, 22) + "...";
-    while (dest.length() < 25) dest += " ";
+    FixedString<32> dest = transport.destination;
+    if (dest.length() > 25) {
+        dest.truncate(22);
+        dest.append("...");
+    }
+    dest.pad(25);
     
-    String timeStr = transport.departure;
-    while (timeStr.length() < 5) timeStr += " ";
+    FixedString<8> timeStr = transport.departure;
+    timeStr.pad(5);
     
-    String delayStr = transport.delay.toInt() > 0 ? "+" + transport.delay : " ";
-    while (delayStr.length() < 4) delayStr += " ";
+    FixedString<12> delayStr = delayText.isEmpty() ? " " : delayText.c_str();
+    delayStr.pad(4);
     
-    Serial.println("| " + line + " | " + dest + " | " + timeStr + " |" + delayStr + " |");
+    Serial.printf("| %s | %s | %s |%s |\n", line.c_str(), dest.c_str(), timeStr.c_str(), delayStr.c_str());
 
     sprite.setTextColor(TFT_WHITE, TFT_BLUE);
-    sprite.drawString(transport.departure, POS_TIME, yPos + 1);
+    sprite.drawString(transport.departure.c_str(), POS_TIME, yPos + 1);
     
-    if (transport.delay.toInt() > 0) {
+    if (!delayText.isEmpty()) {
         sprite.setTextColor(TFT_YELLOW, TFT_BLUE);
-        sprite.drawString("+" + transport.delay, POS_DELAY, yPos + 1);
+        sprite.drawString(delayText.c_str(), POS_DELAY, yPos + 1);
     }
     
     bool isLongDistance = std::any_of(std::begin(LONG_DISTANCE), std::end(LONG_DISTANCE),
@@ -174,16 +71,18 @@ void drawTransport(TFT_eSprite& sprite, const Transport& transport, int yPos) {
         sprite.setTextColor(TFT_WHITE, TFT_BLUE);
     }
 
-    sprite.drawString(transport.category + transport.number, POS_BUS, yPos + 1);
+    sprite.drawString(label.c_str(), POS_BUS, yPos + 1);
     sprite.setTextColor(TFT_WHITE, TFT_BLUE);
-    sprite.drawString(transport.destination, POS_TO, yPos + 1);
+    sprite.drawString(transport.destination.c_str(), POS_TO, yPos + 1);
 }
 
 void displayTransports(const std::vector<Transport>& transports) {
-    // Filter out null transports
-    std::vector<Transport> validTransports;
-    std::copy_if(transports.begin(), transports.end(), std::back_inserter(validTransports),
-        [](const Transport& t) { return t.name != "null"; });
+    // Filter out null transports, the list keeps its capacity between refreshes
+    static std::vector<const Transport*> validTransports;
+    validTransports.clear();
+    for (const Transport& t : transports) {
+        if (t.name != "null") validTransports.push_back(&t);
+    }
 
     // Print table header
     Serial.println("+--------+---------------------------+-------+------+");
@@ -192,22 +91,27 @@ void displayTransports(const std::vector<Transport>& transports) {
 
     TFT_eSprite sprite(&tft);
     sprite.setColorDepth(8);
+    heapTag(HEAP_TAG_SPRITE);
     sprite.createSprite(tft.width(), 5 * POS_INC);
+    heapTag(HEAP_TAG_FONT);
     sprite.loadFont(AA_FONT_SMALL);
+    heapTag(HEAP_TAG_NONE);
 
     // Draw first half (0-4)
     sprite.fillSprite(TFT_BLUE);
     for (size_t i = 0; i < std::min(size_t(5), validTransports.size()); i++) {
-        drawTransport(sprite, validTransports[i], i * POS_INC);
+        drawTransport(sprite, *validTransports[i], i * POS_INC);
     }
     sprite.pushSprite(0, POS_FIRST);
+    snapshotCapture(SNAPSHOT_ROWS_TOP, sprite, 0, POS_FIRST);
 
     // Draw second half (5-9)
     sprite.fillSprite(TFT_BLUE);
     for (size_t i = 5; i < validTransports.size(); i++) {
-        drawTransport(sprite, validTransports[i], (i-5) * POS_INC);
+        drawTransport(sprite, *validTransports[i], (i-5) * POS_INC);
     }
     sprite.pushSprite(0, POS_FIRST + (5 * POS_INC));
+    snapshotCapture(SNAPSHOT_ROWS_BOTTOM, sprite, 0, POS_FIRST + (5 * POS_INC));
 
     // Print table footer
     Serial.println("+--------+---------------------------+-------+------+");
@@ -215,51 +119,97 @@ void displayTransports(const std::vector<Transport>& transports) {
 }
 
 void drawStation(const String& station) {
-    tft.loadFont(AA_FONT_SMALL);
-    tft.setTextColor(TFT_BLACK, TFT_WHITE);
-    tft.fillRect(0, 0, tft.width(), 25, TFT_WHITE);
-    tft.drawString(station, POS_BUS, 7);
-}
-
-void drawStationboard() {
-    static TransportListener listener;
-    static String lastStationId;
-    HTTPClient http;
-    http.setConnectTimeout(HTTP_TIMEOUT);
-    
-    String currentStationId = isFirstStation ? config.stationId : config.stationId2;
-    
-    String url = "http://transport.opendata.ch/v1/stationboard?id=" + 
-                    URLEncode(currentStationId) + "&limit=" + URLEncode(String(config.limit)) +"&datetime=" + URLEncode(getFormattedTimeRelativeToNow(config.offset));
-
-    Serial.println("Relative Time: " + getFormattedTimeRelativeToNow(config.offset));
-    Serial.print("URL: ");
-    Serial.println(url);
-    http.begin(url);
-    
-    if (http.GET() == HTTP_CODE_OK) {
-        String response = http.getString();
-        // Handle Unicode characters
-        response.replace("\\u00fc", "ü");  // ü
-        response.replace("\\u00f6", "ö");  // ö
-        response.replace("\\u00e4", "ä");  // ä
-        response.replace("\\u00dc", "Ü");  // Ü
-        response.replace("\\u00d6", "Ö");  // Ö
-        response.replace("\\u00c4", "Ä");  // Ä
-        response.replace("\\u00e9", "é");  // é
-        response.replace("\\u00e0", "à");  // à
-        response.replace("\\u00e8", "è");  // è
-        
-        JsonStreamingParser parser;
-        parser.setListener(&listener);
-        for (char c : response) {
-            parser.parse(c);
-        }
-        parser.reset(); // Ensure parser is empty
-        drawStation(listener.getStation());
-        displayTransports(listener.getTransports());
-
-    }
-    http.end();
-
+    // Rendered through a sprite so the header can be kept in the boot snapshot
+    TFT_eSprite stationSprite(&tft);
+    stationSprite.setColorDepth(8);
+    heapTag(HEAP_TAG_SPRITE);
+    stationSprite.createSprite(tft.width(), 25);
+    heapTag(HEAP_TAG_FONT);
+    stationSprite.loadFont(AA_FONT_SMALL);
+    heapTag(HEAP_TAG_NONE);
+
+    stationSprite.fillSprite(TFT_WHITE);
+    stationSprite.setTextColor(TFT_BLACK, TFT_WHITE);
+    stationSprite.drawString(station, POS_BUS, 7);
+
+    stationSprite.pushSprite(0, 0);
+    snapshotCapture(SNAPSHOT_HEADER, stationSprite, 0, 0);
+}
+
+// Last fetched board per station, used to prerender the inactive one
+struct StationCache {
+    String station;
+    std::vector<Transport> transports;
+    unsigned long fetchedAt = 0;
+    bool valid = false;
+};
+
+static StationCache stationCache[2];
+
+// Planned departures from the timetable store with live delays, or a full fetch.
+// Providers that cannot page by time always fetch.
+static bool loadStationboard(uint8_t index, const String& stationId) {
+    StationCache& cache = stationCache[index];
+    bool success = activeProvider().pagesByTime() &&
+                   timetableBoard(index, stationId, cache.station, cache.transports);
+    if (!success) {
+        // Before the first sync (boot) the server's own clock is used
+        DateTimeText datetime;
+        if (timeIsSynced()) datetime = getFormattedTimeRelativeToNow(config.offset);
+        success = fetchDepartures(stationId, config.limit, datetime.c_str(),
+                                  cache.station, cache.transports);
+    }
+    if (success) {
+        cache.fetchedAt = millis();
+        cache.valid = true;
+    }
+    return success;
+}
+
+bool drawStationboard() {
+    uint8_t index = isFirstStation ? 0 : 1;
+    const String& currentStationId = isFirstStation ? config.stationId : config.stationId2;
+
+    if (!loadStationboard(index, currentStationId)) return false;
+
+    pollingObserve(index, stationCache[index].transports);
+    governorPhase(GOV_RENDER);
+    drawStation(stationCache[index].station);
+    displayTransports(stationCache[index].transports);
+
+    // Fresh data replaces the restored boot snapshot
+    snapshotStale = false;
+    snapshotCommit();
+    return true;
+}
+
+void prerenderInactiveStation() {
+    uint8_t index = isFirstStation ? 1 : 0;
+    const String& stationId = isFirstStation ? config.stationId2 : config.stationId;
+    if (stationId.isEmpty()) return;
+
+    // Fetch the inactive station at a lower cadence, in between reuse the cached rows
+    StationCache& cache = stationCache[index];
+    if (!cache.valid || millis() - cache.fetchedAt >= INACTIVE_STATION_INTERVAL) {
+        if (!loadStationboard(index, stationId)) return;
+    }
+    governorPhase(GOV_RENDER);
+    altBoardUpdate(index, cache.station, cache.transports);
+}
+
+bool stationCacheGet(uint8_t index, String& station, std::vector<Transport>& transports) {
+    if (index > 1 || !stationCache[index].valid) return false;
+    station = stationCache[index].station;
+    transports = stationCache[index].transports;
+    return true;
+}
+
+// Board kept across deep sleep, usable right away but fetched again on the next chance
+void stationCacheRestore(uint8_t index, const String& station, const std::vector<Transport>& transports) {
+    if (index > 1) return;
+    StationCache& cache = stationCache[index];
+    cache.station = station;
+    cache.transports = transports;
+    cache.fetchedAt = millis() - INACTIVE_STATION_INTERVAL;
+    cache.valid = true;
 }
@@ -3,50 +3,26 @@
 
 #include <Arduino.h>
 #include <vector>
-#include <JsonListener.h>
 #include <TFT_eSPI.h>
+#include "fixedstring.h"
 
+// Inline fields, copying a row or a board does not touch the heap
 struct Transport {
-    String name;
-    String number;
-    String operatorName;
-    String destination;
-    String departure;
-    String delay;
-    String category;
-};
-
-class TransportListener: public JsonListener {
-public:
-    TransportListener();
-    const std::vector<Transport>& getTransports() const;
-    String getStation() const;
-    virtual void whitespace(char c);
-    void startDocument();
-    void key(String key);
-    void value(String value);
-    void endArray();
-    void startArray();
-    void startObject();
-    void endObject();
-    void endDocument();
-
-private:
-    String currentKey;
-    String currentPath;
-    String station;
-    bool inStationboard;
-    bool inStop;
-    std::vector<Transport> transports;
-    Transport currentTransport;
-
-    void resetTransport();
-    String extractTime(const String& isoTime);
+    FixedString<24> name;
+    FixedString<8> number;
+    FixedString<24> operatorName;
+    FixedString<32> destination;   // cut to 25 characters by the provider
+    FixedString<8> departure;      // HH:MM
+    FixedString<8> delay;
+    FixedString<8> category;
 };
 
 void drawTransport(TFT_eSprite& sprite, const Transport& transport, int yPos);
 void displayTransports(const std::vector<Transport>& transports);
 void drawStation(const String& station);
-void drawStationboard();
+bool drawStationboard();
+void prerenderInactiveStation();
+bool stationCacheGet(uint8_t index, String& station, std::vector<Transport>& transports);
+void stationCacheRestore(uint8_t index, const String& station, const std::vector<Transport>& transports);
 
 #endif // STATIONBOARD_H
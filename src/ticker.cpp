@@ -0,0 +1,165 @@
+#include "ticker.h"
+#include "globals.h"
+#include "governor.h"
+#include "radiopower.h"
+#include "tlssession.h"
+#include "heaptrack.h"
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+
+#define TICKER_MAX_SOURCES 4
+#define TICKER_TEXT_SIZE 24
+static const unsigned long TICKER_RETRY = 60000;         // after a failed fetch
+static const unsigned long TICKER_STALE_FAILURES = 3;    // failed fetches in a row before the value is stale
+static const unsigned long TICKER_MAX_AGE = 1800000;     // 30 minutes, or two intervals if longer
+static const unsigned long BTC_TICKER_INTERVAL = 300000; // 5 minutes
+
+struct TickerSlot {
+    TickerSource* source;
+    char text[TICKER_TEXT_SIZE];   // last good value, "N/A" until the first one
+    unsigned long fetchedAt;
+    unsigned long goodAt;          // when text was fetched
+    unsigned long fetches;
+    unsigned long errors;
+    unsigned long failures;        // in a row since the last good value
+    bool attempted;
+    bool failed;
+    bool valid;
+};
+
+static TickerSlot slots[TICKER_MAX_SOURCES];
+static uint8_t slotCount = 0;
+static uint8_t shownSlot = 0;
+static char shownText[TICKER_TEXT_SIZE] = "";
+static bool shownStale = false;
+
+// Coinbase spot price, only data.amount is kept from the response
+class BtcTicker : public TickerSource {
+public:
+    const char* name() const override { return "BTC"; }
+    unsigned long interval() const override { return BTC_TICKER_INTERVAL; }
+
+    bool fetch(char* text, size_t size) override {
+        TlsSessionClient client; // resumes the last session with the host
+        HTTPClient http;
+        http.setConnectTimeout(HTTP_TIMEOUT);
+        http.setTimeout(HTTP_TIMEOUT);
+        http.useHTTP10(true); // no chunked encoding, the stream can be parsed directly
+        http.begin(client, getBTCAPI);
+
+        unsigned long requestStart = millis();
+        int httpCode = http.GET();
+        radioRecordLatency(millis() - requestStart);
+        Serial.print("HTTPCODE: ");
+        Serial.println(httpCode);
+
+        bool success = false;
+        if (httpCode == HTTP_CODE_OK) {
+            StaticJsonDocument<32> filter;
+            filter["data"]["amount"] = true;
+            StaticJsonDocument<96> doc;
+            governorPhase(GOV_PARSE);
+            DeserializationError error = deserializeJson(doc, http.getStream(), DeserializationOption::Filter(filter));
+            if (!error && doc["data"]["amount"].is<const char*>()) {
+                snprintf(text, size, "BTC $%ld", atol(doc["data"]["amount"].as<const char*>()));
+                success = true;
+            }
+        }
+        http.end();
+        return success;
+    }
+};
+
+static BtcTicker btcTicker;
+
+void tickerRegister(TickerSource* source) {
+    if (slotCount >= TICKER_MAX_SOURCES) return;
+    TickerSlot& slot = slots[slotCount++];
+    slot.source = source;
+    strlcpy(slot.text, "N/A", sizeof(slot.text));
+    slot.fetchedAt = 0;
+    slot.goodAt = 0;
+    slot.fetches = 0;
+    slot.errors = 0;
+    slot.failures = 0;
+    slot.attempted = false;
+    slot.failed = false;
+    slot.valid = false;
+}
+
+static bool due(const TickerSlot& slot) {
+    if (!slot.attempted) return true;
+    unsigned long wait = slot.failed ? std::min(TICKER_RETRY, slot.source->interval()) : slot.source->interval();
+    return millis() - slot.fetchedAt >= wait;
+}
+
+// A value survives single failed fetches, it is only marked once it can no longer be trusted
+static bool stale(const TickerSlot& slot) {
+    if (!slot.valid) return false;
+    unsigned long maxAge = std::max(TICKER_MAX_AGE, 2 * slot.source->interval());
+    return slot.failures >= TICKER_STALE_FAILURES || millis() - slot.goodAt >= maxAge;
+}
+
+static void drawTicker(const char* text, bool stale) {
+    // Create temporary sprite for the ticker display
+    TFT_eSprite tickerSprite(&tft);
+    tickerSprite.setColorDepth(8);
+    heapTag(HEAP_TAG_SPRITE);
+    tickerSprite.createSprite((tft.width() / 2) - 25, 25);
+    heapTag(HEAP_TAG_FONT);
+    tickerSprite.loadFont(AA_FONT_SMALL);
+    heapTag(HEAP_TAG_NONE);
+    tickerSprite.fillSprite(TFT_WHITE);
+    tickerSprite.setTextDatum(TR_DATUM);
+    tickerSprite.setTextColor(stale ? TFT_DARKGREY : TFT_BLACK, TFT_WHITE);
+    tickerSprite.drawString(text, tickerSprite.width(), 5);
+
+    // Push to bottom-right of screen, left of the status dot
+    tickerSprite.pushSprite(tft.width() / 2, tft.height() - 25);
+}
+
+void tickerService(bool redraw) {
+    if (slotCount == 0) tickerRegister(&btcTicker);
+
+    for (uint8_t i = 0; i < slotCount; i++) {
+        TickerSlot& slot = slots[i];
+        if (!due(slot)) continue;
+
+        governorPhase(GOV_NETWORK);
+        char text[TICKER_TEXT_SIZE];
+        slot.attempted = true;
+        slot.fetchedAt = millis();
+        slot.fetches++;
+        slot.failed = !slot.source->fetch(text, sizeof(text));
+        if (slot.failed) {
+            slot.errors++;
+            slot.failures++;
+            Serial.printf("Ticker %s: fetch failed, keeping %s%s\n", slot.source->name(), slot.text,
+                          stale(slot) ? " (stale)" : "");
+        } else {
+            strlcpy(slot.text, text, sizeof(slot.text));
+            slot.goodAt = millis();
+            slot.failures = 0;
+            slot.valid = true;
+            Serial.printf("Ticker %s: %s\n", slot.source->name(), slot.text);
+        }
+    }
+
+    // Sources take turns in the single footer slot
+    if (slotCount > 1) shownSlot = (shownSlot + 1) % slotCount;
+    const char* text = slots[shownSlot].text;
+    bool isStale = stale(slots[shownSlot]);
+    if (redraw || strcmp(text, shownText) != 0 || isStale != shownStale) {
+        governorPhase(GOV_RENDER);
+        drawTicker(text, isStale);
+        strlcpy(shownText, text, sizeof(shownText));
+        shownStale = isStale;
+    }
+}
+
+void tickerReport() {
+    for (uint8_t i = 0; i < slotCount; i++) {
+        Serial.printf("Ticker %s: %lu fetches, %lu errors, every %lu s\n", slots[i].source->name(),
+                      slots[i].fetches, slots[i].errors, slots[i].source->interval() / 1000);
+    }
+}
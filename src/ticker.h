@@ -0,0 +1,22 @@
+#ifndef TICKER_H
+#define TICKER_H
+
+#include <Arduino.h>
+
+// Footer ticker: every source fetches at its own cadence, values are cached
+// and the footer slot is only redrawn when the shown text changes. A failed
+// fetch keeps the last value, greyed out after repeated failures or when old.
+// Several sources take turns, one per refresh cycle.
+class TickerSource {
+public:
+    virtual ~TickerSource() {}
+    virtual const char* name() const = 0;
+    virtual unsigned long interval() const = 0;        // ms between fetches
+    virtual bool fetch(char* text, size_t size) = 0;   // footer text, false on error
+};
+
+void tickerRegister(TickerSource* source);
+void tickerService(bool redraw = false);
+void tickerReport();
+
+#endif // TICKER_H
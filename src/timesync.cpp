@@ -0,0 +1,121 @@
+#include "timesync.h"
+#include <esp_sntp.h>
+#include <sys/time.h>
+
+// SNTP runs in the lwIP task and hands every result to sntp_sync_time() below.
+// Instead of stepping the clock each time, the offset is used to estimate the
+// crystal/RTC rate error, which timeSyncService() then slews in between syncs.
+// With the drift known the resync interval grows to many hours.
+
+static const char* NTP_SERVER = "pool.ntp.org";
+static const uint32_t SYNC_INTERVAL_MIN = 3600000;       // 1 hour until the drift is known
+static const uint32_t SYNC_INTERVAL_MAX = 43200000;      // 12 hours once offsets stay small
+static const int64_t STEP_THRESHOLD_US = 500000;         // larger offsets are stepped, smaller ones slewed
+static const int64_t STABLE_OFFSET_US = 50000;           // offset that allows a longer interval
+static const int64_t CORRECTION_INTERVAL_US = 60000000;  // drift compensation once a minute
+static const float DRIFT_GAIN = 0.5f;
+static const float MAX_DRIFT_PPM = 500.0f;
+
+unsigned long timeSyncCount = 0;
+
+static float driftPpm = 0.0f;        // positive: local clock runs slow
+static int64_t lastSyncUs = 0;       // esp_timer time of the last sync, keeps counting in light sleep
+static int64_t lastCorrectionUs = 0;
+static int32_t lastOffsetMs = 0;
+static uint32_t syncInterval = SYNC_INTERVAL_MIN;
+static bool driftBaseline = false;   // lastSyncUs is comparable with the next sync
+
+static void slewClock(int64_t deltaUs) {
+    struct timeval delta;
+    delta.tv_sec = deltaUs / 1000000;
+    delta.tv_usec = deltaUs % 1000000;
+    adjtime(&delta, nullptr);
+}
+
+// Replaces the weak default in ESP-IDF, called from the lwIP task
+extern "C" void sntp_sync_time(struct timeval* tv) {
+    struct timeval local;
+    gettimeofday(&local, nullptr);
+    int64_t offsetUs = (int64_t)(tv->tv_sec - local.tv_sec) * 1000000LL + (tv->tv_usec - local.tv_usec);
+    int64_t nowUs = esp_timer_get_time();
+
+    if (timeSyncCount > 0 && llabs(offsetUs) < STEP_THRESHOLD_US) {
+        // What is left after the applied compensation is the error of the drift estimate
+        int64_t elapsedUs = nowUs - lastSyncUs;
+        if (driftBaseline && elapsedUs > 0) {
+            float residualPpm = (float)offsetUs * 1e6f / (float)elapsedUs;
+            driftPpm = constrain(driftPpm + residualPpm * DRIFT_GAIN, -MAX_DRIFT_PPM, MAX_DRIFT_PPM);
+        }
+        slewClock(offsetUs);
+    } else {
+        settimeofday(tv, nullptr);
+    }
+
+    // Stretch the interval while the clock holds, fall back to hourly otherwise
+    if (timeSyncCount > 0 && llabs(offsetUs) < STABLE_OFFSET_US) {
+        syncInterval = std::min(syncInterval * 2, SYNC_INTERVAL_MAX);
+    } else {
+        syncInterval = SYNC_INTERVAL_MIN;
+    }
+    sntp_set_sync_interval(syncInterval);
+
+    lastSyncUs = nowUs;
+    lastCorrectionUs = nowUs;
+    lastOffsetMs = offsetUs / 1000;
+    driftBaseline = true;
+    timeSyncCount++;
+    sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+}
+
+void timeSyncBegin() {
+    if (sntp_enabled()) return;
+
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, NTP_SERVER);
+    sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
+    sntp_set_sync_interval(syncInterval);
+    sntp_init();
+    Serial.println("SNTP started");
+}
+
+void timeSyncService() {
+    if (timeSyncCount == 0 || driftPpm == 0.0f) return;
+
+    int64_t nowUs = esp_timer_get_time();
+    int64_t elapsedUs = nowUs - lastCorrectionUs;
+    if (elapsedUs < CORRECTION_INTERVAL_US) return;
+
+    lastCorrectionUs = nowUs;
+    slewClock((int64_t)(driftPpm * (float)elapsedUs / 1e6f));
+}
+
+time_t timeNow() {
+    return time(nullptr);
+}
+
+bool timeIsSynced() {
+    return timeSyncCount > 0;
+}
+
+void timeSyncReport() {
+    Serial.printf("Time syncs: %lu, last offset %ld ms, drift %.1f ppm, interval %lu min\n",
+                  timeSyncCount, (long)lastOffsetMs, driftPpm, (unsigned long)(syncInterval / 60000));
+}
+
+void timeSyncSave(TimeSyncState& state) {
+    state.driftPpm = driftPpm;
+    state.syncInterval = syncInterval;
+    state.lastOffsetMs = lastOffsetMs;
+    state.syncCount = timeSyncCount;
+}
+
+// The RTC kept the time through deep sleep, but esp_timer restarted at zero,
+// so the first sync after the wake only corrects the offset
+void timeSyncRestore(const TimeSyncState& state) {
+    driftPpm = state.driftPpm;
+    syncInterval = state.syncInterval;
+    lastOffsetMs = state.lastOffsetMs;
+    timeSyncCount = state.syncCount;
+    lastCorrectionUs = esp_timer_get_time();
+    driftBaseline = false;
+}
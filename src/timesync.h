@@ -0,0 +1,25 @@
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include <Arduino.h>
+
+// System clock disciplined by background SNTP, reads never touch the network
+extern unsigned long timeSyncCount;
+
+// Clock discipline that survives deep sleep in RTC memory
+struct TimeSyncState {
+    float driftPpm;
+    uint32_t syncInterval;
+    int32_t lastOffsetMs;
+    uint32_t syncCount;
+};
+
+void timeSyncBegin();
+void timeSyncService();
+time_t timeNow();
+bool timeIsSynced();
+void timeSyncReport();
+void timeSyncSave(TimeSyncState& state);
+void timeSyncRestore(const TimeSyncState& state);
+
+#endif // TIMESYNC_H
@@ -0,0 +1,559 @@
+#include "timetable.h"
+#include "globals.h"
+#include "utilities.h"
+#include "provider.h"
+#include "scheduler.h"
+#include <SPIFFS.h>
+
+// One file per station, little endian:
+//   TimetableHeader | station id | station name | dictionary | entries
+// Dictionary strings are length prefixed, category and destination refer to them by index.
+// Entry: varint minutes since the previous entry, category index, destination index,
+//        int16 line number (-1 = none), length prefixed journey name.
+// The header keeps the offset of the first entry of every hour, so a lookup
+// only decodes from the hour it starts in.
+
+#define TIMETABLE_PAGE_SIZE 12       // departures per bulk request
+#define TIMETABLE_MAX_PAGES 120
+#define TIMETABLE_PAGES_PER_SLICE 2  // pages per download slice, the loop runs in between
+#define TIMETABLE_REALTIME_COUNT 4   // departures polled for live delays
+#define TIMETABLE_REALTIME_WINDOW 30 // minutes ahead in which live delays are polled
+#define TIMETABLE_DOWNLOAD_HOUR 2    // nightly download once this local hour is reached
+#define TIMETABLE_NO_DICT 255
+
+static const uint32_t TIMETABLE_MAGIC = 0x4C425454; // "TTBL"
+static const uint16_t TIMETABLE_VERSION = 1;
+static const size_t TIMETABLE_MAX_BYTES = 24000;
+static const unsigned long TIMETABLE_RETRY_INTERVAL = 1800000; // 30 minutes after a failed download
+static const unsigned long TIMETABLE_SLICE_INTERVAL = 5000;
+static const char* TIMETABLE_FILES[2] = {"/tt0.bin", "/tt1.bin"};
+
+struct TimetableIndex {
+    uint32_t offset;      // into the entries block
+    uint16_t prevMinute;  // minute of the entry before, base for the first delta
+    uint16_t reserved;
+};
+
+struct TimetableHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t dayKey;      // local date as yyyymmdd
+    uint32_t entriesLength;
+    uint8_t dictCount;
+    uint8_t stationIdLength;
+    uint8_t stationLength;
+    uint8_t reserved;
+    TimetableIndex index[24];
+};
+
+// Station id as stored, the length field allows up to 255 characters
+typedef FixedString<256> StoredId;
+
+unsigned long timetableHits = 0;
+unsigned long timetableMisses = 0;
+unsigned long timetableLiveSkips = 0;
+
+static uint32_t storedDayKey[2] = {0, 0};
+static uint16_t storedCount[2] = {0, 0};
+static bool headerLoaded[2] = {false, false};
+static bool downloadAttempted[2] = {false, false};
+static unsigned long lastDownloadAttempt[2] = {0, 0};
+
+// Fixed-width fields, atoi stops at the separator
+static uint32_t localDayKey(const char* dateTime) {
+    // "YYYY-MM-DD HH:MM"
+    if (strlen(dateTime) < 16) return 0;
+    return atoi(dateTime) * 10000 + atoi(dateTime + 5) * 100 + atoi(dateTime + 8);
+}
+
+static int minuteOfDay(const char* time) {
+    // "HH:MM"
+    if (strlen(time) < 5) return -1;
+    return atoi(time) * 60 + atoi(time + 3);
+}
+
+static FixedString<6> formatMinute(int minute) {
+    FixedString<6> text;
+    text.format("%02d:%02d", minute / 60, minute % 60);
+    return text;
+}
+
+struct TimetableBuilder {
+    std::vector<String> dict;
+    std::vector<uint8_t> entries;
+    TimetableIndex index[24] = {};
+    uint16_t count = 0;
+    int prevMinute = 0;
+    int nextHour = 0;
+
+    uint8_t dictIndex(const char* value) {
+        for (size_t i = 0; i < dict.size(); i++) {
+            if (dict[i] == value) return i;
+        }
+        if (dict.size() >= TIMETABLE_NO_DICT || strlen(value) > 255) return TIMETABLE_NO_DICT;
+        dict.push_back(value);
+        return dict.size() - 1;
+    }
+
+    void putVarint(uint32_t value) {
+        while (value >= 0x80) {
+            entries.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        entries.push_back(value);
+    }
+
+    void markHours(int upToHour) {
+        while (nextHour <= upToHour && nextHour < 24) {
+            index[nextHour].offset = entries.size();
+            index[nextHour].prevMinute = prevMinute;
+            nextHour++;
+        }
+    }
+
+    void add(const Transport& transport, int minute) {
+        // Slightly out of order rows are pinned to the previous minute
+        if (minute < prevMinute) minute = prevMinute;
+        markHours(minute / 60);
+
+        putVarint(minute - prevMinute);
+        prevMinute = minute;
+
+        entries.push_back(dictIndex(transport.category.c_str()));
+        entries.push_back(dictIndex(transport.destination.c_str()));
+        int16_t number = transport.number.isEmpty() ? -1 : transport.number.toInt();
+        entries.push_back(number & 0xFF);
+        entries.push_back((number >> 8) & 0xFF);
+
+        uint8_t nameLength = std::min<size_t>(transport.name.length(), 31);
+        entries.push_back(nameLength);
+        entries.insert(entries.end(), transport.name.c_str(), transport.name.c_str() + nameLength);
+        count++;
+    }
+};
+
+// Buffered sequential reader over the entries block
+struct TimetableReader {
+    File& file;
+    uint8_t buffer[128];
+    size_t length = 0;
+    size_t position = 0;
+    uint32_t remaining;
+
+    TimetableReader(File& f, uint32_t bytes) : file(f), remaining(bytes) {}
+
+    bool next(uint8_t& b) {
+        if (position >= length) {
+            if (remaining == 0) return false;
+            length = file.read(buffer, std::min<uint32_t>(sizeof(buffer), remaining));
+            remaining -= length;
+            position = 0;
+            if (length == 0) return false;
+        }
+        b = buffer[position++];
+        return true;
+    }
+
+    bool varint(uint32_t& value) {
+        value = 0;
+        uint8_t b;
+        for (int shift = 0; shift < 32; shift += 7) {
+            if (!next(b)) return false;
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool string(T& value, uint8_t len) {
+        char text[256];
+        for (int i = 0; i < len; i++) {
+            uint8_t b;
+            if (!next(b)) return false;
+            text[i] = b;
+        }
+        text[len] = '\0';
+        value = text;
+        return true;
+    }
+};
+
+template <typename T>
+static bool readString(File& file, T& value, uint8_t len) {
+    char text[256];
+    if (file.read((uint8_t*)text, len) != len) return false;
+    text[len] = '\0';
+    value = text;
+    return true;
+}
+
+static bool openTimetable(uint8_t index, File& file, TimetableHeader& header, StoredId& stationId) {
+    file = SPIFFS.open(TIMETABLE_FILES[index], FILE_READ);
+    if (!file) return false;
+
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != TIMETABLE_MAGIC || header.version != TIMETABLE_VERSION ||
+        !readString(file, stationId, header.stationIdLength)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+static void loadHeader(uint8_t index, const String& stationId) {
+    if (headerLoaded[index]) return;
+    headerLoaded[index] = true;
+    storedDayKey[index] = 0;
+    storedCount[index] = 0;
+
+    File file;
+    TimetableHeader header;
+    StoredId storedId;
+    if (!openTimetable(index, file, header, storedId)) return;
+    file.close();
+
+    // A store for another station id is as good as none
+    if (storedId == stationId.c_str()) {
+        storedDayKey[index] = header.dayKey;
+        storedCount[index] = header.count;
+    }
+}
+
+static bool writeTimetable(uint8_t index, const String& stationId, const String& station,
+                           uint32_t dayKey, TimetableBuilder& builder) {
+    builder.markHours(23);
+
+    TimetableHeader header = {};
+    header.magic = TIMETABLE_MAGIC;
+    header.version = TIMETABLE_VERSION;
+    header.count = builder.count;
+    header.dayKey = dayKey;
+    header.entriesLength = builder.entries.size();
+    header.dictCount = builder.dict.size();
+    header.stationIdLength = std::min<size_t>(stationId.length(), 255);
+    header.stationLength = std::min<size_t>(station.length(), 255);
+    memcpy(header.index, builder.index, sizeof(header.index));
+
+    String tmpPath = String(TIMETABLE_FILES[index]) + ".tmp";
+    File file = SPIFFS.open(tmpPath, FILE_WRITE);
+    if (!file) {
+        Serial.println("Timetable: failed to open file for writing");
+        return false;
+    }
+
+    file.write((const uint8_t*)&header, sizeof(header));
+    file.write((const uint8_t*)stationId.c_str(), header.stationIdLength);
+    file.write((const uint8_t*)station.c_str(), header.stationLength);
+    for (const String& entry : builder.dict) {
+        uint8_t len = entry.length();
+        file.write(&len, 1);
+        file.write((const uint8_t*)entry.c_str(), len);
+    }
+    file.write(builder.entries.data(), builder.entries.size());
+    size_t size = file.size();
+    file.close();
+
+    SPIFFS.remove(TIMETABLE_FILES[index]);
+    if (!SPIFFS.rename(tmpPath.c_str(), TIMETABLE_FILES[index])) {
+        Serial.println("Timetable: failed to rename file");
+        return false;
+    }
+
+    storedDayKey[index] = dayKey;
+    storedCount[index] = builder.count;
+    headerLoaded[index] = true;
+    Serial.printf("Timetable %d stored: %d departures, %d dictionary entries, %u bytes\n",
+                  index + 1, builder.count, builder.dict.size(), size);
+    return true;
+}
+
+// Download in progress, advanced a few pages per slice
+struct TimetableDownload {
+    bool active = false;
+    uint8_t index = 0;
+    String stationId;
+    String station;
+    FixedString<11> date;
+    uint32_t dayKey = 0;
+    TimetableBuilder builder;
+    std::vector<Transport> page;
+    std::vector<FixedString<24>> namesAtLastMinute;
+    int lastMinute = 0;
+    int pages = 0;
+    unsigned long start = 0;
+    unsigned long bytes = 0;
+};
+
+static TimetableDownload download;
+
+static void startDownload(uint8_t index, const String& stationId) {
+    DateTimeText now = getFormattedTimeRelativeToNow(0);
+    int startMinute = minuteOfDay(now.c_str() + 11);
+
+    download = TimetableDownload();
+    download.active = true;
+    download.index = index;
+    download.stationId = stationId;
+    download.date = now.substring(0, 10);
+    download.dayKey = localDayKey(now.c_str());
+    download.lastMinute = startMinute;
+    download.start = millis();
+    download.builder.prevMinute = startMinute;
+    download.builder.markHours(startMinute / 60 - 1);
+    Serial.printf("Timetable %d: downloading %s from %s\n", index + 1, download.date.c_str(), now.c_str() + 11);
+}
+
+static void endDownload() {
+    download = TimetableDownload(); // releases the builder buffers
+    schedulerCancel(TASK_TIMETABLE);
+}
+
+// Fetches one page, false once the day is complete or the request failed
+static bool downloadPage(bool& failed) {
+    DateTimeText from;
+    from.format("%s %s", download.date.c_str(), formatMinute(download.lastMinute).c_str());
+    unsigned long bytesBefore = stationboardBytes;
+    if (!fetchDepartures(download.stationId, TIMETABLE_PAGE_SIZE, from.c_str(), download.station, download.page)) {
+        failed = true;
+        return false;
+    }
+    download.pages++;
+    download.bytes += stationboardBytes - bytesBefore;
+
+    TimetableBuilder& builder = download.builder;
+    int& lastMinute = download.lastMinute;
+    bool complete = false;
+    int added = 0;
+    for (const Transport& transport : download.page) {
+        if (transport.name == "null") continue;
+        int minute = minuteOfDay(transport.departure.c_str());
+        if (minute < 0) continue;
+
+        // Far earlier than the last row means the page rolled over to the next day
+        if (minute + 120 < lastMinute) {
+            complete = true;
+            break;
+        }
+
+        // Pages overlap on the minute they start at
+        if (minute == lastMinute &&
+            std::find(download.namesAtLastMinute.begin(), download.namesAtLastMinute.end(), transport.name) !=
+                download.namesAtLastMinute.end()) {
+            continue;
+        }
+        if (minute != lastMinute) {
+            download.namesAtLastMinute.clear();
+            lastMinute = std::max(minute, lastMinute);
+        }
+        download.namesAtLastMinute.push_back(transport.name);
+
+        builder.add(transport, minute);
+        added++;
+
+        if (builder.entries.size() >= TIMETABLE_MAX_BYTES) {
+            Serial.println("Timetable: store full, day truncated");
+            complete = true;
+            break;
+        }
+    }
+
+    if (download.page.size() < TIMETABLE_PAGE_SIZE) complete = true;
+    // A full page within one minute would be requested again, step past it
+    if (added == 0 && !complete) {
+        lastMinute++;
+        download.namesAtLastMinute.clear();
+    }
+    if (lastMinute >= 24 * 60 || download.pages >= TIMETABLE_MAX_PAGES) complete = true;
+    return !complete;
+}
+
+// A few pages of the running download, the store is written after the last one
+static void downloadSlice() {
+    bool failed = false;
+    bool more = true;
+    for (int i = 0; i < TIMETABLE_PAGES_PER_SLICE && more; i++) {
+        more = downloadPage(failed);
+    }
+    if (failed) {
+        Serial.println("Timetable: download failed");
+        endDownload();
+        return;
+    }
+    if (more) {
+        schedulerSetIn(TASK_TIMETABLE, TIMETABLE_SLICE_INTERVAL);
+        return;
+    }
+
+    Serial.printf("Timetable %d: %d pages, %lu bytes in %lu ms\n",
+                  download.index + 1, download.pages, download.bytes, millis() - download.start);
+    writeTimetable(download.index, download.stationId, download.station, download.dayKey, download.builder);
+    endDownload();
+}
+
+static bool readPlanned(uint8_t index, const String& stationId, uint32_t dayKey, int fromMinute,
+                        size_t limit, String& station, std::vector<Transport>& planned) {
+    File file;
+    TimetableHeader header;
+    StoredId storedId;
+    if (!openTimetable(index, file, header, storedId)) return false;
+    if (storedId != stationId.c_str() || header.dayKey != dayKey || !readString(file, station, header.stationLength)) {
+        file.close();
+        return false;
+    }
+
+    // Kept between calls, the board is read on every refresh
+    static std::vector<FixedString<32>> dict;
+    dict.resize(header.dictCount);
+    for (uint8_t i = 0; i < header.dictCount; i++) {
+        uint8_t len;
+        if (file.read(&len, 1) != 1 || !readString(file, dict[i], len)) {
+            file.close();
+            return false;
+        }
+    }
+
+    const TimetableIndex& start = header.index[std::min(fromMinute / 60, 23)];
+    if (!file.seek(file.position() + start.offset)) {
+        file.close();
+        return false;
+    }
+
+    TimetableReader reader(file, header.entriesLength - start.offset);
+    int minute = start.prevMinute;
+    planned.clear();
+
+    while (planned.size() < limit) {
+        uint32_t delta;
+        uint8_t category, destination, numberLow, numberHigh, nameLength;
+        if (!reader.varint(delta) || !reader.next(category) || !reader.next(destination) ||
+            !reader.next(numberLow) || !reader.next(numberHigh) || !reader.next(nameLength)) {
+            break;
+        }
+
+        Transport transport;
+        if (!reader.string(transport.name, nameLength)) break;
+        minute += delta;
+        if (minute < fromMinute) continue;
+
+        int16_t number = numberLow | (numberHigh << 8);
+        if (number >= 0) transport.number.format("%d", number);
+        transport.category = category < dict.size() ? dict[category].c_str() : "";
+        transport.destination = destination < dict.size() ? dict[destination].c_str() : "";
+        transport.departure = formatMinute(minute);
+        planned.push_back(transport);
+    }
+    file.close();
+    return true;
+}
+
+static void mergeRealtime(std::vector<Transport>& planned, const std::vector<Transport>& live, size_t limit) {
+    for (const Transport& update : live) {
+        if (update.name == "null") continue;
+
+        // Journey key: journey name plus planned departure
+        auto match = std::find_if(planned.begin(), planned.end(), [&](const Transport& t) {
+            return t.name == update.name && t.departure == update.departure;
+        });
+
+        if (match != planned.end()) {
+            match->delay = update.delay;
+        } else {
+            // Extra journey that is not in the planned timetable
+            auto position = std::find_if(planned.begin(), planned.end(), [&](const Transport& t) {
+                return t.departure > update.departure;
+            });
+            planned.insert(position, update);
+        }
+    }
+    if (planned.size() > limit) planned.resize(limit);
+}
+
+bool timetableBoard(uint8_t index, const String& stationId, String& station, std::vector<Transport>& transports) {
+    DateTimeText from = getFormattedTimeRelativeToNow(config.offset);
+    uint32_t dayKey = localDayKey(from.c_str());
+    size_t limit = config.limit;
+
+    loadHeader(index, stationId);
+    static std::vector<Transport> planned;
+    // Falls back to a full fetch when the store does not cover the next rows (e.g. past midnight)
+    if (storedDayKey[index] != dayKey ||
+        !readPlanned(index, stationId, dayKey, minuteOfDay(from.c_str() + 11), limit, station, planned) ||
+        planned.size() < limit) {
+        timetableMisses++;
+        return false;
+    }
+
+    // Live data only for the next few departures, and only once one of them is close
+    // (rows are in time order, the first one decides)
+    bool departureClose = !planned.empty() &&
+        minuteOfDay(planned[0].departure.c_str()) - minuteOfDay(from.c_str() + 11) <= TIMETABLE_REALTIME_WINDOW;
+    String liveStation;
+    static std::vector<Transport> live;
+    if (!departureClose) {
+        timetableLiveSkips++;
+    } else if (fetchDepartures(stationId, TIMETABLE_REALTIME_COUNT, from.c_str(), liveStation, live)) {
+        mergeRealtime(planned, live, limit);
+    } else {
+        Serial.println("Timetable: no live delays, showing planned times");
+    }
+
+    transports = planned;
+    timetableHits++;
+    return true;
+}
+
+bool timetableDownloading() {
+    return download.active;
+}
+
+void timetableService() {
+    if (download.active) {
+        downloadSlice();
+        return;
+    }
+    schedulerCancel(TASK_TIMETABLE); // left over from before a deep sleep
+    if (!activeProvider().pagesByTime()) return; // the store is built from boards paged by time
+    DateTimeText now = getFormattedTimeRelativeToNow(0);
+    uint32_t today = localDayKey(now.c_str());
+    if (today < 20200101) return; // time not synced yet
+    int hour = atoi(now.c_str() + 11);
+
+    for (uint8_t i = 0; i < 2; i++) {
+        const String& stationId = i == 0 ? config.stationId : config.stationId2;
+        if (stationId.isEmpty()) continue;
+
+        loadHeader(i, stationId);
+        if (storedDayKey[i] == today) continue;
+
+        // Yesterday's store is replaced at night, a missing store right away
+        if (storedDayKey[i] != 0 && hour < TIMETABLE_DOWNLOAD_HOUR) continue;
+        if (downloadAttempted[i] && millis() - lastDownloadAttempt[i] < TIMETABLE_RETRY_INTERVAL) continue;
+
+        downloadAttempted[i] = true;
+        lastDownloadAttempt[i] = millis();
+        startDownload(i, stationId);
+        downloadSlice();
+        return; // one station at a time
+    }
+}
+
+void timetableClear() {
+    for (uint8_t i = 0; i < 2; i++) {
+        SPIFFS.remove(TIMETABLE_FILES[i]);
+        headerLoaded[i] = false;
+    }
+}
+
+void timetableReport() {
+    for (uint8_t i = 0; i < 2; i++) {
+        Serial.printf("Timetable %d: day %lu, %d departures\n", i + 1, (unsigned long)storedDayKey[i], storedCount[i]);
+    }
+    Serial.printf("Timetable hits %lu, misses %lu, live polls skipped %lu\n", timetableHits, timetableMisses, timetableLiveSkips);
+    if (download.active) {
+        Serial.printf("Timetable %d: download at %s, %d pages\n", download.index + 1,
+                      formatMinute(download.lastMinute).c_str(), download.pages);
+    }
+    Serial.printf("Stationboard requests %lu, bytes %lu\n", stationboardRequests, stationboardBytes);
+}
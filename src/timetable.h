@@ -0,0 +1,21 @@
+#ifndef TIMETABLE_H
+#define TIMETABLE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "stationboard.h"
+
+// Daily store of planned departures per station, overlaid with live delays
+extern unsigned long timetableHits;
+extern unsigned long timetableMisses;
+extern unsigned long timetableLiveSkips;   // live polls left out, no departure close enough
+
+// Starts a due download or continues the running one by a slice of pages.
+// While a download runs TASK_TIMETABLE is due for the next slice.
+void timetableService();
+bool timetableDownloading();
+bool timetableBoard(uint8_t index, const String& stationId, String& station, std::vector<Transport>& transports);
+void timetableClear();
+void timetableReport();
+
+#endif // TIMETABLE_H
@@ -0,0 +1,281 @@
+#include "tlssession.h"
+#include <esp_system.h>
+#include <esp_crt_bundle.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl_internal.h>
+
+#define TLS_CACHE_SLOTS 2
+#define TLS_HOST_SIZE 48
+#define TLS_RTC_SESSION_SIZE 2048   // serialized session incl. the peer certificate
+#define TLS_RTC_MAGIC 0x544C5332    // "TLS2", sessions from a verified handshake
+static const int32_t TLS_HANDSHAKE_TIMEOUT = 10000;
+
+unsigned long tlsFullHandshakes = 0;
+unsigned long tlsResumedHandshakes = 0;
+unsigned long tlsFullHandshakeMs = 0;
+unsigned long tlsResumedHandshakeMs = 0;
+uint32_t tlsFullHandshakeCycles = 0;
+uint32_t tlsResumedHandshakeCycles = 0;
+
+struct CachedSession {
+    char host[TLS_HOST_SIZE];
+    mbedtls_ssl_session session;
+    bool valid;
+};
+
+static CachedSession cache[TLS_CACHE_SLOTS];
+static uint8_t nextSlot = 0;
+
+// Most recent session, restored into the RAM cache after a deep sleep wake
+struct RtcSession {
+    uint32_t magic;
+    char host[TLS_HOST_SIZE];
+    uint16_t length;
+    uint8_t data[TLS_RTC_SESSION_SIZE];
+};
+
+RTC_DATA_ATTR static RtcSession rtcSession;
+
+static int randomCallback(void*, unsigned char* out, size_t len) {
+    esp_fill_random(out, len);
+    return 0;
+}
+
+static void dropSession(CachedSession& slot) {
+    mbedtls_ssl_session_free(&slot.session);
+    mbedtls_ssl_session_init(&slot.session);
+    slot.valid = false;
+}
+
+static CachedSession* findSession(const char* host) {
+    for (uint8_t i = 0; i < TLS_CACHE_SLOTS; i++) {
+        if (cache[i].valid && strcmp(cache[i].host, host) == 0) return &cache[i];
+    }
+
+    if (rtcSession.magic != TLS_RTC_MAGIC || strcmp(rtcSession.host, host) != 0) return nullptr;
+    CachedSession& slot = cache[nextSlot];
+    nextSlot = (nextSlot + 1) % TLS_CACHE_SLOTS;
+    dropSession(slot);
+    if (mbedtls_ssl_session_load(&slot.session, rtcSession.data, rtcSession.length) != 0) {
+        rtcSession.magic = 0;
+        return nullptr;
+    }
+    strlcpy(slot.host, host, sizeof(slot.host));
+    slot.valid = true;
+    return &slot;
+}
+
+static void storeSession(const mbedtls_ssl_context* ssl, const char* host) {
+    CachedSession* slot = nullptr;
+    for (uint8_t i = 0; i < TLS_CACHE_SLOTS && !slot; i++) {
+        if (cache[i].valid && strcmp(cache[i].host, host) == 0) slot = &cache[i];
+    }
+    if (!slot) {
+        slot = &cache[nextSlot];
+        nextSlot = (nextSlot + 1) % TLS_CACHE_SLOTS;
+    }
+    dropSession(*slot);
+    if (mbedtls_ssl_get_session(ssl, &slot->session) != 0) return;
+    strlcpy(slot->host, host, sizeof(slot->host));
+    slot->valid = true;
+
+    size_t length = 0;
+    if (mbedtls_ssl_session_save(&slot->session, rtcSession.data, sizeof(rtcSession.data), &length) == 0) {
+        strlcpy(rtcSession.host, host, sizeof(rtcSession.host));
+        rtcSession.length = length;
+        rtcSession.magic = TLS_RTC_MAGIC;
+    } else {
+        rtcSession.magic = 0; // too large for RTC memory, RAM only
+    }
+}
+
+TlsSessionClient::TlsSessionClient() : active(false), peeked(-1) {}
+
+TlsSessionClient::~TlsSessionClient() {
+    stop();
+}
+
+int TlsSessionClient::sendCallback(void* ctx, const unsigned char* buf, size_t len) {
+    TlsSessionClient* client = static_cast<TlsSessionClient*>(ctx);
+    if (!client->WiFiClient::connected()) return MBEDTLS_ERR_NET_CONN_RESET;
+    size_t sent = client->WiFiClient::write(buf, len);
+    return sent > 0 ? (int)sent : MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+int TlsSessionClient::recvCallback(void* ctx, unsigned char* buf, size_t len) {
+    TlsSessionClient* client = static_cast<TlsSessionClient*>(ctx);
+    int pending = client->WiFiClient::available();
+    if (pending <= 0) {
+        return client->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    return client->WiFiClient::read(buf, std::min(len, (size_t)pending));
+}
+
+bool TlsSessionClient::handshake(const char* host, int32_t timeout) {
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    active = true;
+
+    if (mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) return false;
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    if (esp_crt_bundle_attach(&conf) != ESP_OK) return false;
+    mbedtls_ssl_conf_rng(&conf, randomCallback, nullptr);
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+    mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    if (mbedtls_ssl_setup(&ssl, &conf) != 0 || mbedtls_ssl_set_hostname(&ssl, host) != 0) return false;
+    mbedtls_ssl_set_bio(&ssl, this, sendCallback, recvCallback, nullptr);
+
+    CachedSession* cached = findSession(host);
+    bool offered = cached && mbedtls_ssl_set_session(&ssl, &cached->session) == 0;
+
+    // Cycles are only counted inside the handshake steps, waiting for the
+    // network is excluded
+    unsigned long start = millis();
+    uint32_t cycles = 0;
+    bool resumed = false;
+    while (ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        uint32_t stepStart = ESP.getCycleCount();
+        int ret = mbedtls_ssl_handshake_step(&ssl);
+        cycles += ESP.getCycleCount() - stepStart;
+        if (ssl.handshake && ssl.handshake->resume) resumed = true;
+
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            if (millis() - start > (unsigned long)timeout) {
+                Serial.printf("TLS handshake with %s timed out\n", host);
+                return false;
+            }
+            delay(1);
+        } else if (ret != 0) {
+            if (ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
+                Serial.printf("TLS certificate of %s not trusted: flags 0x%lx\n", host,
+                              (unsigned long)mbedtls_ssl_get_verify_result(&ssl));
+            } else {
+                Serial.printf("TLS handshake with %s failed: -0x%04x\n", host, -ret);
+            }
+            if (offered) dropSession(*cached); // the next attempt starts fresh
+            return false;
+        }
+    }
+
+    unsigned long duration = millis() - start;
+    if (resumed) {
+        tlsResumedHandshakes++;
+        tlsResumedHandshakeMs = duration;
+        tlsResumedHandshakeCycles = cycles;
+    } else {
+        tlsFullHandshakes++;
+        tlsFullHandshakeMs = duration;
+        tlsFullHandshakeCycles = cycles;
+    }
+    Serial.printf("TLS %s handshake with %s: %lu ms, %lu kcycles\n", resumed ? "resumed" : "full",
+                  host, duration, (unsigned long)(cycles / 1000));
+
+    // Also after a resumption, the server may have issued a new ticket
+    storeSession(&ssl, host);
+    return true;
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port, TLS_HANDSHAKE_TIMEOUT);
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    return connect(ip.toString().c_str(), port, timeout);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, TLS_HANDSHAKE_TIMEOUT);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    stop();
+    if (!WiFiClient::connect(host, port, timeout)) return 0;
+    if (!handshake(host, timeout)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+size_t TlsSessionClient::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+    if (!active) return 0;
+    size_t written = 0;
+    unsigned long start = millis();
+    while (written < size) {
+        int ret = mbedtls_ssl_write(&ssl, buf + written, size - written);
+        if (ret > 0) {
+            written += ret;
+        } else if ((ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) &&
+                   millis() - start < (unsigned long)TLS_HANDSHAKE_TIMEOUT) {
+            delay(1);
+        } else {
+            break;
+        }
+    }
+    return written;
+}
+
+int TlsSessionClient::available() {
+    if (!active) return 0;
+    size_t pending = mbedtls_ssl_get_bytes_avail(&ssl);
+    if (pending == 0 && WiFiClient::available() > 0) {
+        mbedtls_ssl_read(&ssl, nullptr, 0); // decrypt the next record
+        pending = mbedtls_ssl_get_bytes_avail(&ssl);
+    }
+    return pending + (peeked >= 0 ? 1 : 0);
+}
+
+int TlsSessionClient::read() {
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+    if (!active || size == 0) return -1;
+    size_t offset = 0;
+    if (peeked >= 0) {
+        buf[offset++] = peeked;
+        peeked = -1;
+        if (offset == size || available() == 0) return offset;
+    }
+    int ret = mbedtls_ssl_read(&ssl, buf + offset, size - offset);
+    if (ret > 0) return offset + ret;
+    return offset > 0 ? (int)offset : -1;
+}
+
+int TlsSessionClient::peek() {
+    if (peeked < 0 && available() > 0) peeked = read();
+    return peeked;
+}
+
+void TlsSessionClient::flush() {
+    // Nothing buffered on the send side, WiFiClient::flush() would drop received data
+}
+
+void TlsSessionClient::stop() {
+    if (active) {
+        mbedtls_ssl_close_notify(&ssl);
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_config_free(&conf);
+        active = false;
+    }
+    peeked = -1;
+    WiFiClient::stop();
+}
+
+uint8_t TlsSessionClient::connected() {
+    if (!active) return 0;
+    return peeked >= 0 || mbedtls_ssl_get_bytes_avail(&ssl) > 0 || WiFiClient::connected();
+}
+
+void tlsReport() {
+    Serial.printf("TLS handshakes: %lu full (last %lu ms, %lu kcycles), %lu resumed (last %lu ms, %lu kcycles)\n",
+                  tlsFullHandshakes, tlsFullHandshakeMs, (unsigned long)(tlsFullHandshakeCycles / 1000),
+                  tlsResumedHandshakes, tlsResumedHandshakeMs, (unsigned long)(tlsResumedHandshakeCycles / 1000));
+}
@@ -0,0 +1,53 @@
+#ifndef TLSSESSION_H
+#define TLSSESSION_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <mbedtls/ssl.h>
+
+// HTTPS client that resumes TLS sessions (session ID or ticket) per host.
+// Sessions are kept in RAM, the most recent one also in RTC memory so it
+// survives night deep sleep. The server certificate chain is verified
+// against the IDF certificate bundle on every full handshake, provider API
+// keys go out in the request headers.
+class TlsSessionClient : public WiFiClient {
+public:
+    TlsSessionClient();
+    ~TlsSessionClient();
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+    int connect(const char* host, uint16_t port, int32_t timeout) override;
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+
+private:
+    bool handshake(const char* host, int32_t timeout);
+    static int sendCallback(void* ctx, const unsigned char* buf, size_t len);
+    static int recvCallback(void* ctx, unsigned char* buf, size_t len);
+
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    bool active;
+    int peeked;
+};
+
+extern unsigned long tlsFullHandshakes;
+extern unsigned long tlsResumedHandshakes;
+extern unsigned long tlsFullHandshakeMs;      // last full handshake
+extern unsigned long tlsResumedHandshakeMs;   // last resumed handshake
+extern uint32_t tlsFullHandshakeCycles;
+extern uint32_t tlsResumedHandshakeCycles;
+
+void tlsReport();
+
+#endif // TLSSESSION_H
@@ -0,0 +1,253 @@
+#include "trias.h"
+#include "globals.h"
+#include "utilities.h"
+#include "timesync.h"
+#include <TimeLib.h>
+#include <ctype.h>
+
+static const char* TRIAS_URL = "https://api.opentransportdata.swiss/trias2020";
+static const char* OJP_URL = "https://api.opentransportdata.swiss/ojp2020";
+
+enum TriasElement : uint16_t {
+    ELEMENT_STOP_EVENT = 1 << 0,
+    ELEMENT_THIS_CALL = 1 << 1,
+    ELEMENT_STOP_POINT_NAME = 1 << 2,
+    ELEMENT_SERVICE_DEPARTURE = 1 << 3,
+    ELEMENT_TIMETABLED_TIME = 1 << 4,
+    ELEMENT_ESTIMATED_TIME = 1 << 5,
+    ELEMENT_SERVICE = 1 << 6,
+    ELEMENT_PUBLISHED_LINE_NAME = 1 << 7,
+    ELEMENT_DESTINATION_TEXT = 1 << 8,
+    ELEMENT_MODE = 1 << 9,
+    ELEMENT_PRODUCT_CATEGORY = 1 << 10,
+    ELEMENT_SHORT_NAME = 1 << 11,
+    ELEMENT_JOURNEY_REF = 1 << 12,
+    ELEMENT_CANCELLED = 1 << 13,
+    ELEMENT_ERROR = 1 << 14,
+    ELEMENT_TEXT = 1 << 15,      // text of an international text, next to its Language
+};
+
+static const struct {
+    const char* name;
+    uint16_t flag;
+} ELEMENTS[] = {
+    {"StopEvent", ELEMENT_STOP_EVENT},
+    {"ThisCall", ELEMENT_THIS_CALL},
+    {"StopPointName", ELEMENT_STOP_POINT_NAME},
+    {"ServiceDeparture", ELEMENT_SERVICE_DEPARTURE},
+    {"TimetabledTime", ELEMENT_TIMETABLED_TIME},
+    {"EstimatedTime", ELEMENT_ESTIMATED_TIME},
+    {"Service", ELEMENT_SERVICE},
+    {"PublishedLineName", ELEMENT_PUBLISHED_LINE_NAME},
+    {"DestinationText", ELEMENT_DESTINATION_TEXT},
+    {"Mode", ELEMENT_MODE},
+    {"ProductCategory", ELEMENT_PRODUCT_CATEGORY},
+    {"ShortName", ELEMENT_SHORT_NAME},
+    {"JourneyRef", ELEMENT_JOURNEY_REF},
+    {"Cancelled", ELEMENT_CANCELLED},
+    {"ErrorMessage", ELEMENT_ERROR},     // TRIAS
+    {"ErrorCondition", ELEMENT_ERROR},   // SIRI, used by OJP
+    {"Text", ELEMENT_TEXT},
+};
+
+static uint16_t elementFlag(const char* name) {
+    for (const auto& element : ELEMENTS) {
+        if (strcmp(name, element.name) == 0) return element.flag;
+    }
+    return 0;
+}
+
+// "YYYY-MM-DDTHH:MM:SS", optional fraction, then "Z" or "+HH:MM"
+static time_t parseTime(const char* text) {
+    int y, mo, d, h, mi, s, n = 0;
+    if (sscanf(text, "%4d-%2d-%2dT%2d:%2d:%2d%n", &y, &mo, &d, &h, &mi, &s, &n) != 6) return 0;
+    tmElements_t tm;
+    tm.Year = CalendarYrToTm(y);
+    tm.Month = mo;
+    tm.Day = d;
+    tm.Hour = h;
+    tm.Minute = mi;
+    tm.Second = s;
+    time_t utc = makeTime(tm);
+
+    const char* zone = text + n;
+    if (*zone == '.') {
+        zone++;
+        while (isdigit((unsigned char)*zone)) zone++;
+    }
+    int zoneHours = 0, zoneMinutes = 0;
+    if ((*zone == '+' || *zone == '-') && sscanf(zone + 1, "%2d:%2d", &zoneHours, &zoneMinutes) >= 1) {
+        long offset = (zoneHours * 60L + zoneMinutes) * 60L;
+        utc += *zone == '+' ? -offset : offset;
+    }
+    return utc;
+}
+
+template<size_t N>
+static void appendXmlEscaped(FixedString<N>& out, const char* text) {
+    for (; *text; text++) {
+        switch (*text) {
+            case '&': out.append("&amp;"); break;
+            case '<': out.append("&lt;"); break;
+            case '>': out.append("&gt;"); break;
+            case '"': out.append("&quot;"); break;
+            default: out.append(*text); break;
+        }
+    }
+}
+
+TriasProvider::TriasProvider(bool ojp) : ojp(ojp), tokenizer(*this), sink(nullptr) {}
+
+bool TriasProvider::request(const char* stationId, int limit, const char* datetime, ProviderRequest& request) {
+    request.url = config.providerUrl.isEmpty() ? (ojp ? OJP_URL : TRIAS_URL) : config.providerUrl.c_str();
+    request.contentType = ojp ? "application/xml" : "text/xml";
+    if (!config.providerKey.isEmpty()) request.authorization = config.providerKey.c_str();
+
+    time_t now = timeNow();
+    FixedString<24> timestamp;
+    timestamp.format("%04d-%02d-%02dT%02d:%02d:%02dZ", year(now), month(now), day(now), hour(now), minute(now), second(now));
+
+    // Local time with the current UTC offset, without one the server uses its own clock
+    DateTimeText local = datetime;
+    if (local.isEmpty() && timeIsSynced()) local = getFormattedTimeRelativeToNow(0);
+    FixedString<32> departure;
+    if (local.length() == 16) {
+        long offset = localTime().utcOffset / 60;
+        departure.format("%.10sT%s:00%c%02ld:%02ld", local.c_str(), local.c_str() + 11,
+                         offset < 0 ? '-' : '+', labs(offset) / 60, labs(offset) % 60);
+    }
+
+    FixedString<64> stopRef;
+    appendXmlEscaped(stopRef, stationId);
+
+    request.body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    if (ojp) {
+        request.body.appendf("<OJP xmlns=\"http://www.siri.org.uk/siri\" xmlns:ojp=\"http://www.vdv.de/ojp\" version=\"1.0\">"
+                             "<OJPRequest><ServiceRequest>"
+                             "<RequestTimestamp>%s</RequestTimestamp><RequestorRef>Stationboard</RequestorRef>"
+                             "<ojp:OJPStopEventRequest><RequestTimestamp>%s</RequestTimestamp>"
+                             "<ojp:Location><ojp:PlaceRef><ojp:StopPlaceRef>%s</ojp:StopPlaceRef>"
+                             "<ojp:LocationName><ojp:Text>%s</ojp:Text></ojp:LocationName></ojp:PlaceRef>",
+                             timestamp.c_str(), timestamp.c_str(), stopRef.c_str(), stopRef.c_str());
+        if (!departure.isEmpty()) request.body.appendf("<ojp:DepArrTime>%s</ojp:DepArrTime>", departure.c_str());
+        request.body.appendf("</ojp:Location><ojp:Params><ojp:NumberOfResults>%d</ojp:NumberOfResults>"
+                             "<ojp:StopEventType>departure</ojp:StopEventType>"
+                             "<ojp:IncludePreviousCalls>false</ojp:IncludePreviousCalls>"
+                             "<ojp:IncludeOnwardCalls>false</ojp:IncludeOnwardCalls>"
+                             "<ojp:IncludeRealtimeData>true</ojp:IncludeRealtimeData></ojp:Params>"
+                             "</ojp:OJPStopEventRequest></ServiceRequest></OJPRequest></OJP>", limit);
+    } else {
+        request.body.appendf("<Trias version=\"1.1\" xmlns=\"http://www.vdv.de/trias\" xmlns:siri=\"http://www.siri.org.uk/siri\">"
+                             "<ServiceRequest>"
+                             "<siri:RequestTimestamp>%s</siri:RequestTimestamp><siri:RequestorRef>Stationboard</siri:RequestorRef>"
+                             "<RequestPayload><StopEventRequest>"
+                             "<Location><LocationRef><StopPointRef>%s</StopPointRef></LocationRef>",
+                             timestamp.c_str(), stopRef.c_str());
+        if (!departure.isEmpty()) request.body.appendf("<DepArrTime>%s</DepArrTime>", departure.c_str());
+        request.body.appendf("</Location><Params><NumberOfResults>%d</NumberOfResults>"
+                             "<StopEventType>departure</StopEventType>"
+                             "<IncludePreviousCalls>false</IncludePreviousCalls>"
+                             "<IncludeOnwardCalls>false</IncludeOnwardCalls>"
+                             "<IncludeRealtimeData>true</IncludeRealtimeData></Params>"
+                             "</StopEventRequest></RequestPayload></ServiceRequest></Trias>", limit);
+    }
+    return !stopRef.truncated();
+}
+
+void TriasProvider::begin(DepartureSink& sink) {
+    this->sink = &sink;
+    tokenizer.reset();
+    open = 0;
+    serviceError = false;
+    beginEvent();
+}
+
+bool TriasProvider::feed(const uint8_t* data, size_t len) {
+    return tokenizer.feed(data, len) && !serviceError;
+}
+
+bool TriasProvider::finish() {
+    return tokenizer.finish() && !serviceError;
+}
+
+void TriasProvider::startElement(const char* name) {
+    uint16_t flag = elementFlag(name);
+    open |= flag;
+    if (flag == ELEMENT_STOP_EVENT) {
+        beginEvent();
+    } else if (flag == ELEMENT_ERROR) {
+        Serial.printf("%s: error response\n", this->name());
+        serviceError = true;
+    }
+}
+
+void TriasProvider::endElement(const char* name) {
+    uint16_t flag = elementFlag(name);
+    open &= ~flag;
+    if (flag == ELEMENT_STOP_EVENT) endEvent();
+}
+
+void TriasProvider::text(const char* text) {
+    if (!(open & ELEMENT_STOP_EVENT)) return;
+    bool isText = open & ELEMENT_TEXT;
+    if (open & ELEMENT_THIS_CALL) {
+        if ((open & ELEMENT_STOP_POINT_NAME) && isText) {
+            sink->setStation(text);
+        } else if ((open & ELEMENT_SERVICE_DEPARTURE) && (open & ELEMENT_TIMETABLED_TIME)) {
+            planned = parseTime(text);
+        } else if ((open & ELEMENT_SERVICE_DEPARTURE) && (open & ELEMENT_ESTIMATED_TIME)) {
+            estimated = parseTime(text);
+        }
+    } else if (open & ELEMENT_SERVICE) {
+        if ((open & ELEMENT_PUBLISHED_LINE_NAME) && isText) {
+            line = text;
+        } else if ((open & ELEMENT_DESTINATION_TEXT) && isText) {
+            destination = text;
+        } else if ((open & ELEMENT_PRODUCT_CATEGORY) && (open & ELEMENT_SHORT_NAME) && isText) {
+            category = text;
+            productCategory = true;
+        } else if ((open & ELEMENT_MODE) && (open & ELEMENT_SHORT_NAME) && isText && !productCategory) {
+            category = text;
+        } else if (open & ELEMENT_JOURNEY_REF) {
+            journey = text;
+        } else if (open & ELEMENT_CANCELLED) {
+            cancelled = strcmp(text, "true") == 0;
+        }
+    }
+}
+
+void TriasProvider::beginEvent() {
+    planned = 0;
+    estimated = 0;
+    cancelled = false;
+    productCategory = false;
+    line.clear();
+    category.clear();
+    destination.clear();
+    journey.clear();
+}
+
+void TriasProvider::endEvent() {
+    if (planned == 0 || cancelled) return;
+
+    Transport transport;
+    transport.name = journey; // journey key for polling
+    transport.category = category;
+    // "S1" or "IR 75" next to the category "S" or "IR" becomes "1" or "75"
+    const char* number = line.c_str();
+    if (!category.isEmpty() && line.startsWith(category.c_str())) number += category.length();
+    while (*number == ' ') number++;
+    transport.number = number;
+    if (destination.length() > 25) {
+        transport.destination.assign(destination.c_str(), 22).append("...");
+    } else {
+        transport.destination = destination;
+    }
+    time_t local = localFromUtc(planned);
+    transport.departure.format("%02d:%02d", hour(local), minute(local));
+    if (estimated != 0) {
+        long delay = estimated - planned;
+        transport.delay.format("%ld", (delay + (delay >= 0 ? 30 : -30)) / 60);
+    }
+    sink->add(transport);
+}
@@ -0,0 +1,46 @@
+#ifndef TRIAS_H
+#define TRIAS_H
+
+#include "provider.h"
+#include "xmlsax.h"
+
+// Departures from a TRIAS 1.1 or OJP 1.0 StopEventRequest, as served by
+// opentransportdata.swiss. Both answer with the same StopEvent structure,
+// only the namespaces and the request differ, so one parser covers both.
+// Elements are matched by name without prefix while the response streams in.
+class TriasProvider : public DataProvider, private XmlHandler {
+public:
+    explicit TriasProvider(bool ojp);
+
+    const char* name() const override { return ojp ? "OJP" : "TRIAS"; }
+    bool request(const char* stationId, int limit, const char* datetime, ProviderRequest& request) override;
+    void begin(DepartureSink& sink) override;
+    bool feed(const uint8_t* data, size_t len) override;
+    bool finish() override;
+
+private:
+    void startElement(const char* name) override;
+    void endElement(const char* name) override;
+    void text(const char* text) override;
+
+    void beginEvent();
+    void endEvent();
+
+    bool ojp;
+    XmlTokenizer tokenizer;
+    DepartureSink* sink;
+    uint16_t open;       // ELEMENT_* flags of the open elements
+    bool serviceError;
+
+    // Stop event being read
+    time_t planned;
+    time_t estimated;
+    bool cancelled;
+    bool productCategory;   // category from the product, not the mode
+    FixedString<16> line;
+    FixedString<8> category;
+    FixedString<64> destination;
+    FixedString<24> journey;
+};
+
+#endif // TRIAS_H
@@ -4,6 +4,21 @@
 #include "nightmode.h"
 #include "utilities.h"
 #include "networking.h"
+#include "snapshot.h"
+#include "altboard.h"
+#include "timetable.h"
+#include "timesync.h"
+#include "wificache.h"
+#include "radiopower.h"
+#include "energy.h"
+#include "polling.h"
+#include "governor.h"
+#include "configstore.h"
+#include "scheduler.h"
+#include "ticker.h"
+#include "tlssession.h"
+#include "heaptrack.h"
+#include "latency.h"
 #include <WiFiManager.h>
 #include <FS.h>
 #include <SPIFFS.h>
@@ -11,124 +26,196 @@
 #include <WiFiManager.h>
 #include <TimeLib.h>
 #include <Timezone.h>
+#include <sys/time.h>
+#include <esp_wifi.h>
 
 // Central European Time (Switzerland) with DST rules
 TimeChangeRule CEST = {"CEST", Last, Sun, Mar, 2, 120};  // UTC+2 (summer)
 TimeChangeRule CET  = {"CET ", Last, Sun, Oct, 3, 60};   // UTC+1 (winter)
 Timezone euCET(CEST, CET);
 
-void checkForConfigReset() {
-    // Initialize trigger pin as input with pullup
-    pinMode(TRIGGER_PIN, INPUT_PULLUP);
-    
-    // Allow the device to boot properly
-    delay(1000);
-    
-    // Display instruction
-    tft.fillScreen(TFT_BLACK);
-    tft.loadFont(AA_FONT_SMALL);
-    tft.setTextColor(TFT_WHITE, TFT_BLACK);
-    tft.drawString("Stationboard v" FIRMWARE_VERSION, 20, 60);
-    tft.drawString("Press BOOT to reset", 20, 80);
-    tft.drawString("Waiting 3 seconds...", 20, 100);
-    
-    // Check for button press after boot
+static const unsigned long RESET_WINDOW = 3000; // reset gesture: BOOT held within 3 s of power-on
+static volatile bool resetRequested = false;
+static volatile bool resetWatchDone = true;
+
+// Polls the BOOT button next to setup, which carries on with WiFi and the first fetch
+static void resetWatchTask(void*) {
     unsigned long startTime = millis();
-    while (millis() - startTime < 3000) {  // Wait 3 seconds for button press
+    while (millis() - startTime < RESET_WINDOW) {
         if (digitalRead(TRIGGER_PIN) == LOW) {
-            delay(50);  // Simple debounce
+            vTaskDelay(pdMS_TO_TICKS(50));  // Simple debounce
             if (digitalRead(TRIGGER_PIN) == LOW) {  // Double check
-                Serial.println("Reset button pressed - clearing WiFi settings");
-                
-                tft.fillScreen(TFT_BLACK);
-                tft.drawString("Clearing settings...", 20, 60);
-                
-                // Create WiFiManager instance
-                WiFiManager wm;
-                
-                // Reset settings
-                wm.resetSettings();
-                // Then try to mount and clear SPIFFS if possible
-                if (SPIFFS.begin(true)) {  // Mount SPIFFS with formatting on failure
-                    if (SPIFFS.exists("/config.json")) {
-                        SPIFFS.remove("/config.json");
-                        Serial.println("Config found and deleted");
-                    }
-                    SPIFFS.end();  // Clean unmount
-                }
-                tft.drawString("Settings cleared!", 20, 80);
-                tft.drawString("To configure:", 20, 120);
-                tft.drawString("Connect to Wifi Stationboard_AP", 20, 140);
-                delay(2000);
-                
-                ESP.restart();
+                resetRequested = true;
+                break;
             }
         }
-        delay(10);
+        vTaskDelay(pdMS_TO_TICKS(10));
     }
+    resetWatchDone = true;
+    vTaskDelete(NULL);
+}
+
+void beginConfigResetWatch() {
+    // Initialize trigger pin as input with pullup
+    pinMode(TRIGGER_PIN, INPUT_PULLUP);
+
+    // Instruction in the footer, the restored board (if any) stays visible
+    tft.loadFont(AA_FONT_SMALL);
+    tft.fillRect(0, tft.height() - 25, tft.width(), 25, TFT_WHITE);
+    tft.setTextColor(TFT_BLACK, TFT_WHITE);
+    tft.drawString("v" FIRMWARE_VERSION " - Press BOOT to reset (3s)", 4, tft.height() - 20);
+
+    resetRequested = false;
+    resetWatchDone = false;
+    xTaskCreate(resetWatchTask, "resetWatch", 2048, nullptr, 1, nullptr);
 }
 
-String URLEncode(String msg) {
-    const char *hex = "0123456789ABCDEF";
-    String encodedMsg = "";
+// Non-blocking, called between boot stages and from the loop
+void checkForConfigReset() {
+    if (!resetRequested) return;
+    resetRequested = false;
+    Serial.println("Reset button pressed - clearing WiFi settings");
     
-    for (char c : msg) {
-        if (isAlphaNumeric(c) || c == '-' || c == '_' 
-            || c == '.' || c == '~') {
-            encodedMsg += c;
-        } else {
-            encodedMsg += '%';
-            encodedMsg += hex[c >> 4];
-            encodedMsg += hex[c & 0xF];
+    tft.loadFont(AA_FONT_SMALL);
+    tft.fillScreen(TFT_BLACK);
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    tft.drawString("Clearing settings...", 20, 60);
+    
+    // Create WiFiManager instance
+    WiFiManager wm;
+    
+    // Reset settings
+    wm.resetSettings();
+    wifiForget();
+    configClear();
+    Serial.println("Config deleted");
+    // Then try to mount and clear SPIFFS if possible
+    if (SPIFFS.begin(true)) {  // Mount SPIFFS with formatting on failure
+        if (SPIFFS.exists("/config.json")) {
+            SPIFFS.remove("/config.json");
         }
+        snapshotClear();
+        timetableClear();
+        SPIFFS.end();  // Clean unmount
     }
-    return encodedMsg;
+    tft.drawString("Settings cleared!", 20, 80);
+    tft.drawString("To configure:", 20, 120);
+    tft.drawString("Connect to Wifi Stationboard_AP", 20, 140);
+    delay(2000);
+    
+    ESP.restart();
 }
 
-String getTimeWithoutSeconds() {
-    time_t utc = timeClient.getEpochTime();
-    time_t local = euCET.toLocal(utc);
+bool configResetWatchActive() {
+    return !resetWatchDone;
+}
 
-    String hourStr = String(hour(local));
-    if (hourStr.length() < 2) hourStr = "0" + hourStr;
+static bool isNightModeActiveAt(time_t utc);
+time_t nextNightModeChange(time_t utc);
+
+static LocalTime localSnapshot = {};
+static bool localSnapshotValid = false;
+
+// UTC time of a Timezone rule in the given year (same math as the Timezone library)
+static time_t ruleToUtc(const TimeChangeRule& rule, int yr, int offsetBefore) {
+    uint8_t m = rule.month;
+    uint8_t w = rule.week;
+    if (w == 0) {
+        // "Last" week: start from the following month and step back a week
+        if (++m > 12) {
+            m = 1;
+            ++yr;
+        }
+        w = 1;
+    }
 
-    String minuteStr = String(minute(local));
-    if (minuteStr.length() < 2) minuteStr = "0" + minuteStr;
+    tmElements_t tm;
+    tm.Hour = rule.hour;
+    tm.Minute = 0;
+    tm.Second = 0;
+    tm.Day = 1;
+    tm.Month = m;
+    tm.Year = CalendarYrToTm(yr);
+    time_t t = makeTime(tm);
+
+    t += ((rule.dow - weekday(t) + 7) % 7 + (w - 1) * 7) * SECS_PER_DAY;
+    if (rule.week == 0) t -= 7 * SECS_PER_DAY;
+    return t - offsetBefore * SECS_PER_MIN;
+}
 
-    return hourStr + ":" + minuteStr;
+static time_t nextDstChange(time_t utc) {
+    int yr = year(utc);
+    time_t next = 0;
+    for (int y = yr; y <= yr + 1; y++) {
+        time_t changes[] = {ruleToUtc(CEST, y, CET.offset), ruleToUtc(CET, y, CEST.offset)};
+        for (time_t change : changes) {
+            if (change > utc && (next == 0 || change < next)) next = change;
+        }
+    }
+    return next;
 }
 
-String getFormattedDateTime() {
-    time_t utc = timeClient.getEpochTime();
-    time_t local = euCET.toLocal(utc);
+const LocalTime& localTime() {
+    time_t utc = timeNow();
+
+    // Per loop this is a single compare, everything else happens once a minute
+    if (localSnapshotValid && utc / SECS_PER_MIN == localSnapshot.utc / SECS_PER_MIN) {
+        return localSnapshot;
+    }
+
+    LocalTime& lt = localSnapshot;
+    bool clockJumpedBack = localSnapshotValid && utc < lt.utc;
+
+    if (!localSnapshotValid || clockJumpedBack || utc >= lt.nextDstChange) {
+        lt.utcOffset = euCET.toLocal(utc) - utc;
+        lt.nextDstChange = nextDstChange(utc);
+    }
+    if (!localSnapshotValid || clockJumpedBack || utc >= lt.nextNightChange) {
+        lt.nightActive = isNightModeActiveAt(utc);
+        lt.nextNightChange = nextNightModeChange(utc);
+    }
+
+    lt.utc = utc;
+    lt.local = utc + lt.utcOffset;
 
-    String dateTime = getTimeWithoutSeconds();
-    dateTime += " - ";
-    dateTime += String(day(local));
-    dateTime += ". ";
-    dateTime += MONTHS[month(local) - 1];  // month() returns 1-12, MONTHS is 0-indexed
+    tmElements_t tm;
+    breakTime(lt.local, tm);
+    lt.year = tmYearToCalendar(tm.Year);
+    lt.month = tm.Month;
+    lt.day = tm.Day;
+    lt.hour = tm.Hour;
+    lt.minute = tm.Minute;
+    lt.weekday = tm.Wday;
 
-    // Add year
-    dateTime += " ";
-    dateTime += String(year(local));
+    snprintf(lt.time, sizeof(lt.time), "%02d:%02d", lt.hour, lt.minute);
+    // month is 1-12, MONTHS is 0-indexed
+    snprintf(lt.dateTime, sizeof(lt.dateTime), "%s - %d. %s %d", lt.time, lt.day, MONTHS[lt.month - 1], lt.year);
 
-    return dateTime;
+    localSnapshotValid = true;
+    return lt;
 }
 
-String getDayOfWeek() {
-    time_t utc = timeClient.getEpochTime();
-    time_t local = euCET.toLocal(utc);
-    return DAYS[weekday(local) - 1];  // weekday() returns 1-7 (Sun-Sat), DAYS is 0-indexed
+const char* getTimeWithoutSeconds() {
+    return localTime().time;
+}
+
+const char* getFormattedDateTime() {
+    return localTime().dateTime;
+}
+
+const char* getDayOfWeek() {
+    return DAYS[localTime().weekday - 1];  // weekday is 1-7 (Sun-Sat), DAYS is 0-indexed
 }
 
 void drawCurrentTime() {
-    timeClient.update();
-    
     // Create temporary sprite for time display
     TFT_eSprite timeSprite(&tft);
     timeSprite.setColorDepth(8);
+    heapTag(HEAP_TAG_SPRITE);
     timeSprite.createSprite(tft.width() / 2, 25);
+    heapTag(HEAP_TAG_FONT);
     timeSprite.loadFont(AA_FONT_SMALL);
+    heapTag(HEAP_TAG_NONE);
     
     // Clear sprite and set background
     timeSprite.fillSprite(TFT_WHITE);
@@ -141,23 +228,40 @@ void drawCurrentTime() {
     timeSprite.pushSprite(0, tft.height() - 25);
 }
 
-String getFormattedTimeRelativeToNow(int minutesOffset) {
-    time_t utc = timeClient.getEpochTime() + (minutesOffset * 60);
-    time_t local = euCET.toLocal(utc);
+time_t localFromUtc(time_t utc) {
+    const LocalTime& lt = localTime();
+    // The cached offset holds until the next DST change
+    return utc < lt.nextDstChange ? utc + lt.utcOffset : euCET.toLocal(utc);
+}
+
+DateTimeText getFormattedTimeRelativeToNow(int minutesOffset) {
+    time_t local = localFromUtc(timeNow() + (minutesOffset * 60));
+
+    DateTimeText text;
+    text.format("%04d-%02d-%02d %02d:%02d",
+                year(local),
+                month(local),
+                day(local),
+                hour(local),
+                minute(local));
+    return text;
+}
+
+// All backlight and CPU clock changes go through here for the energy model
+void setBacklight(uint32_t duty) {
+    ledcWrite(PWM_CHANNEL, duty);
+    energyBacklight(duty);
+}
 
-    char buffer[20];
-    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d",
-             year(local),
-             month(local),
-             day(local),
-             hour(local),
-             minute(local));
-    return String(buffer);
+void setCpuSpeed(uint32_t mhz) {
+    if (getCpuFrequencyMhz() == mhz) return;
+    setCpuFrequencyMhz(mhz);
+    energyCpu(mhz);
 }
 
 void updateBrightness() {
     // Set backlight brightness using LED PWM channel
-    ledcWrite(PWM_CHANNEL, BRIGHTNESS_LEVELS[currentBrightnessIndex]);
+    setBacklight(BRIGHTNESS_LEVELS[currentBrightnessIndex]);
     
     // For debugging, output current level to serial (can also use display)
     Serial.printf("Brightness level: %d\n", BRIGHTNESS_LEVELS[currentBrightnessIndex]);
@@ -180,87 +284,58 @@ void debugInfo() {
     Serial.printf("Largest block: %d bytes\n", ESP.getMaxAllocHeap());
     UBaseType_t watermark = uxTaskGetStackHighWaterMark(NULL);
     Serial.printf("Stack watermark: %d bytes\n", watermark);
-    Serial.println("RSSI: " + String(WiFi.RSSI()) + "dBm");
-    Serial.println("WiFi:" + String(WiFi.status()));
-    Serial.println("SSID:" + WiFi.SSID());
-    Serial.println("IP:" + WiFi.localIP().toString());
-    Serial.println("MAC:" + WiFi.macAddress());
-    Serial.println("CPU:" + String(getCpuFrequencyMhz()) + "MHz");
-    Serial.println("BL:" + String(ledcRead(PWM_CHANNEL)));
+    Serial.printf("RSSI: %d dBm\n", WiFi.RSSI());
+    Serial.printf("WiFi:%d\n", WiFi.status());
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) Serial.printf("SSID:%s\n", (const char*)ap.ssid);
+    IPAddress ip = WiFi.localIP();
+    Serial.printf("IP:%u.%u.%u.%u\n", ip[0], ip[1], ip[2], ip[3]);
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    Serial.printf("MAC:%02X:%02X:%02X:%02X:%02X:%02X\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    Serial.printf("CPU:%uMHz\n", getCpuFrequencyMhz());
+    Serial.printf("BL:%u\n", ledcRead(PWM_CHANNEL));
+    altBoardReport();
+    timetableReport();
+    timeSyncReport();
+    wifiReport();
+    radioPowerReport();
+    energyReport();
+    pollingReport();
+    governorReport();
+    tickerReport();
+    tlsReport();
     //Serial.println("VDD:" + String(readVDD()) + "mV");
-    Serial.println("Uptime:" + String(millis() / 1000) + "s");
-}
-
-void loadConfiguration() {
-    if (SPIFFS.exists("/config.json")) {
-        File configFile = SPIFFS.open("/config.json", FILE_READ);
-        if (configFile) {
-            DynamicJsonDocument doc(1024);
-            DeserializationError error = deserializeJson(doc, configFile);
-            
-            if (!error) {
-                config.stationId = doc["station_id"].as<String>();
-                config.stationId2 = doc["station_id2"].as<String>();
-                config.limit = doc["limit"].as<int>();
-                config.offset = doc["offset"].as<int>();
-                config.defaultBrightness = doc["defaultBrightness"].as<int>();
-                // Night mode settings
-                config.nightModeEnabled = doc["nightModeEnabled"] | false;
-                config.nightModeStartHour = doc["nightModeStartHour"] | 22;
-                config.nightModeStartMinute = doc["nightModeStartMinute"] | 0;
-                config.nightModeEndHour = doc["nightModeEndHour"] | 7;
-                config.nightModeEndMinute = doc["nightModeEndMinute"] | 0;
-                config.nightModeWeekendDisable = doc["nightModeWeekendDisable"] | false;
-            }
-            configFile.close();
-        } else {
-            Serial.println("No config found");
-        }
-    }
+    Serial.printf("Uptime:%lus\n", millis() / 1000);
 }
 
-void saveConfiguration() {
-    DynamicJsonDocument doc(1024);
-    doc["station_id"] = config.stationId;
-    doc["station_id2"] = config.stationId2;
-    doc["limit"] = config.limit;
-    doc["offset"] = config.offset;
-    doc["defaultBrightness"] = config.defaultBrightness;
-    // Night mode settings
-    doc["nightModeEnabled"] = config.nightModeEnabled;
-    doc["nightModeStartHour"] = config.nightModeStartHour;
-    doc["nightModeStartMinute"] = config.nightModeStartMinute;
-    doc["nightModeEndHour"] = config.nightModeEndHour;
-    doc["nightModeEndMinute"] = config.nightModeEndMinute;
-    doc["nightModeWeekendDisable"] = config.nightModeWeekendDisable;
-
-    File configFile = SPIFFS.open("/config.json", FILE_WRITE);
-    if (!configFile) {
-        Serial.println("- failed to open file for writing");
-        return;
-    }
-
-    serializeJson(doc, Serial);
-    serializeJson(doc, configFile);
-    configFile.close();
-    
-    // Verify the write
-    configFile = SPIFFS.open("/config.json");
-    if (!configFile) {
-        Serial.println("- failed to open file for verification");
-        return;
-    }
-    
-    if (configFile.size() > 0) {
-        Serial.println("- config file verified");
-        Serial.println("Contents:");
-        while(configFile.available()) {
-            Serial.write(configFile.read());
+// Serial commands, read while the device is awake
+void consoleService() {
+    static char line[16];
+    static uint8_t length = 0;
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (length < sizeof(line) - 1) line[length++] = c;
+            continue;
+        }
+        line[length] = 0;
+        length = 0;
+        if (strcmp(line, "heap") == 0) {
+            heapReport();
+        } else if (strcmp(line, "map") == 0) {
+            heapMap();
+        } else if (strcmp(line, "peak") == 0) {
+            heapResetPeaks();
+            Serial.println("Peaks reset");
+        } else if (strcmp(line, "latency") == 0) {
+            latencyReport();
+        } else if (strcmp(line, "debug") == 0) {
+            debugInfo();
+        } else if (line[0]) {
+            Serial.println("Commands: heap, map, peak, latency, debug");
         }
-    } else {
-        Serial.println("- config file appears empty");
     }
-    configFile.close();
 }
 
 void saveConfigCallback() {
@@ -283,7 +358,10 @@ void drawPortalIndicator() {
     int centerY = (tft.height() - 25) / 2;
 
     tft.drawString("CONFIG PORTAL ACTIVE", tft.width() / 2, centerY - 20);
-    tft.drawString("http://" + WiFi.localIP().toString(), tft.width() / 2, centerY);
+    IPAddress ip = WiFi.localIP();
+    FixedString<24> url;
+    url.format("http://%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    tft.drawString(url.c_str(), tft.width() / 2, centerY);
     tft.drawString("Triple-click to stop", tft.width() / 2, centerY + 20);
 
     // Restore text datum
@@ -299,7 +377,7 @@ void startConfigPortal() {
 
     // Extend temporary wake if in night mode
     if (inNightMode && temporaryNightWake) {
-        nightWakeStartTime = millis();
+        schedulerSetIn(TASK_NIGHT_WAKE_END, NIGHT_WAKE_DURATION);
         Serial.println("Extended night wake");
     }
 
@@ -309,6 +387,7 @@ void startConfigPortal() {
         if(!portalRunning){
             Serial.println("Starting Portal");
             Serial.printf("Config portal started at: http://%s\n", WiFi.localIP().toString().c_str());
+            setupPortalParameters(); // not registered yet when the fast connect skipped the boot portal
             wm.startWebPortal();
             portalRunning = true;
             drawPortalIndicator();
@@ -321,8 +400,8 @@ void startConfigPortal() {
             tft.fillScreen(TFT_BLUE);
             tft.fillRect(0, tft.height() - 25 , tft.width(), 25, TFT_WHITE);
             drawCurrentTime();
-            drawStationboard();
-            drawBTC();
+            displayStatus(drawStationboard());
+            tickerService(true);
           }
     }
 }
@@ -335,41 +414,52 @@ void switchStation() {
     
     // Extend temporary wake if in night mode
     if (inNightMode && temporaryNightWake) {
-        nightWakeStartTime = millis();
+        schedulerSetIn(TASK_NIGHT_WAKE_END, NIGHT_WAKE_DURATION);
         Serial.println("Extended night wake");
     }
     
     isFirstStation = !isFirstStation;
     Serial.println(isFirstStation ? "Switched to first station" : "Switched to second station");
-    drawStationboard(); // Redraw the stationboard with the new station, force refresh
+
+    if (altBoardShow(isFirstStation ? 0 : 1)) {
+        // Prerendered board is on screen, fetch fresh data on the next loop
+        forceRefresh = true;
+    } else {
+        drawStationboard(); // Redraw the stationboard with the new station, force refresh
+    }
+    prerenderInactiveStation();
 }
 
 void displayStatus(bool isSuccess) {
     // Clear the status area with white background
     tft.fillRect(tft.width() - 25, tft.height() - 25, 25, 25, TFT_WHITE);
     
-    // Draw the circle in green or red based on status
-    tft.fillCircle(tft.width() - 13, tft.height() - 13, 3, 
-                   isSuccess ? TFT_GREEN : TFT_RED);
+    // Draw the circle in green or red based on status, orange while the boot snapshot is shown
+    uint16_t color = isSuccess ? TFT_GREEN : TFT_RED;
+    if (isSuccess && snapshotStale) color = TFT_ORANGE;
+    tft.fillCircle(tft.width() - 13, tft.height() - 13, 3, color);
 }
 
 // Night mode helper functions
-bool isWeekend() {
-    time_t utc = timeClient.getEpochTime();
+static bool isWeekendAt(time_t utc) {
     time_t local = euCET.toLocal(utc);
     int dayOfWeek = weekday(local); // 1 = Sunday, 7 = Saturday
     return (dayOfWeek == 1 || dayOfWeek == 7);
 }
 
-bool isNightModeActive() {
+bool isWeekend() {
+    int dayOfWeek = localTime().weekday; // 1 = Sunday, 7 = Saturday
+    return (dayOfWeek == 1 || dayOfWeek == 7);
+}
+
+static bool isNightModeActiveAt(time_t utc) {
     if (!config.nightModeEnabled) return false;
     
     // Check if weekend should disable night mode
-    if (config.nightModeWeekendDisable && isWeekend()) {
+    if (config.nightModeWeekendDisable && isWeekendAt(utc)) {
         return false;
     }
     
-    time_t utc = timeClient.getEpochTime();
     time_t local = euCET.toLocal(utc);
     int currentHour = hour(local);
     int currentMinute = minute(local);
@@ -387,15 +477,72 @@ bool isNightModeActive() {
     }
 }
 
+bool isNightModeActive() {
+    return localTime().nightActive;
+}
+
+time_t nextNightModeChange(time_t utc) {
+    // Night mode can only flip at the configured start or end time or at midnight (weekend rule)
+    bool active = isNightModeActiveAt(utc);
+    time_t local = euCET.toLocal(utc);
+    time_t midnight = local - (local % SECS_PER_DAY);
+    time_t startOffset = (config.nightModeStartHour * 60 + config.nightModeStartMinute) * SECS_PER_MIN;
+    time_t endOffset = (config.nightModeEndHour * 60 + config.nightModeEndMinute) * SECS_PER_MIN;
+    time_t change = utc + 7 * SECS_PER_DAY; // recheck in a week when nothing ever changes
+
+    for (int day = 0; day <= 8; day++) {
+        time_t dayStart = midnight + day * SECS_PER_DAY;
+        time_t candidates[] = {dayStart, dayStart + startOffset, dayStart + endOffset};
+        for (time_t candidate : candidates) {
+            time_t candidateUtc = euCET.toUTC(candidate);
+            if (candidateUtc > utc && candidateUtc < change && isNightModeActiveAt(candidateUtc) != active) {
+                change = candidateUtc;
+            }
+        }
+    }
+    return change;
+}
+
+bool nightPrefetchDue() {
+    if (!inNightMode || temporaryNightWake || nightPrefetched || nightModeExitTime == 0) return false;
+    return timeNow() + NIGHT_PREFETCH_LEAD / 1000 >= (unsigned long)nightModeExitTime;
+}
+
+// Wake in time for the prefetch, otherwise at the next night mode boundary
+void scheduleNightBoundary() {
+    if (!timeIsSynced()) {
+        schedulerCancel(TASK_NIGHT_BOUNDARY);
+        return;
+    }
+    time_t now = timeNow();
+    time_t target = localTime().nextNightChange;
+    time_t lead = NIGHT_PREFETCH_LEAD / 1000;
+    if (inNightMode && !nightPrefetched && target - lead > now) {
+        target -= lead;
+    }
+    schedulerSetIn(TASK_NIGHT_BOUNDARY, target > now ? (uint64_t)(target - now) * 1000ULL : 0);
+}
+
+// Next clock redraw right after the wall-clock minute edge
+void scheduleMinuteTick() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    schedulerSetMinuteTick((uint64_t)tv.tv_sec * 1000ULL + tv.tv_usec / 1000);
+}
+
 void enterNightMode() {
     if (inNightMode) return;
     
     Serial.println("Entering night mode");
     inNightMode = true;
     temporaryNightWake = false;
+    schedulerCancel(TASK_NIGHT_WAKE_END);
+    nightPrefetched = false;
+    nightModeExitTime = localTime().nextNightChange;
+    Serial.printf("Night mode ends in %ld s\n", (long)(nightModeExitTime - timeNow()));
     
     // Turn off display
-    ledcWrite(PWM_CHANNEL, 0);
+    setBacklight(0);
     
     // Clear screen to black
     tft.fillScreen(TFT_BLACK);
@@ -407,16 +554,24 @@ void exitNightMode() {
     Serial.println("Exiting night mode");
     inNightMode = false;
     temporaryNightWake = false;
+    schedulerCancel(TASK_NIGHT_WAKE_END);
+    nightModeExitTime = 0;
+
+    if (nightPrefetched) {
+        // Board was fetched and drawn while dark, only the clock needs catching up
+        nightPrefetched = false;
+        drawCurrentTime();
+    } else {
+        // Force immediate refresh on next loop
+        forceRefresh = true;
+        
+        // Redraw screen
+        tft.fillScreen(TFT_BLUE);
+        tft.fillRect(0, tft.height() - 25 , tft.width(), 25, TFT_WHITE);
+    }
     
     // Restore brightness
     updateBrightness();
-
-    // Force immediate refresh on next loop
-    forceRefresh = true;
-    
-    // Redraw screen
-    tft.fillScreen(TFT_BLUE);
-    tft.fillRect(0, tft.height() - 25 , tft.width(), 25, TFT_WHITE);
 }
 
 void handleNightModeButton() {
@@ -424,7 +579,7 @@ void handleNightModeButton() {
     
     // Wake up temporarily
     temporaryNightWake = true;
-    nightWakeStartTime = millis();
+    schedulerSetIn(TASK_NIGHT_WAKE_END, NIGHT_WAKE_DURATION);
     
     // Restore brightness temporarily
     updateBrightness();
@@ -443,20 +598,20 @@ void updateNightModeDisplay() {
     if (!inNightMode || !temporaryNightWake) return;
     
     // Check if temporary wake duration has expired
-    if (millis() - nightWakeStartTime >= NIGHT_WAKE_DURATION) {
+    if (schedulerDue(TASK_NIGHT_WAKE_END)) {
         temporaryNightWake = false;
         
         // Turn off display again
-        ledcWrite(PWM_CHANNEL, 0);
+        setBacklight(0);
         tft.fillScreen(TFT_BLACK);
+        nightPrefetched = false; // board is gone, prefetch again if still due
         
         Serial.println("Temporary night wake ended");
-
-        lightSleep();
     }
 }
 
 void checkNightMode() {
+    if (!timeIsSynced()) return; // the unsynced clock starts in 1970
     bool shouldBeInNightMode = isNightModeActive();
     
     if (shouldBeInNightMode && !inNightMode) {
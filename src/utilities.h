@@ -2,25 +2,50 @@
 #define UTILITIES_H
 
 #include <Arduino.h>
-#include <NTPClient.h>
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
+#include "fixedstring.h"
 
 // Forward declaration of File class
 class File;
 
-extern NTPClient timeClient;
+// Local time, refreshed once per minute
+struct LocalTime {
+    time_t utc;
+    time_t local;
+    time_t utcOffset;
+    int year;
+    int month;
+    int day;
+    int hour;
+    int minute;
+    int weekday;          // 1 = Sunday, 7 = Saturday
+    char time[6];         // "HH:MM"
+    char dateTime[32];    // "HH:MM - D. Mon YYYY"
+    time_t nextDstChange; // UTC
+    time_t nextNightChange; // UTC, next time isNightModeActive() flips
+    bool nightActive;
+};
 
+const LocalTime& localTime();
 void checkForConfigReset();
-String URLEncode(String msg);
-String getTimeWithoutSeconds();
-String getFormattedDateTime();
-String getDayOfWeek();
+void beginConfigResetWatch();
+bool configResetWatchActive();
+// "YYYY-MM-DD HH:MM"
+typedef FixedString<20> DateTimeText;
+
+const char* getTimeWithoutSeconds();
+const char* getFormattedDateTime();
+const char* getDayOfWeek();
 void drawCurrentTime();
-String getFormattedTimeRelativeToNow(int minutesOffset);
+DateTimeText getFormattedTimeRelativeToNow(int minutesOffset);
+time_t localFromUtc(time_t utc);
 void updateBrightness();
+void setBacklight(uint32_t duty);
+void setCpuSpeed(uint32_t mhz);
 void cycleBrightness();
 void debugInfo();
+void consoleService();
 void loadConfiguration();
 void saveConfiguration();
 void saveConfigCallback();
@@ -37,6 +62,10 @@ void enterNightMode();
 void exitNightMode();
 void handleNightModeButton();
 void updateNightModeDisplay();
+time_t nextNightModeChange(time_t utc);
+bool nightPrefetchDue();
+void scheduleNightBoundary();
+void scheduleMinuteTick();
 
 // Constants
 extern const char* DAYS[];
@@ -0,0 +1,205 @@
+#include "wificache.h"
+#include "globals.h"
+#include "timesync.h"
+#include "radiopower.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <lwip/dhcp.h>
+#include <Preferences.h>
+
+static const uint32_t WIFI_CACHE_MAGIC = 0x57434332;       // "WCC2"
+static const unsigned long FAST_CONNECT_TIMEOUT = 1500;    // directed association, then fall back
+static const unsigned long FULL_CONNECT_TIMEOUT = 5000;    // scan + DHCP
+
+// Kept in NVS for cold boots and in RTC memory for deep-sleep wakes
+struct WifiCache {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    int64_t leaseTime;      // when DHCP handed out the address, 0 if unknown
+    uint32_t leaseSeconds;  // lease granted by the server, 0 if unknown
+};
+
+RTC_DATA_ATTR static WifiCache rtcCache;
+static WifiCache cache;
+static bool cacheLoaded = false;
+
+unsigned long wifiConnects = 0;
+unsigned long wifiFastConnects = 0;
+unsigned long wifiFallbacks = 0;
+unsigned long wifiLastConnectMs = 0;
+
+static void loadCache() {
+    if (cacheLoaded) return;
+    cacheLoaded = true;
+
+    if (rtcCache.magic == WIFI_CACHE_MAGIC) {
+        cache = rtcCache;
+        return;
+    }
+    Preferences prefs;
+    memset(&cache, 0, sizeof(cache));
+    if (prefs.begin("wifi", true)) {
+        if (prefs.getBytesLength("cache") == sizeof(cache)) {
+            prefs.getBytes("cache", &cache, sizeof(cache));
+        }
+        prefs.end();
+    }
+    if (cache.magic != WIFI_CACHE_MAGIC) memset(&cache, 0, sizeof(cache));
+}
+
+static bool waitConnected(unsigned long timeout) {
+    unsigned long start = millis();
+    while (millis() - start < timeout) {
+        wl_status_t status = WiFi.status();
+        if (status == WL_CONNECTED) return true;
+        if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL) return false;
+        delay(10);
+    }
+    return false;
+}
+
+// Lease time the DHCP server granted on the station interface, 0 if unknown
+static uint32_t grantedLease() {
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    struct netif* lwip = netif ? (struct netif*)esp_netif_get_netif_impl(netif) : nullptr;
+    struct dhcp* dhcp = lwip ? netif_dhcp_data(lwip) : nullptr;
+    return dhcp && dhcp->state == DHCP_STATE_BOUND ? dhcp->offered_t0_lease : 0;
+}
+
+// A cached lease is reused until half of it has passed, when a DHCP client
+// would renew it. Without a known lease only a configured static IP is used.
+static bool leaseValid() {
+    if (cache.ip == 0 || cache.leaseTime == 0 || cache.leaseSeconds == 0 || !timeIsSynced()) return false;
+    int64_t age = timeNow() - cache.leaseTime;
+    return age >= 0 && age < cache.leaseSeconds / 2;
+}
+
+// Static address from the config or a recent lease, returns false when DHCP is used
+static bool applyAddress() {
+    IPAddress ip;
+    if (!config.staticIp.isEmpty() && ip.fromString(config.staticIp.c_str()) && cache.gateway != 0) {
+        WiFi.config(ip, IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+        return true;
+    }
+    if (leaseValid()) {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+        return true;
+    }
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    return false;
+}
+
+bool wifiConnect() {
+    if (WiFi.status() == WL_CONNECTED) return true;
+
+    // Credentials as stored by WiFiManager
+    wifi_config_t conf;
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK || conf.sta.ssid[0] == 0) {
+        WiFi.reconnect();
+        return waitConnected(FULL_CONNECT_TIMEOUT);
+    }
+    char ssid[33];
+    char password[65];
+    memcpy(ssid, conf.sta.ssid, 32);
+    ssid[32] = '\0';
+    memcpy(password, conf.sta.password, 64);
+    password[64] = '\0';
+
+    loadCache();
+    unsigned long start = millis();
+    bool connected = false;
+    bool fast = false;
+    bool dhcp = true;
+
+    if (cache.magic == WIFI_CACHE_MAGIC && cache.channel != 0) {
+        dhcp = !applyAddress();
+        WiFi.begin(ssid, password, cache.channel, cache.bssid, false);
+        radioTuneStaConfig();
+        esp_wifi_connect();
+        connected = fast = waitConnected(FAST_CONNECT_TIMEOUT);
+        if (!connected) {
+            Serial.println("Directed association failed, scanning");
+            WiFi.disconnect();
+            wifiFallbacks++;
+        }
+    }
+    if (!connected) {
+        // Full scan, the access point or its channel may have changed
+        dhcp = config.staticIp.isEmpty() || cache.gateway == 0;
+        if (dhcp) {
+            WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+        } else {
+            applyAddress();
+        }
+        WiFi.begin(ssid, password, 0, nullptr, false);
+        radioTuneStaConfig();
+        esp_wifi_connect();
+        connected = waitConnected(FULL_CONNECT_TIMEOUT);
+    }
+
+    wifiLastConnectMs = millis() - start;
+    wifiConnects++;
+    if (fast) wifiFastConnects++;
+    Serial.printf("WiFi %s in %lu ms (%s%s)\n", connected ? "connected" : "failed", wifiLastConnectMs,
+                  fast ? "cached BSSID" : "scan", dhcp ? ", DHCP" : ", static IP");
+
+    if (connected) wifiRemember(dhcp);
+    return connected;
+}
+
+void wifiRemember(bool fromDhcp) {
+    if (WiFi.status() != WL_CONNECTED) return;
+    loadCache();
+
+    WifiCache next = cache;
+    next.magic = WIFI_CACHE_MAGIC;
+    memcpy(next.bssid, WiFi.BSSID(), sizeof(next.bssid));
+    next.channel = WiFi.channel();
+    if (fromDhcp) {
+        next.ip = (uint32_t)WiFi.localIP();
+        next.gateway = (uint32_t)WiFi.gatewayIP();
+        next.subnet = (uint32_t)WiFi.subnetMask();
+        next.dns = (uint32_t)WiFi.dnsIP();
+        next.leaseSeconds = grantedLease();
+        next.leaseTime = timeIsSynced() && next.leaseSeconds != 0 ? timeNow() : 0;
+    }
+
+    // Flash is only written when the association itself changed
+    bool changed = memcmp(next.bssid, cache.bssid, sizeof(next.bssid)) != 0 || next.channel != cache.channel ||
+                   next.ip != cache.ip || next.gateway != cache.gateway || next.leaseSeconds != cache.leaseSeconds ||
+                   cache.magic != WIFI_CACHE_MAGIC;
+    cache = next;
+    rtcCache = next;
+    if (changed) {
+        Preferences prefs;
+        if (prefs.begin("wifi", false)) {
+            prefs.putBytes("cache", &cache, sizeof(cache));
+            prefs.end();
+            Serial.printf("WiFi cache updated: channel %u, %s, lease %lu s\n", cache.channel,
+                          WiFi.localIP().toString().c_str(), (unsigned long)cache.leaseSeconds);
+        }
+    }
+}
+
+void wifiForget() {
+    memset(&cache, 0, sizeof(cache));
+    memset(&rtcCache, 0, sizeof(rtcCache));
+    cacheLoaded = true;
+    Preferences prefs;
+    if (prefs.begin("wifi", false)) {
+        prefs.clear();
+        prefs.end();
+    }
+}
+
+void wifiReport() {
+    Serial.printf("WiFi connects: %lu (%lu cached, %lu fallbacks), last %lu ms\n",
+                  wifiConnects, wifiFastConnects, wifiFallbacks, wifiLastConnectMs);
+}
@@ -0,0 +1,18 @@
+#ifndef WIFICACHE_H
+#define WIFICACHE_H
+
+#include <Arduino.h>
+
+// Directed re-association with the last access point (BSSID + channel, no scan)
+// and reuse of a recent DHCP lease. A full scan with DHCP is the fallback.
+extern unsigned long wifiConnects;
+extern unsigned long wifiFastConnects;
+extern unsigned long wifiFallbacks;
+extern unsigned long wifiLastConnectMs;
+
+bool wifiConnect();
+void wifiRemember(bool fromDhcp);
+void wifiForget();
+void wifiReport();
+
+#endif // WIFICACHE_H
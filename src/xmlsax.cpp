@@ -0,0 +1,281 @@
+#include "xmlsax.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char CDATA_START[] = "[CDATA[";
+static const uint8_t CDATA_MARKER = 10;   // marker - CDATA_MARKER characters of CDATA_START matched
+
+static bool isSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+XmlTokenizer::XmlTokenizer(XmlHandler& handler) : handler(handler) {
+    reset();
+}
+
+void XmlTokenizer::reset() {
+    state = TEXT;
+    error = false;
+    sawRoot = false;
+    depth = 0;
+    quote = 0;
+    marker = 0;
+    nameLength = 0;
+    entityLength = 0;
+    textLength = 0;
+}
+
+void XmlTokenizer::appendText(uint8_t c) {
+    if (textLength == 0 && isSpace(c)) return;
+    if (textLength < XML_TEXT_SIZE - 1) text[textLength++] = c;
+}
+
+void XmlTokenizer::appendCodePoint(uint32_t code) {
+    if (code < 0x80) {
+        appendText(code);
+    } else if (code < 0x800) {
+        appendText(0xC0 | (code >> 6));
+        appendText(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        appendText(0xE0 | (code >> 12));
+        appendText(0x80 | ((code >> 6) & 0x3F));
+        appendText(0x80 | (code & 0x3F));
+    } else {
+        appendText(0xF0 | (code >> 18));
+        appendText(0x80 | ((code >> 12) & 0x3F));
+        appendText(0x80 | ((code >> 6) & 0x3F));
+        appendText(0x80 | (code & 0x3F));
+    }
+}
+
+void XmlTokenizer::decodeEntity() {
+    entity[entityLength] = '\0';
+    if (strcmp(entity, "amp") == 0) appendText('&');
+    else if (strcmp(entity, "lt") == 0) appendText('<');
+    else if (strcmp(entity, "gt") == 0) appendText('>');
+    else if (strcmp(entity, "quot") == 0) appendText('"');
+    else if (strcmp(entity, "apos") == 0) appendText('\'');
+    else if (entity[0] == '#' && (entity[1] == 'x' || entity[1] == 'X')) appendCodePoint(strtoul(entity + 2, nullptr, 16));
+    else if (entity[0] == '#') appendCodePoint(strtoul(entity + 1, nullptr, 10));
+    else {
+        // Unknown entity, kept as written
+        appendText('&');
+        for (uint8_t i = 0; i < entityLength; i++) appendText(entity[i]);
+        appendText(';');
+    }
+}
+
+// Reports the run of text before a tag, trimmed and cut on a UTF-8 boundary
+void XmlTokenizer::flushText() {
+    while (textLength > 0 && isSpace(text[textLength - 1])) textLength--;
+    if (textLength == XML_TEXT_SIZE - 1) {
+        uint16_t start = textLength;
+        while (start > 0 && (text[start - 1] & 0xC0) == 0x80) start--;
+        if (start > 0 && (uint8_t)text[start - 1] >= 0xC0) {
+            uint8_t lead = text[start - 1];
+            uint16_t needed = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+            if (textLength - (start - 1) < needed) textLength = start - 1;
+        }
+    }
+    if (textLength > 0 && depth > 0) {
+        text[textLength] = '\0';
+        handler.text(text);
+    }
+    textLength = 0;
+}
+
+void XmlTokenizer::appendName(uint8_t c) {
+    // The namespace prefix is dropped
+    if (c == ':') {
+        nameLength = 0;
+    } else if (nameLength < XML_NAME_SIZE - 1) {
+        name[nameLength++] = c;
+    }
+}
+
+void XmlTokenizer::startElement() {
+    name[nameLength] = '\0';
+    handler.startElement(name);
+    depth++;
+    sawRoot = true;
+}
+
+void XmlTokenizer::endElement() {
+    if (depth == 0) {
+        error = true;
+        return;
+    }
+    name[nameLength] = '\0';
+    depth--;
+    handler.endElement(name);
+}
+
+void XmlTokenizer::put(uint8_t c) {
+    switch (state) {
+        case TEXT:
+            if (c == '<') {
+                flushText();
+                state = TAG_OPEN;
+            } else if (c == '&') {
+                entityLength = 0;
+                state = ENTITY;
+            } else {
+                appendText(c);
+            }
+            break;
+
+        case ENTITY:
+            if (c == ';') {
+                decodeEntity();
+                state = TEXT;
+            } else if (entityLength < sizeof(entity) - 1 && !isSpace(c) && c != '<') {
+                entity[entityLength++] = c;
+            } else {
+                error = true;
+            }
+            break;
+
+        case TAG_OPEN:
+            nameLength = 0;
+            if (c == '/') {
+                state = END_NAME;
+            } else if (c == '!') {
+                marker = 0;
+                state = BANG;
+            } else if (c == '?') {
+                marker = 0;
+                state = INSTRUCTION;
+            } else if (!isSpace(c) && c != '>') {
+                appendName(c);
+                state = START_NAME;
+            } else {
+                error = true;
+            }
+            break;
+
+        case START_NAME:
+            if (c == '>') {
+                startElement();
+                state = TEXT;
+            } else if (c == '/') {
+                startElement();
+                state = EMPTY_TAG;
+            } else if (isSpace(c)) {
+                startElement();
+                state = IN_TAG;
+            } else {
+                appendName(c);
+            }
+            break;
+
+        case IN_TAG:
+            if (c == '"' || c == '\'') {
+                quote = c;
+                state = ATTRIBUTE;
+            } else if (c == '>') {
+                state = TEXT;
+            } else if (c == '/') {
+                state = EMPTY_TAG;
+            }
+            break;
+
+        case ATTRIBUTE:
+            if (c == quote) state = IN_TAG;
+            break;
+
+        case EMPTY_TAG:
+            if (c == '>') {
+                endElement();
+                state = TEXT;
+            } else {
+                error = true;
+            }
+            break;
+
+        case END_NAME:
+            if (c == '>') {
+                endElement();
+                state = TEXT;
+            } else if (isSpace(c)) {
+                state = END_TAG;
+            } else {
+                appendName(c);
+            }
+            break;
+
+        case END_TAG:
+            if (c == '>') {
+                endElement();
+                state = TEXT;
+            } else if (!isSpace(c)) {
+                error = true;
+            }
+            break;
+
+        case BANG:
+            // "<!--", "<![CDATA[" or a declaration such as <!DOCTYPE ...>
+            if (marker == 0 && c == '-') {
+                marker = 1;
+            } else if (marker == 1 && c == '-') {
+                marker = 0;
+                state = COMMENT;
+            } else if (marker == 0 && c == '[') {
+                marker = CDATA_MARKER + 1;
+            } else if (marker > CDATA_MARKER && c == (uint8_t)CDATA_START[marker - CDATA_MARKER]) {
+                if (++marker == CDATA_MARKER + sizeof(CDATA_START) - 1) {
+                    marker = 0;
+                    state = CDATA;
+                }
+            } else {
+                state = c == '>' ? TEXT : DECLARATION;
+            }
+            break;
+
+        case COMMENT:
+            if (c == '-') {
+                if (marker < 2) marker++;
+            } else if (c == '>' && marker == 2) {
+                state = TEXT;
+            } else {
+                marker = 0;
+            }
+            break;
+
+        case CDATA:
+            if (c == ']') {
+                if (marker == 2) appendText(']');
+                else marker++;
+            } else if (c == '>' && marker == 2) {
+                marker = 0;
+                state = TEXT;
+            } else {
+                while (marker > 0) {
+                    appendText(']');
+                    marker--;
+                }
+                appendText(c);
+            }
+            break;
+
+        case DECLARATION:
+            if (c == '>') state = TEXT;
+            break;
+
+        case INSTRUCTION:
+            if (c == '>' && marker == 1) {
+                state = TEXT;
+            } else {
+                marker = c == '?' ? 1 : 0;
+            }
+            break;
+    }
+}
+
+bool XmlTokenizer::feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len && !error; i++) put(data[i]);
+    return !error;
+}
+
+bool XmlTokenizer::finish() {
+    return !error && sawRoot && depth == 0 && state == TEXT;
+}
@@ -0,0 +1,76 @@
+#ifndef XMLSAX_H
+#define XMLSAX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming XML tokenizer with fixed buffers, no Arduino dependencies.
+// Element names come without their namespace prefix, attributes are
+// skipped. Text is reported once per run between tags, entities decoded and
+// trimmed, whitespace-only runs are dropped. Comments, processing
+// instructions and declarations are skipped, CDATA counts as text. End tags
+// are matched by depth only, their names are not compared to the start tags.
+#define XML_NAME_SIZE 48
+#define XML_TEXT_SIZE 96
+
+class XmlHandler {
+public:
+    virtual ~XmlHandler() {}
+    virtual void startElement(const char* /*name*/) {}
+    virtual void endElement(const char* /*name*/) {}
+    virtual void text(const char* /*text*/) {}
+};
+
+class XmlTokenizer {
+public:
+    explicit XmlTokenizer(XmlHandler& handler);
+
+    void reset();
+    bool feed(const uint8_t* data, size_t len);
+    bool finish();   // every element closed
+
+    bool failed() const { return error; }
+
+private:
+    enum State : uint8_t {
+        TEXT,
+        ENTITY,
+        TAG_OPEN,       // after '<'
+        START_NAME,
+        END_NAME,
+        IN_TAG,         // attributes
+        ATTRIBUTE,      // quoted value
+        EMPTY_TAG,      // after '/' in a start tag
+        END_TAG,        // after the name of an end tag
+        BANG,           // after "<!"
+        COMMENT,
+        CDATA,
+        DECLARATION,
+        INSTRUCTION
+    };
+
+    void put(uint8_t c);
+    void flushText();
+    void appendText(uint8_t c);
+    void appendCodePoint(uint32_t code);
+    void decodeEntity();
+    void appendName(uint8_t c);
+    void startElement();
+    void endElement();
+
+    XmlHandler& handler;
+    State state;
+    bool error;
+    bool sawRoot;
+    uint16_t depth;
+    uint8_t quote;
+    uint8_t marker;        // matched characters of "--", "[CDATA[" or the end sequence
+    uint8_t nameLength;
+    uint8_t entityLength;
+    uint16_t textLength;
+    char name[XML_NAME_SIZE];
+    char entity[12];
+    char text[XML_TEXT_SIZE];
+};
+
+#endif // XMLSAX_H
@@ -0,0 +1,201 @@
+// Delta patch generator for Stationboard firmware images (Linux host tool)
+//
+// Build:  g++ -O2 -std=c++17 -Isrc tools/deltagen.cpp src/deltapatch.cpp -o deltagen
+// Create: ./deltagen old.bin new.bin patch.bin
+// Verify: ./deltagen --apply old.bin patch.bin out.bin
+//
+// old.bin is the firmware currently running on the device
+// (.pio/build/<env>/firmware.bin of that release).
+#include "deltapatch.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const size_t HASH_BYTES = 8;       // bytes hashed per old offset
+static const size_t HASH_BITS = 20;
+static const size_t MAX_CANDIDATES = 64;  // chain entries checked per position
+static const size_t MIN_COPY = 12;        // shorter matches cost more than literals
+
+static bool readFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+static bool writeFile(const char* path, const std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+static uint32_t hashAt(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> (64 - HASH_BITS));
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back(value >> (8 * i));
+}
+
+struct Stats {
+    size_t copies = 0;
+    size_t copied = 0;
+    size_t literals = 0;
+    size_t literalBytes = 0;
+};
+
+static void flushLiteral(std::vector<uint8_t>& out, const std::vector<uint8_t>& image, size_t start, size_t end, Stats& stats) {
+    if (end == start) return;
+    out.push_back(DELTA_OP_LITERAL);
+    putU32(out, end - start);
+    out.insert(out.end(), image.begin() + start, image.begin() + end);
+    stats.literals++;
+    stats.literalBytes += end - start;
+}
+
+static size_t matchLength(const std::vector<uint8_t>& a, size_t ai, const std::vector<uint8_t>& b, size_t bi) {
+    size_t n = 0;
+    while (ai + n < a.size() && bi + n < b.size() && a[ai + n] == b[bi + n]) n++;
+    return n;
+}
+
+// Greedy matcher: at every position of the new image take the longest run
+// found in the old one, preferring the continuation of the previous copy
+// (code after a change usually moved by the same amount)
+static std::vector<uint8_t> generate(const std::vector<uint8_t>& oldImage, const std::vector<uint8_t>& newImage, Stats& stats) {
+    std::vector<int32_t> head(1u << HASH_BITS, -1);
+    std::vector<int32_t> next(oldImage.size(), -1);
+    for (size_t i = 0; i + HASH_BYTES <= oldImage.size(); i++) {
+        uint32_t h = hashAt(&oldImage[i]);
+        next[i] = head[h];
+        head[h] = i;
+    }
+
+    DeltaHeader header = {DELTA_MAGIC, DELTA_VERSION, 0,
+                          (uint32_t)oldImage.size(), deltaCrc32(0, oldImage.data(), oldImage.size()),
+                          (uint32_t)newImage.size(), deltaCrc32(0, newImage.data(), newImage.size())};
+    std::vector<uint8_t> out(DELTA_HEADER_SIZE);
+    deltaWriteHeader(header, out.data());
+
+    size_t pos = 0;
+    size_t literalStart = 0;
+    size_t expected = 0; // old offset continuing the last copy
+    while (pos < newImage.size()) {
+        size_t bestLen = 0;
+        size_t bestOffset = 0;
+        if (expected < oldImage.size()) {
+            bestLen = matchLength(oldImage, expected, newImage, pos);
+            bestOffset = expected;
+        }
+        if (bestLen < MIN_COPY && pos + HASH_BYTES <= newImage.size()) {
+            int32_t candidate = head[hashAt(&newImage[pos])];
+            for (size_t checked = 0; candidate >= 0 && checked < MAX_CANDIDATES; checked++) {
+                size_t len = matchLength(oldImage, candidate, newImage, pos);
+                if (len > bestLen) {
+                    bestLen = len;
+                    bestOffset = candidate;
+                }
+                candidate = next[candidate];
+            }
+        }
+
+        if (bestLen >= MIN_COPY) {
+            flushLiteral(out, newImage, literalStart, pos, stats);
+            out.push_back(DELTA_OP_COPY);
+            putU32(out, bestOffset);
+            putU32(out, bestLen);
+            stats.copies++;
+            stats.copied += bestLen;
+            pos += bestLen;
+            literalStart = pos;
+            expected = bestOffset + bestLen;
+        } else {
+            pos++;
+            expected++;
+        }
+    }
+    flushLiteral(out, newImage, literalStart, pos, stats);
+    out.push_back(DELTA_OP_END);
+    return out;
+}
+
+// Applies a patch exactly like the device does, as a check before uploading
+class FileTarget : public DeltaTarget {
+public:
+    FileTarget(const std::vector<uint8_t>& oldImage) : oldImage(oldImage) {}
+
+    bool readOld(uint32_t offset, uint8_t* buf, size_t len) override {
+        if (offset + len > oldImage.size()) return false;
+        memcpy(buf, &oldImage[offset], len);
+        return true;
+    }
+    bool begin(const DeltaHeader& header) override {
+        image.reserve(header.newSize);
+        return true;
+    }
+    bool writeNew(const uint8_t* buf, size_t len) override {
+        image.insert(image.end(), buf, buf + len);
+        return true;
+    }
+
+    std::vector<uint8_t> image;
+
+private:
+    const std::vector<uint8_t>& oldImage;
+};
+
+static int apply(const char* oldPath, const char* patchPath, const char* outPath) {
+    std::vector<uint8_t> oldImage, patch;
+    if (!readFile(oldPath, oldImage) || !readFile(patchPath, patch)) return 1;
+
+    FileTarget target(oldImage);
+    DeltaPatcher* patcher = new DeltaPatcher(target);
+    // Same upload-sized chunks as the device's web server
+    for (size_t pos = 0; pos < patch.size(); pos += 1436) {
+        size_t len = std::min<size_t>(1436, patch.size() - pos);
+        if (!patcher->feed(&patch[pos], len)) break;
+    }
+    bool ok = patcher->finish();
+    if (!ok) fprintf(stderr, "Patch failed: %s\n", patcher->lastError());
+    delete patcher;
+    if (!ok || !writeFile(outPath, target.image)) return 1;
+    printf("Applied: %zu bytes\n", target.image.size());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 5 && std::string(argv[1]) == "--apply") {
+        return apply(argv[2], argv[3], argv[4]);
+    }
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s old.bin new.bin patch.bin\n"
+                        "       %s --apply old.bin patch.bin out.bin\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> oldImage, newImage;
+    if (!readFile(argv[1], oldImage) || !readFile(argv[2], newImage)) return 1;
+
+    Stats stats;
+    std::vector<uint8_t> patch = generate(oldImage, newImage, stats);
+    if (!writeFile(argv[3], patch)) return 1;
+
+    printf("Old %zu bytes, new %zu bytes, patch %zu bytes (%.1f%%)\n", oldImage.size(), newImage.size(),
+           patch.size(), 100.0 * patch.size() / newImage.size());
+    printf("%zu copies (%zu bytes), %zu literals (%zu bytes)\n", stats.copies, stats.copied,
+           stats.literals, stats.literalBytes);
+    return 0;
+}
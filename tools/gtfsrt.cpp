@@ -0,0 +1,421 @@
+// Decodes and serves recorded GTFS-Realtime feeds with the device's decoder (Linux host tool)
+//
+// Build:     g++ -O2 -std=c++17 -Isrc tools/gtfsrt.cpp src/gtfsrt.cpp -o gtfsrt
+// Decode:    ./gtfsrt decode feed.pb 8505000 [from-unix-time] [limit]
+// Serve:     ./gtfsrt serve feed.pb [port]      stand-in for the feed URL, any path
+// Sample:    ./gtfsrt sample feed.pb [stop]      synthetic feed around the current time
+// Self test: ./gtfsrt --selftest
+//
+// A real feed is recorded with curl, e.g.
+//   curl -H "Authorization: <key>" https://api.opentransportdata.swiss/gtfsrt2020 -o feed.pb
+#include "gtfsrt.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Minimal protobuf writer for the sample and test feeds
+class Proto {
+public:
+    Proto& varint(uint32_t field, uint64_t value) {
+        key(field, 0);
+        raw(value);
+        return *this;
+    }
+    Proto& string(uint32_t field, const std::string& text) {
+        key(field, 2);
+        raw(text.size());
+        out.insert(out.end(), text.begin(), text.end());
+        return *this;
+    }
+    Proto& message(uint32_t field, const Proto& inner) {
+        key(field, 2);
+        raw(inner.out.size());
+        out.insert(out.end(), inner.out.begin(), inner.out.end());
+        return *this;
+    }
+    Proto& fixed32(uint32_t field, uint32_t value) {
+        key(field, 5);
+        for (int i = 0; i < 4; i++) out.push_back(value >> (8 * i));
+        return *this;
+    }
+    Proto& fixed64(uint32_t field, uint64_t value) {
+        key(field, 1);
+        for (int i = 0; i < 8; i++) out.push_back(value >> (8 * i));
+        return *this;
+    }
+
+    std::vector<uint8_t> out;
+
+private:
+    void key(uint32_t field, uint8_t wire) { raw((uint64_t)field << 3 | wire); }
+    void raw(uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(value);
+    }
+};
+
+static Proto event(int64_t time, bool hasDelay, int32_t delay) {
+    Proto e;
+    if (hasDelay) e.varint(1, (uint64_t)(int64_t)delay); // int32 as a sign-extended varint
+    if (time) e.varint(2, time);
+    return e;
+}
+
+static Proto stopTime(const std::string& stop, int64_t time, bool hasDelay = false, int32_t delay = 0,
+                      bool arrivalOnly = false, uint64_t schedule = 0) {
+    Proto s;
+    s.varint(1, 5);
+    s.message(arrivalOnly ? 2 : 3, event(time, hasDelay, delay));
+    s.string(4, stop);
+    if (schedule) s.varint(5, schedule);
+    return s;
+}
+
+static Proto trip(const std::string& id, const std::string& route, uint64_t schedule = 0) {
+    Proto t;
+    t.string(1, id);
+    t.string(3, "20251009");
+    if (schedule) t.varint(4, schedule);
+    t.string(5, route);
+    return t;
+}
+
+static Proto entity(const std::string& id, const Proto& tripUpdate) {
+    Proto e;
+    e.string(1, id);
+    e.message(3, tripUpdate);
+    return e;
+}
+
+// Covers matching, platforms, cancellations, skipped stops, unknown fields and other entity types
+static std::vector<uint8_t> sampleFeed(const std::string& stop, int64_t base) {
+    Proto feed;
+    Proto header;
+    header.string(1, "2.0").varint(2, 0).varint(3, base);
+    feed.message(1, header);
+
+    // Platform of the stop, headsign and short name from trip properties
+    Proto a;
+    a.message(1, trip("A-1", "R-IR75")).message(2, stopTime(stop + ":0:3", base + 600, true, 120));
+    a.message(6, Proto().string(1, "A-1").string(5, "Zug").string(6, "IR 75"));
+    feed.message(2, entity("a", a));
+
+    // Another stop first, then the arrival at the last stop
+    Proto b;
+    b.message(1, trip("B-1", "R-S1")).message(2, stopTime("8505001", base + 100));
+    b.message(2, stopTime(stop, base + 300, true, -60, true));
+    b.message(3, Proto().string(1, "veh-b").string(2, "Sursee"));
+    feed.message(2, entity("b", b));
+
+    // Trip-level delay after the stop time updates, headsign from the vehicle label
+    Proto c;
+    c.message(1, trip("C-1", "R-S3")).message(2, stopTime(stop, base + 900));
+    c.message(3, Proto().string(2, "Bern")).varint(5, 300);
+    feed.message(2, entity("c", c));
+
+    // Canceled trip
+    Proto d;
+    d.message(1, trip("D-1", "R-S9", 3)).message(2, stopTime(stop, base + 200));
+    feed.message(2, entity("d", d));
+
+    // Deleted entity
+    Proto deleted;
+    deleted.string(1, "deleted").varint(2, 1);
+    Proto deletedUpdate;
+    deletedUpdate.message(1, trip("X-1", "R-X")).message(2, stopTime(stop, base + 250));
+    deleted.message(3, deletedUpdate);
+    feed.message(2, deleted);
+
+    // Skipped stop and a longer id with the stop as prefix
+    Proto e;
+    e.message(1, trip("E-1", "R-S6")).message(2, stopTime(stop, base + 350, false, 0, false, 1));
+    e.message(2, stopTime(stop + "0", base + 360));
+    feed.message(2, entity("e", e));
+
+    // Loop trip, the first visit is before the window
+    Proto f;
+    f.message(1, trip("F-1", "R-B2")).message(2, stopTime(stop, base - 100));
+    f.message(2, stopTime(stop, base + 1200));
+    feed.message(2, entity("f", f));
+
+    // Vehicle position and alert entities
+    Proto position;
+    position.fixed32(1, 0x42380000).fixed32(2, 0x41000000).fixed64(5, 12345);
+    Proto vehicle;
+    vehicle.message(1, trip("V-1", "R-V")).message(2, position).varint(5, base);
+    feed.message(2, Proto().string(1, "vehicle").message(4, vehicle));
+    Proto alert;
+    alert.message(5, Proto().string(1, std::string(600, 'x')).varint(7, 1));
+    feed.message(2, Proto().string(1, "alert").message(5, alert));
+
+    // Unknown fields, a delay-only update and the label replaced by trip_headsign
+    Proto g;
+    g.fixed64(99, 1).fixed32(98, 2).message(97, Proto().string(1, stop).varint(2, 3));
+    g.message(1, trip("G-1", "R-RE")).message(2, stopTime(stop, 0, true, 60));
+    g.message(2, stopTime(stop, base + 450));
+    g.message(3, Proto().string(2, "Luzern"));
+    g.message(6, Proto().string(5, "Arth-Goldau"));
+    feed.message(2, entity("g", g));
+
+    // Later departures and unrelated trips
+    for (int i = 0; i < 20; i++) {
+        Proto later;
+        later.message(1, trip("L-" + std::to_string(i), "R-L"));
+        later.message(2, stopTime(stop, base + 2000 + 60 * (19 - i), true, i));
+        feed.message(2, entity("l" + std::to_string(i), later));
+    }
+    for (int i = 0; i < 200; i++) {
+        Proto other;
+        other.message(1, trip("O-" + std::to_string(i), "R-O"));
+        for (int s = 0; s < 10; s++) other.message(2, stopTime("85" + std::to_string(10000 + s), base + 60 * s));
+        feed.message(2, entity("o" + std::to_string(i), other));
+    }
+    return feed.out;
+}
+
+static bool decode(const std::vector<uint8_t>& feed, size_t chunk, GtfsBoard& board) {
+    ProtoDecoder decoder(board);
+    bool ok = true;
+    for (size_t pos = 0; pos < feed.size() && ok; pos += chunk) {
+        ok = decoder.feed(&feed[pos], std::min(chunk, feed.size() - pos));
+    }
+    return ok && decoder.finish();
+}
+
+static void printBoard(const GtfsBoard& board) {
+    for (size_t i = 0; i < board.count(); i++) {
+        const GtfsDeparture& d = board.row(i);
+        time_t planned = d.time - d.delay;
+        char when[8];
+        strftime(when, sizeof(when), "%H:%M", localtime(&planned));
+        printf("%s %+4d min  %-8s %-24s %s\n", when, d.delay / 60,
+               d.shortName[0] ? d.shortName : d.routeId, d.headsign, d.tripId);
+    }
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+static int listenOn(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// HTTP/1.0, the whole feed with Content-Length for every GET
+static void serve(int listener, const std::vector<uint8_t>& feed, bool quiet) {
+    for (;;) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) continue;
+        std::string request;
+        char buf[512];
+        ssize_t n;
+        while (request.find("\r\n\r\n") == std::string::npos && (n = recv(client, buf, sizeof(buf), 0)) > 0) {
+            request.append(buf, n);
+        }
+        if (!quiet) printf("%s\n", request.substr(0, request.find("\r\n")).c_str());
+        std::string head = "HTTP/1.0 200 OK\r\nContent-Type: application/x-protobuf\r\nContent-Length: " +
+                           std::to_string(feed.size()) + "\r\nConnection: close\r\n\r\n";
+        send(client, head.data(), head.size(), MSG_NOSIGNAL);
+        send(client, feed.data(), feed.size(), MSG_NOSIGNAL);
+        close(client);
+    }
+}
+
+// Fetches like the device: headers, then the body straight into the decoder in small reads
+static bool fetch(uint16_t port, GtfsBoard& board) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    const char request[] = "GET /gtfsrt HTTP/1.0\r\nHost: localhost\r\n\r\n";
+    send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL);
+
+    ProtoDecoder decoder(board);
+    std::string head;
+    bool inBody = false;
+    long remaining = -1;
+    uint8_t chunk[128];
+    ssize_t n;
+    bool ok = true;
+    while (ok && remaining != 0 && (n = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+        size_t start = 0;
+        if (!inBody) {
+            head.append((char*)chunk, n);
+            size_t end = head.find("\r\n\r\n");
+            if (end == std::string::npos) continue;
+            if (head.compare(0, 12, "HTTP/1.0 200") != 0) break;
+            size_t length = head.find("Content-Length: ");
+            if (length != std::string::npos) remaining = atol(head.c_str() + length + 16);
+            start = n - (head.size() - end - 4);
+            inBody = true;
+        }
+        ok = decoder.feed(chunk + start, n - start);
+        if (remaining > 0) remaining -= n - start;
+    }
+    close(fd);
+    return ok && inBody && remaining <= 0 && decoder.finish();
+}
+
+struct Expected {
+    const char* tripId;
+    int64_t offset;
+    int32_t delay;
+    const char* label;
+    const char* headsign;
+};
+
+static int selfTest() {
+    const std::string stop = "8505000";
+    const int64_t base = 1760000000;
+    std::vector<uint8_t> feed = sampleFeed(stop, base);
+    const Expected expected[] = {
+        {"B-1", 300, -60, "R-S1", "Sursee"},
+        {"G-1", 450, 0, "R-RE", "Arth-Goldau"},
+        {"A-1", 600, 120, "IR 75", "Zug"},
+        {"C-1", 900, 300, "R-S3", "Bern"},
+        {"F-1", 1200, 0, "R-B2", ""},
+        {"L-19", 2000, 19, "R-L", ""},
+        {"L-18", 2060, 18, "R-L", ""},
+        {"L-17", 2120, 17, "R-L", ""},
+    };
+    const size_t rows = sizeof(expected) / sizeof(expected[0]);
+    int failed = 0;
+
+    auto check = [&](const char* name, bool decoded, const GtfsBoard& board) {
+        bool ok = decoded && board.count() == rows;
+        for (size_t i = 0; ok && i < rows; i++) {
+            const GtfsDeparture& d = board.row(i);
+            const char* label = d.shortName[0] ? d.shortName : d.routeId;
+            ok = strcmp(d.tripId, expected[i].tripId) == 0 && d.time == base + expected[i].offset &&
+                 d.delay == expected[i].delay && strcmp(label, expected[i].label) == 0 &&
+                 strcmp(d.headsign, expected[i].headsign) == 0;
+        }
+        printf("%s: %zu rows of %u entities %s\n", name, board.count(), board.entities(), ok ? "ok" : "FAILED");
+        if (!ok) printBoard(board);
+        failed += !ok;
+    };
+
+    printf("sample feed: %zu bytes\n", feed.size());
+    for (size_t chunk : {(size_t)1, (size_t)2, (size_t)3, (size_t)7, (size_t)128, (size_t)1436, feed.size()}) {
+        GtfsBoard board;
+        board.begin(stop.c_str(), base, rows);
+        std::string name = "chunks of " + std::to_string(chunk);
+        check(name.c_str(), decode(feed, chunk, board), board);
+    }
+
+    // Broken streams must be rejected
+    GtfsBoard board;
+    board.begin(stop.c_str(), base, rows);
+    std::vector<uint8_t> truncated(feed.begin(), feed.end() - 1);
+    bool ok = !decode(truncated, 128, board);
+    std::vector<uint8_t> overlong = {0x12, 0x05, 0x0A, 0x09, 'a', 'b', 'c'};   // inner length past the entity
+    ok = ok && !decode(overlong, 128, board);
+    std::vector<uint8_t> group = {0x13, 0x14};                              // wire type 3
+    ok = ok && !decode(group, 128, board);
+    std::vector<uint8_t> empty;
+    board.begin(stop.c_str(), base, rows);
+    ok = ok && decode(empty, 128, board) && board.count() == 0;
+    printf("broken streams: %s\n", ok ? "ok" : "FAILED");
+    failed += !ok;
+
+    // Through the stand-in server on a loopback port
+    int listener = listenOn(0);
+    sockaddr_in addr = {};
+    socklen_t length = sizeof(addr);
+    getsockname(listener, (sockaddr*)&addr, &length);
+    pid_t server = fork();
+    if (server == 0) serve(listener, feed, true);
+    close(listener);
+    GtfsBoard fetched;
+    fetched.begin(stop.c_str(), base, rows);
+    check("stand-in server", fetch(ntohs(addr.sin_port), fetched), fetched);
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "--selftest") return selfTest();
+
+    if (command == "decode" && argc >= 4) {
+        std::vector<uint8_t> feed;
+        if (!readFile(argv[2], feed)) return 1;
+        GtfsBoard board;
+        board.begin(argv[3], argc > 4 ? atoll(argv[4]) : (int64_t)time(nullptr), argc > 5 ? atoi(argv[5]) : 8);
+        bool ok = decode(feed, 1436, board);
+        printf("%zu bytes, %u entities, %u trips at %s, feed time %llu%s\n", feed.size(), board.entities(),
+               board.matches(), argv[3], (unsigned long long)board.timestamp(), ok ? "" : ", DECODE FAILED");
+        printBoard(board);
+        return ok ? 0 : 1;
+    }
+
+    if (command == "serve" && argc >= 3) {
+        std::vector<uint8_t> feed;
+        if (!readFile(argv[2], feed)) return 1;
+        int port = argc > 3 ? atoi(argv[3]) : 8080;
+        int listener = listenOn(port);
+        if (listener < 0) return 1;
+        printf("Serving %s (%zu bytes) on port %d\n", argv[2], feed.size(), port);
+        serve(listener, feed, false);
+    }
+
+    if (command == "sample" && argc >= 3) {
+        std::vector<uint8_t> feed = sampleFeed(argc > 3 ? argv[3] : "8505000", time(nullptr));
+        FILE* f = fopen(argv[2], "wb");
+        if (!f || fwrite(feed.data(), 1, feed.size(), f) != feed.size() || fclose(f) != 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        printf("%zu bytes written\n", feed.size());
+        return 0;
+    }
+
+    fprintf(stderr,
+            "Usage: %s decode feed.pb stop-id [from-unix-time] [limit]\n"
+            "       %s serve feed.pb [port]\n"
+            "       %s sample feed.pb [stop-id]\n"
+            "       %s --selftest\n",
+            argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+}
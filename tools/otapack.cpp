@@ -0,0 +1,178 @@
+// Compresses a Stationboard firmware image for the /ota upload route (Linux host tool)
+//
+// Build:     g++ -O2 -std=c++17 -Isrc tools/otapack.cpp src/heatshrink.cpp -o otapack
+// Compress:  ./otapack firmware.bin firmware.bin.hs
+// Self test: ./otapack --selftest
+//
+// Every image is decoded again with the device's decoder before it is written.
+#include "heatshrink.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const size_t WINDOW = 1 << HEATSHRINK_WINDOW_BITS;
+static const size_t MAX_MATCH = 1 << HEATSHRINK_LOOKAHEAD_BITS;
+static const size_t BACKREF_BITS = 1 + HEATSHRINK_WINDOW_BITS + HEATSHRINK_LOOKAHEAD_BITS;
+static const size_t MAX_CANDIDATES = 256;
+
+class BitWriter {
+public:
+    void put(uint32_t value, uint8_t bits) {
+        while (bits--) {
+            current = (current << 1) | ((value >> bits) & 1);
+            if (++fill == 8) {
+                out.push_back(current);
+                current = 0;
+                fill = 0;
+            }
+        }
+    }
+    std::vector<uint8_t> finish() {
+        if (fill) out.push_back(current << (8 - fill)); // zero padding
+        return out;
+    }
+
+private:
+    std::vector<uint8_t> out;
+    uint8_t current = 0;
+    uint8_t fill = 0;
+};
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t>& in) {
+    // Hash chains over 2-byte prefixes, limited to the decoder's window
+    std::vector<int32_t> head(1 << 16, -1);
+    std::vector<int32_t> prev(in.size(), -1);
+    BitWriter bits;
+
+    size_t pos = 0;
+    while (pos < in.size()) {
+        size_t bestLen = 0;
+        size_t bestDist = 0;
+        if (pos + 1 < in.size()) {
+            int32_t candidate = head[in[pos] << 8 | in[pos + 1]];
+            for (size_t checked = 0; candidate >= 0 && pos - candidate <= WINDOW && checked < MAX_CANDIDATES; checked++) {
+                size_t len = 0;
+                while (len < MAX_MATCH && pos + len < in.size() && in[candidate + len] == in[pos + len]) len++;
+                if (len > bestLen) {
+                    bestLen = len;
+                    bestDist = pos - candidate;
+                    if (len == MAX_MATCH) break;
+                }
+                candidate = prev[candidate];
+            }
+        }
+
+        // A backref must be shorter than the same bytes as literals
+        size_t step = 1;
+        if (bestLen * 9 > BACKREF_BITS) {
+            bits.put(0, 1);
+            bits.put(bestDist - 1, HEATSHRINK_WINDOW_BITS);
+            bits.put(bestLen - 1, HEATSHRINK_LOOKAHEAD_BITS);
+            step = bestLen;
+        } else {
+            bits.put(1, 1);
+            bits.put(in[pos], 8);
+        }
+
+        for (size_t i = 0; i < step; i++, pos++) {
+            if (pos + 1 < in.size()) {
+                uint16_t key = in[pos] << 8 | in[pos + 1];
+                prev[pos] = head[key];
+                head[key] = pos;
+            }
+        }
+    }
+    return bits.finish();
+}
+
+class VectorSink : public ByteSink {
+public:
+    bool write(const uint8_t* buf, size_t len) override {
+        data.insert(data.end(), buf, buf + len);
+        return true;
+    }
+    std::vector<uint8_t> data;
+};
+
+// Decodes in upload-sized chunks like the device's web server does
+static bool roundTrip(const std::vector<uint8_t>& original, const std::vector<uint8_t>& packed) {
+    VectorSink sink;
+    HeatshrinkDecoder* decoder = new HeatshrinkDecoder(sink);
+    bool ok = true;
+    for (size_t pos = 0; pos < packed.size() && ok; pos += 1436) {
+        ok = decoder->feed(&packed[pos], std::min<size_t>(1436, packed.size() - pos));
+    }
+    ok = ok && decoder->finish() && sink.data == original;
+    delete decoder;
+    return ok;
+}
+
+static int selfTest() {
+    std::vector<std::vector<uint8_t>> cases;
+    cases.push_back({});
+    cases.push_back({0x42});
+    cases.push_back(std::vector<uint8_t>(100000, 0));
+    cases.push_back(std::vector<uint8_t>(100000, 0xFF));
+
+    std::vector<uint8_t> random(200000);
+    srand(1);
+    for (auto& b : random) b = rand();
+    cases.push_back(random);
+
+    // Repeats further apart than the window must not be referenced
+    std::vector<uint8_t> farRepeat;
+    for (int r = 0; r < 2; r++) farRepeat.insert(farRepeat.end(), random.begin(), random.begin() + 3000);
+    cases.push_back(farRepeat);
+
+    std::vector<uint8_t> text;
+    for (int i = 0; i < 5000; i++) {
+        std::string line = "departure " + std::to_string(i % 97) + " platform " + std::to_string(i % 7) + "\n";
+        text.insert(text.end(), line.begin(), line.end());
+    }
+    cases.push_back(text);
+
+    int failed = 0;
+    for (size_t i = 0; i < cases.size(); i++) {
+        std::vector<uint8_t> packed = compress(cases[i]);
+        bool ok = roundTrip(cases[i], packed);
+        printf("case %zu: %zu -> %zu bytes %s\n", i, cases[i].size(), packed.size(), ok ? "ok" : "FAILED");
+        failed += !ok;
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2 && std::string(argv[1]) == "--selftest") return selfTest();
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s firmware.bin firmware.bin.hs\n       %s --selftest\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> image;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) image.insert(image.end(), buf, buf + n);
+    fclose(f);
+
+    std::vector<uint8_t> packed = compress(image);
+    if (!roundTrip(image, packed)) {
+        fprintf(stderr, "Round trip failed, nothing written\n");
+        return 1;
+    }
+
+    f = fopen(argv[2], "wb");
+    if (!f || fwrite(packed.data(), 1, packed.size(), f) != packed.size() || fclose(f) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+    printf("%zu -> %zu bytes (%.1f%%), round trip ok\n", image.size(), packed.size(),
+           image.empty() ? 0.0 : 100.0 * packed.size() / image.size());
+    return 0;
+}
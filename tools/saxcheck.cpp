@@ -0,0 +1,178 @@
+// Prints the events of the device's streaming JSON and XML tokenizers (Linux host tool)
+//
+// Build:     g++ -O2 -std=c++17 -Isrc tools/saxcheck.cpp src/jsonsax.cpp src/xmlsax.cpp -o saxcheck
+// Events:    ./saxcheck response.json
+//            ./saxcheck response.xml
+// Self test: ./saxcheck --selftest
+//
+// Responses arrive in arbitrary TCP chunks, the self test feeds every sample in
+// chunk sizes from 1 byte to the whole document and expects the same events.
+#include "jsonsax.h"
+#include "xmlsax.h"
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+typedef std::vector<std::string> Events;
+
+class JsonRecorder : public JsonHandler {
+public:
+    Events events;
+    void startObject() override { events.push_back("{"); }
+    void endObject() override { events.push_back("}"); }
+    void startArray() override { events.push_back("["); }
+    void endArray() override { events.push_back("]"); }
+    void key(const char* key) override { events.push_back(std::string("key ") + key); }
+    void value(const char* value) override { events.push_back(std::string("value ") + value); }
+};
+
+class XmlRecorder : public XmlHandler {
+public:
+    Events events;
+    void startElement(const char* name) override { events.push_back(std::string("<") + name); }
+    void endElement(const char* name) override { events.push_back(std::string("</") + name); }
+    void text(const char* text) override { events.push_back(std::string("text ") + text); }
+};
+
+// Feeds the document in pieces of chunk bytes, false when it is rejected
+template <typename Tokenizer>
+static bool tokenize(Tokenizer& tokenizer, const std::string& document, size_t chunk) {
+    tokenizer.reset();
+    const uint8_t* data = (const uint8_t*)document.data();
+    for (size_t pos = 0; pos < document.size(); pos += chunk) {
+        if (!tokenizer.feed(data + pos, std::min(chunk, document.size() - pos))) return false;
+    }
+    return tokenizer.finish();
+}
+
+static bool parseJson(const std::string& document, size_t chunk, Events& events) {
+    JsonRecorder recorder;
+    JsonTokenizer tokenizer(recorder);
+    bool ok = tokenize(tokenizer, document, chunk);
+    events = recorder.events;
+    return ok;
+}
+
+static bool parseXml(const std::string& document, size_t chunk, Events& events) {
+    XmlRecorder recorder;
+    XmlTokenizer tokenizer(recorder);
+    bool ok = tokenize(tokenizer, document, chunk);
+    events = recorder.events;
+    return ok;
+}
+
+static void printEvents(const Events& events) {
+    for (const std::string& event : events) printf("  %s\n", event.c_str());
+}
+
+struct Sample {
+    const char* name;
+    bool xml;
+    std::string document;
+    Events expected;
+};
+
+static int selfTest() {
+    std::vector<Sample> samples = {
+        {"json stationboard", false,
+         "{\"station\":{\"name\":\"Z\\u00fcrich HB\"},\"stationboard\":[{\"stop\":{\"departure\":"
+         "\"2026-10-19T12:34:00+0200\",\"delay\":3},\"category\":\"S\",\"number\":\"12\",\"to\":\"Winterthur\"},"
+         "{\"stop\":{\"departure\":\"2026-10-19T12:40:00+0200\",\"delay\":null},\"number\":null,\"to\":\"Uster\"}]}",
+         {"{", "key station", "{", "key name", "value Z\xc3\xbcrich HB", "}", "key stationboard", "[",
+          "{", "key stop", "{", "key departure", "value 2026-10-19T12:34:00+0200", "key delay", "value 3", "}",
+          "key category", "value S", "key number", "value 12", "key to", "value Winterthur", "}",
+          "{", "key stop", "{", "key departure", "value 2026-10-19T12:40:00+0200", "key delay", "value null", "}",
+          "key number", "value null", "key to", "value Uster", "}", "]", "}"}},
+        {"json escapes and literals", false,
+         " [ \"a\\\"b\\\\c\\/\\n\" , -1.5e3 , true , false , [ ] , { } , \"\\ud83d\\ude86\" ] ",
+         {"[", "value a\"b\\c/\n", "value -1.5e3", "value true", "value false", "[", "]", "{", "}",
+          "value \xf0\x9f\x9a\x86", "]"}},
+        {"xml trias", true,
+         "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!-- response -->\n"
+         "<trias:Trias xmlns:trias=\"http://www.vdv.de/trias\" version=\"1.1\">\n"
+         "  <trias:StopEvent>\n"
+         "    <trias:StopPointName><trias:Text>Bern</trias:Text><trias:Language>de</trias:Language></trias:StopPointName>\n"
+         "    <trias:TimetabledTime>2026-10-19T10:34:00Z</trias:TimetabledTime>\n"
+         "    <trias:DestinationText><trias:Text>Gen&#232;ve &amp; A&#x00e9;roport</trias:Text></trias:DestinationText>\n"
+         "    <trias:Cancelled/>\n"
+         "    <trias:Note><![CDATA[a < b]]></trias:Note>\n"
+         "  </trias:StopEvent>\n"
+         "</trias:Trias>\n",
+         {"<Trias", "<StopEvent", "<StopPointName", "<Text", "text Bern", "</Text", "<Language", "text de",
+          "</Language", "</StopPointName", "<TimetabledTime", "text 2026-10-19T10:34:00Z", "</TimetabledTime",
+          "<DestinationText", "<Text", "text Gen\xc3\xa8ve & A\xc3\xa9roport", "</Text", "</DestinationText",
+          "<Cancelled", "</Cancelled", "<Note", "text a < b", "</Note", "</StopEvent", "</Trias"}},
+        {"xml attributes with markup", true,
+         "<a x='1>2' y=\"</a>\"><?pi ?><b>  one  </b><!DOCTYPE c></a>",
+         {"<a", "<b", "text one", "</b", "</a"}},
+    };
+
+    // Documents every tokenizer has to reject
+    std::vector<Sample> broken = {
+        {"json truncated", false, "{\"a\":[1,2", {}},
+        {"json mismatched", false, "{\"a\":[1,2}]", {}},
+        {"json missing colon", false, "{\"a\" 1}", {}},
+        {"json trailing garbage", false, "{} x", {}},
+        {"xml truncated", true, "<a><b>text</b>", {}},
+        {"xml unbalanced", true, "<a></a></b>", {}},
+        {"xml empty", true, "", {}},
+    };
+
+    int failed = 0;
+    for (const Sample& sample : samples) {
+        bool ok = true;
+        std::string failures;
+        for (size_t chunk : {(size_t)1, (size_t)2, (size_t)3, (size_t)7, (size_t)64, sample.document.size()}) {
+            Events events;
+            bool parsed = sample.xml ? parseXml(sample.document, chunk, events) : parseJson(sample.document, chunk, events);
+            if (!parsed || events != sample.expected) {
+                failures += " " + std::to_string(chunk);
+                if (ok) printEvents(events);
+                ok = false;
+            }
+        }
+        printf("%s: %zu events %s%s%s\n", sample.name, sample.expected.size(), ok ? "ok" : "FAILED",
+               ok ? "" : " at chunk sizes", failures.c_str());
+        failed += !ok;
+    }
+    for (const Sample& sample : broken) {
+        bool ok = true;
+        for (size_t chunk : {(size_t)1, (size_t)3, std::max<size_t>(sample.document.size(), 1)}) {
+            Events events;
+            ok = ok && !(sample.xml ? parseXml(sample.document, chunk, events) : parseJson(sample.document, chunk, events));
+        }
+        printf("%s: %s\n", sample.name, ok ? "rejected" : "FAILED");
+        failed += !ok;
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2 && std::string(argv[1]) == "--selftest") return selfTest();
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s response.json|response.xml\n       %s --selftest\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::string document;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) document.append(buf, n);
+    fclose(f);
+
+    // XML starts with '<' after optional whitespace or a byte order mark
+    size_t first = document.find_first_not_of(" \t\r\n\xef\xbb\xbf");
+    bool xml = first != std::string::npos && document[first] == '<';
+    Events events;
+    bool ok = xml ? parseXml(document, 1436, events) : parseJson(document, 1436, events);
+    printEvents(events);
+    printf("%s: %zu bytes, %zu events, %s\n", xml ? "XML" : "JSON", document.size(), events.size(),
+           ok ? "complete" : "rejected");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// Checks the Stationboard deadline scheduler against a fake clock (Linux host tool)
+//
+// Build:     g++ -O2 -std=c++17 -Isrc tools/scheduler.cpp src/scheduler.cpp -o scheduler
+// Self test: ./scheduler --selftest
+//
+// The device clock is replaced through schedulerSetClock(), time only moves when the test says so.
+#include "scheduler.h"
+#include <cstdio>
+#include <string>
+
+static uint64_t fakeNow = 0;
+
+static uint64_t fakeClock() {
+    return fakeNow;
+}
+
+static void cancelAll() {
+    for (int i = 0; i < TASK_COUNT; i++) schedulerCancel((SchedulerTask)i);
+}
+
+static int selfTest() {
+    int failed = 0;
+    auto check = [&](const char* name, bool ok) {
+        printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+        failed += !ok;
+    };
+
+    schedulerSetClock(fakeClock);
+    fakeNow = 1000000;
+    cancelAll();
+
+    check("nothing pending", schedulerNextDeadline() == SCHEDULER_NONE && schedulerTimeUntilNext() == SCHEDULER_NONE);
+
+    // Earliest deadline wins, whichever task registered it
+    schedulerSetIn(TASK_FETCH, 60000);
+    schedulerSetIn(TASK_STAY_AWAKE, 15000);
+    schedulerSetIn(TASK_NIGHT_BOUNDARY, 3600000);
+    schedulerSet(TASK_TIMETABLE, fakeNow + 15001);
+    SchedulerTask task = TASK_COUNT;
+    uint64_t next = schedulerNextDeadline(&task);
+    check("earliest deadline", next == fakeNow + 15000 && task == TASK_STAY_AWAKE);
+    check("time until next", schedulerTimeUntilNext() == 15000);
+    fakeNow += 14999;
+    check("time until next after 14999 ms", schedulerTimeUntilNext() == 1);
+    check("not due early", !schedulerDue(TASK_STAY_AWAKE) && schedulerPending(TASK_STAY_AWAKE));
+
+    // Due fires once and clears the deadline
+    fakeNow += 1;
+    check("due on the deadline", schedulerDue(TASK_STAY_AWAKE) && !schedulerPending(TASK_STAY_AWAKE));
+    check("due only once", !schedulerDue(TASK_STAY_AWAKE));
+    next = schedulerNextDeadline(&task);
+    check("next after due", task == TASK_TIMETABLE && schedulerTimeUntilNext() == 1);
+
+    // Cancelled tasks are no longer considered
+    schedulerCancel(TASK_TIMETABLE);
+    next = schedulerNextDeadline(&task);
+    check("cancel", !schedulerPending(TASK_TIMETABLE) && !schedulerDue(TASK_TIMETABLE) && task == TASK_FETCH &&
+                    schedulerTimeUntilNext() == 45000);
+
+    // Overdue deadlines do not wrap around
+    fakeNow += 500000;
+    check("overdue", schedulerTimeUntilNext() == 0 && schedulerDue(TASK_FETCH));
+    schedulerSet(TASK_NIGHT_WAKE_END, fakeNow - 1);
+    check("deadline in the past", schedulerTimeUntilNext() == 0 && schedulerNextDeadline(&task) == fakeNow - 1 &&
+                                  task == TASK_NIGHT_WAKE_END);
+    cancelAll();
+
+    // The minute tick lands on the wall-clock edge plus the guard
+    const uint64_t edge = 1760000040000ULL;   // a whole minute of wall time
+    bool ok = true;
+    for (uint64_t into : {0ULL, 1ULL, 19ULL, 20ULL, 21ULL, 30000ULL, 59979ULL, 59980ULL, 59999ULL}) {
+        fakeNow = 5000000;
+        schedulerSetMinuteTick(edge + into);
+        uint64_t wallDue = edge + into + (schedulerDeadline(TASK_MINUTE_TICK) - fakeNow);
+        bool tickOk = wallDue == edge + 60000 + MINUTE_TICK_GUARD && schedulerTimeUntilNext() == 60000 - into + MINUTE_TICK_GUARD;
+        if (!tickOk) printf("  %llu ms into the minute: due at edge %+lld ms\n", (unsigned long long)into,
+                            (long long)(wallDue - edge - 60000));
+        ok = ok && tickOk;
+    }
+    check("minute tick", ok);
+
+    // Redrawn on the tick, the next one is a full minute later
+    fakeNow = 5000000;
+    schedulerSetMinuteTick(edge + 59999);
+    fakeNow += schedulerTimeUntilNext();
+    ok = schedulerDue(TASK_MINUTE_TICK);
+    schedulerSetMinuteTick(edge + 60000 + MINUTE_TICK_GUARD);
+    check("consecutive ticks", ok && schedulerTimeUntilNext() == 60000);
+    cancelAll();
+
+    schedulerSetClock(nullptr);
+    check("default clock restored", schedulerNow() != fakeNow);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2 && std::string(argv[1]) == "--selftest") return selfTest();
+    fprintf(stderr, "Usage: %s --selftest\n", argv[0]);
+    return 2;
+}